@@ -0,0 +1,508 @@
+"""Export of simulation results as Arrow IPC files.
+
+Arrow IPC files are columnar and typed. Analytics tools (pyarrow, polars, DuckDB, ...) memory-map them
+instead of parsing text. Every column carries its unit in the field metadata under the key 'unit'.
+
+- `ArrowWriter` writes numeric columns in record batches (the file is complete after `close`),
+- `ArrowRecorder` streams the quantities recorded by a plant (see `BSMBase.advance`) batch by batch,
+- `Evaluation.export_arrow` writes the data objects of an evaluation,
+- `read_arrow` memory-maps a file written by any Arrow implementation (numeric columns only).
+
+The format is written with numpy only (Arrow columnar format version 1.5, metadata version V5).
+"""
+
+import struct
+from dataclasses import dataclass, field
+
+import numpy as np
+
+from bsm2_python.influent import COMPONENTS
+
+MAGIC = b'ARROW1'
+CONTINUATION = b'\xff\xff\xff\xff'
+ALIGNMENT = 64
+
+METADATA_V5 = 4
+HEADER_SCHEMA, HEADER_RECORD_BATCH = 1, 3
+TYPE_INT, TYPE_FLOATING_POINT = 2, 3
+PRECISION = {2: 0, 4: 1, 8: 2}
+
+ASM1_UNITS = (
+    'g(COD)/m3',
+    'g(COD)/m3',
+    'g(COD)/m3',
+    'g(COD)/m3',
+    'g(COD)/m3',
+    'g(COD)/m3',
+    'g(COD)/m3',
+    'g(-COD)/m3',
+    'g(N)/m3',
+    'g(N)/m3',
+    'g(N)/m3',
+    'g(N)/m3',
+    'mol(HCO3)/m3',
+    'g(SS)/m3',
+    'm3/d',
+    'degC',
+    '-',
+    '-',
+    '-',
+    '-',
+    '-',
+)
+"""Units of the ASM1 components, see `influent.COMPONENTS`."""
+
+
+class _Builder:
+    """Minimal FlatBuffers builder. The buffer is built from its end, offsets count bytes from the end."""
+
+    def __init__(self):
+        self.buf = bytearray()
+        self.minalign = 1
+        self.vtable = None
+        self.object_end = 0
+
+    def offset(self):
+        return len(self.buf)
+
+    def prep(self, size, additional=0):
+        self.minalign = max(self.minalign, size)
+        self.buf[0:0] = bytes((-(len(self.buf) + additional)) % size)
+
+    def prepend(self, fmt, value):
+        self.prep(struct.calcsize(fmt))
+        self.buf[0:0] = struct.pack('<' + fmt, value)
+
+    def prepend_offset(self, off):
+        self.prep(4)
+        self.buf[0:0] = struct.pack('<I', self.offset() + 4 - off)
+
+    def string(self, text):
+        data = text.encode('utf-8')
+        self.prep(4, len(data) + 1)
+        self.buf[0:0] = struct.pack('<I', len(data)) + data + b'\x00'
+        return self.offset()
+
+    def vector(self, offsets):
+        self.prep(4, 4 * len(offsets))
+        for off in reversed(offsets):
+            self.prepend_offset(off)
+        self.buf[0:0] = struct.pack('<I', len(offsets))
+        return self.offset()
+
+    def struct_vector(self, fmt, items):
+        size = struct.calcsize('<' + fmt)
+        self.prep(4, size * len(items))
+        self.prep(8, size * len(items))
+        self.buf[0:0] = b''.join(struct.pack('<' + fmt, *item) for item in items)
+        self.buf[0:0] = struct.pack('<I', len(items))
+        return self.offset()
+
+    def start(self):
+        self.vtable = {}
+        self.object_end = self.offset()
+
+    def add(self, slot, fmt, value):
+        self.prepend(fmt, value)
+        self.vtable[slot] = self.offset()
+
+    def add_offset(self, slot, off):
+        self.prepend_offset(off)
+        self.vtable[slot] = self.offset()
+
+    def end(self):
+        self.prepend('i', 0)
+        table = self.offset()
+        n = max(self.vtable) + 1 if self.vtable else 0
+        slots = [table - self.vtable[k] if k in self.vtable else 0 for k in range(n)]
+        self.buf[0:0] = struct.pack(f'<HH{n}H', 4 + 2 * n, table - self.object_end, *slots)
+        position = len(self.buf) - table
+        self.buf[position : position + 4] = struct.pack('<i', self.offset() - table)
+        self.vtable = None
+        return table
+
+    def finish(self, root):
+        self.prep(max(self.minalign, 8), 4)
+        self.prepend_offset(root)
+        return bytes(self.buf)
+
+
+class _Table:
+    """Read access to a FlatBuffers table at `pos` of `buf`."""
+
+    def __init__(self, buf, pos):
+        self.buf = buf
+        self.pos = pos
+        self.vtable = pos - struct.unpack_from('<i', buf, pos)[0]
+        self.vtable_size = struct.unpack_from('<H', buf, self.vtable)[0]
+
+    def _field(self, slot):
+        entry = 4 + 2 * slot
+        if entry >= self.vtable_size:
+            return None
+        off = struct.unpack_from('<H', self.buf, self.vtable + entry)[0]
+        return self.pos + off if off else None
+
+    def scalar(self, slot, fmt, default=0):
+        pos = self._field(slot)
+        return default if pos is None else struct.unpack_from('<' + fmt, self.buf, pos)[0]
+
+    def table(self, slot):
+        pos = self._field(slot)
+        return None if pos is None else _Table(self.buf, pos + struct.unpack_from('<I', self.buf, pos)[0])
+
+    def vector(self, slot):
+        pos = self._field(slot)
+        if pos is None:
+            return 0, 0
+        start = pos + struct.unpack_from('<I', self.buf, pos)[0]
+        return start + 4, struct.unpack_from('<I', self.buf, start)[0]
+
+    def tables(self, slot):
+        start, n = self.vector(slot)
+        return [_Table(self.buf, p + struct.unpack_from('<I', self.buf, p)[0]) for p in range(start, start + 4 * n, 4)]
+
+    def string(self, slot):
+        pos = self._field(slot)
+        if pos is None:
+            return ''
+        start = pos + struct.unpack_from('<I', self.buf, pos)[0]
+        length = struct.unpack_from('<I', self.buf, start)[0]
+        return bytes(self.buf[start + 4 : start + 4 + length]).decode('utf-8')
+
+    def structs(self, slot, fmt):
+        start, n = self.vector(slot)
+        size = struct.calcsize('<' + fmt)
+        return [struct.unpack_from('<' + fmt, self.buf, start + k * size) for k in range(n)]
+
+
+def _key_values(builder, metadata):
+    entries = []
+    for key, value in (metadata or {}).items():
+        key_off, value_off = builder.string(str(key)), builder.string(str(value))
+        builder.start()
+        builder.add_offset(0, key_off)
+        builder.add_offset(1, value_off)
+        entries.append(builder.end())
+    return builder.vector(entries) if entries else None
+
+
+def _schema(builder, fields, metadata):
+    offsets = []
+    for name, dtype, field_metadata in fields:
+        name_off = builder.string(name)
+        builder.start()
+        if dtype.kind == 'f':
+            builder.add(0, 'h', PRECISION[dtype.itemsize])
+            type_type = TYPE_FLOATING_POINT
+        else:
+            builder.add(0, 'i', 8 * dtype.itemsize)
+            builder.add(1, '?', dtype.kind == 'i')
+            type_type = TYPE_INT
+        type_off = builder.end()
+        children = builder.vector([])
+        metadata_off = _key_values(builder, field_metadata)
+        builder.start()
+        builder.add_offset(0, name_off)
+        builder.add(1, '?', True)
+        builder.add(2, 'B', type_type)
+        builder.add_offset(3, type_off)
+        builder.add_offset(5, children)
+        if metadata_off is not None:
+            builder.add_offset(6, metadata_off)
+        offsets.append(builder.end())
+    fields_off = builder.vector(offsets)
+    metadata_off = _key_values(builder, metadata)
+    builder.start()
+    builder.add(0, 'h', 0)  # little endian
+    builder.add_offset(1, fields_off)
+    if metadata_off is not None:
+        builder.add_offset(2, metadata_off)
+    return builder.end()
+
+
+def _message(header_type, build_header, body_length):
+    builder = _Builder()
+    header = build_header(builder)
+    builder.start()
+    builder.add(0, 'h', METADATA_V5)
+    builder.add(1, 'B', header_type)
+    builder.add_offset(2, header)
+    builder.add(3, 'q', body_length)
+    return builder.finish(builder.end())
+
+
+def _padding(n, alignment=8):
+    return bytes(-n % alignment)
+
+
+class ArrowWriter:
+    """Creates an ArrowWriter object, writing numeric columns to an Arrow IPC file in record batches.
+
+    Parameters
+    ----------
+    path : str
+        Path of the Arrow file.
+    fields : list[tuple(str, np.dtype, dict)]
+        Name, type (signed/unsigned integers and floats) and metadata of every column.
+    metadata : dict{str: str} (optional)
+        Metadata of the schema.
+    """
+
+    def __init__(self, path: str, fields, metadata: dict | None = None):
+        self.fields = [(name, np.dtype(dtype).newbyteorder('<'), md or {}) for name, dtype, md in fields]
+        for name, dtype, _ in self.fields:
+            if dtype.kind not in 'iuf' or (dtype.kind == 'f' and dtype.itemsize not in PRECISION):
+                raise ValueError(f'Column {name} has type {dtype}, only integer and float columns can be written.')
+        self.metadata = metadata
+        self.blocks = []
+        self.rows = 0
+        self.file = open(path, 'wb')  # noqa: SIM115 - closed by `close`
+        self.file.write(MAGIC + b'\x00\x00')
+        self._write_message(_message(HEADER_SCHEMA, lambda b: _schema(b, self.fields, metadata), 0), b'')
+
+    def _write_message(self, flatbuffer, body):
+        offset = self.file.tell()
+        # the body starts at a multiple of ALIGNMENT of the file
+        flatbuffer += _padding(offset + 8 + len(flatbuffer), ALIGNMENT)
+        metadata = CONTINUATION + struct.pack('<i', len(flatbuffer)) + flatbuffer
+        self.file.write(metadata)
+        self.file.write(body)
+        return offset, len(metadata), len(body)
+
+    def write_batch(self, columns):
+        """Writes a record batch.
+
+        Parameters
+        ----------
+        columns : list[np.ndarray] | dict{str: np.ndarray}
+            One-dimensional values of every column (in the order of `fields`), all of the same length.
+            Masked values of `np.ma.MaskedArray`s are written as nulls.
+        """
+
+        if isinstance(columns, dict):
+            columns = [columns[name] for name, _, _ in self.fields]
+        length = len(columns[0]) if columns else 0
+        nodes, buffers, chunks = [], [], []
+        position = 0
+
+        def add_buffer(data):
+            nonlocal position
+            buffers.append((position, len(data)))
+            chunks.append(data + _padding(len(data), ALIGNMENT))
+            position += len(data) + len(_padding(len(data), ALIGNMENT))
+
+        for (name, dtype, _), values in zip(self.fields, columns, strict=True):
+            if len(values) != length:
+                raise ValueError(f'Column {name} has {len(values)} values, expected {length}.')
+            mask = np.ma.getmaskarray(values) if isinstance(values, np.ma.MaskedArray) else None
+            null_count = int(mask.sum()) if mask is not None else 0
+            nodes.append((length, null_count))
+            if null_count:
+                add_buffer(np.packbits(~mask, bitorder='little').tobytes())
+            else:
+                add_buffer(b'')
+            data = np.ma.getdata(values) if mask is not None else values
+            add_buffer(np.ascontiguousarray(data, dtype=dtype).tobytes())
+
+        def record_batch(builder):
+            buffers_off = builder.struct_vector('qq', buffers)
+            nodes_off = builder.struct_vector('qq', nodes)
+            builder.start()
+            builder.add(0, 'q', length)
+            builder.add_offset(1, nodes_off)
+            builder.add_offset(2, buffers_off)
+            return builder.end()
+
+        self.blocks.append(self._write_message(_message(HEADER_RECORD_BATCH, record_batch, position), b''.join(chunks)))
+        self.rows += length
+
+    def close(self):
+        """Writes the end of the stream and the footer and closes the file."""
+        if self.file.closed:
+            return
+        self.file.write(CONTINUATION + b'\x00\x00\x00\x00')
+        builder = _Builder()
+        blocks = builder.struct_vector('qi4xq', self.blocks)
+        dictionaries = builder.struct_vector('qi4xq', [])
+        schema = _schema(builder, self.fields, self.metadata)
+        builder.start()
+        builder.add(0, 'h', METADATA_V5)
+        builder.add_offset(1, schema)
+        builder.add_offset(2, dictionaries)
+        builder.add_offset(3, blocks)
+        footer = builder.finish(builder.end())
+        self.file.write(footer + struct.pack('<i', len(footer)) + MAGIC)
+        self.file.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+
+def column_fields(name: str, values: np.ndarray, units=None):
+    """Returns the Arrow fields of a recorded quantity.
+
+    One-dimensional quantities give one column `name`, quantities with 21 values per step give one column per
+    ASM1 component (`name.SI`, ...) with the ASM1 units, other quantities one column per value (`name[k]`).
+    """
+    width = int(np.prod(values.shape[1:], dtype=int))
+    if values.ndim == 1:
+        names = [name]
+    elif width == len(COMPONENTS):
+        names = [f'{name}.{component}' for component in COMPONENTS]
+        units = ASM1_UNITS if units is None else units
+    else:
+        names = [f'{name}[{k}]' for k in range(width)]
+    if units is None or isinstance(units, str):
+        units = [units or '-'] * len(names)
+    dtype = values.dtype if values.dtype.kind in 'iuf' else np.dtype(float)
+    return [(column, dtype, {'unit': unit}) for column, unit in zip(names, units, strict=True)]
+
+
+class ArrowRecorder:
+    """Creates an ArrowRecorder object, streaming the quantities recorded by a plant to an Arrow IPC file.
+
+    Parameters
+    ----------
+    model : BSMBase
+        Plant model, e.g. `BSM2OL`.
+    path : str
+        Path of the Arrow file.
+    record : list[str] (optional)
+        Names of the recorded quantities, e.g. ['y_eff'] for `y_eff_all`. <br>
+        If not provided, all arrays recorded per time step are written.
+    batch_steps : int (optional)
+        Time steps per record batch. <br>
+        Default is 1440.
+    units : dict{str: str | list[str]} (optional)
+        Units of the recorded quantities, ASM1 units are used for quantities with 21 values per step.
+    metadata : dict{str: str} (optional)
+        Metadata of the schema, e.g. the plant configuration.
+    """
+
+    def __init__(self, model, path: str, record=None, batch_steps: int = 1440, units=None, metadata=None):
+        self.model = model
+        self.batch_steps = batch_steps
+        recorded = model._recorded(0, 0, record)
+        self.record = [name for name in recorded if name != 'simtime']
+        fields = [('simtime', np.dtype(float), {'unit': 'd'})]
+        for name in self.record:
+            fields += column_fields(name, recorded[name], (units or {}).get(name))
+        self.writer = ArrowWriter(path, fields, {'model': type(model).__name__, **(metadata or {})})
+
+    def write(self, recorded):
+        """Writes recorded quantities (as returned by `BSMBase.advance`) as one record batch."""
+        columns = [recorded['simtime']]
+        for name in self.record:
+            values = recorded[name]
+            columns += list(np.reshape(values, (len(values), -1)).T) if values.ndim > 1 else [values]
+        self.writer.write_batch(columns)
+
+    def advance(self, n_steps: int, **kwargs):
+        """Simulates the next `n_steps` time steps of the plant and writes them in batches of `batch_steps`.
+
+        Keyword arguments are passed to `BSMBase.advance`. The first step of every batch is a sample
+        instant of the callback, a stop requested by the observer ends the recording.
+        """
+        start = self.model.next_step
+        stop = min(start + n_steps, len(self.model.simtime))
+        while self.model.next_step < stop:
+            n = min(self.batch_steps, stop - self.model.next_step)
+            recorded = self.model.advance(n, record=self.record, **kwargs)
+            self.write(recorded)
+            if len(recorded['simtime']) < n:
+                # stopped by the observer
+                break
+
+    def close(self):
+        """Completes the Arrow file."""
+        self.writer.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+
+@dataclass
+class ArrowFile:
+    """Columns and metadata of an Arrow IPC file, see `read_arrow`.
+
+    columns : dict{str: np.ndarray}
+        Values of every column (memory-mapped if the file has a single record batch without nulls).
+    metadata : dict{str: dict{str: str}}
+        Metadata of every column.
+    schema_metadata : dict{str: str}
+        Metadata of the schema.
+    """
+
+    columns: dict = field(default_factory=dict)
+    metadata: dict = field(default_factory=dict)
+    schema_metadata: dict = field(default_factory=dict)
+
+
+def _read_key_values(table, slot):
+    return {kv.string(0): kv.string(1) for kv in table.tables(slot)}
+
+
+def read_arrow(path: str):
+    """Reads the numeric columns of an Arrow IPC file without copying them.
+
+    Returns
+    -------
+    arrow_file : ArrowFile
+        Columns and metadata. Columns with nulls are `np.ma.MaskedArray`s.
+    """
+
+    buf = np.memmap(path, dtype=np.uint8, mode='r')
+    if bytes(buf[:6]) != MAGIC or bytes(buf[-6:]) != MAGIC:
+        raise ValueError(f'{path} is not an Arrow IPC file.')
+    footer_length = struct.unpack_from('<i', buf, len(buf) - 10)[0]
+    footer_start = len(buf) - 10 - footer_length
+    footer = _Table(buf, footer_start + struct.unpack_from('<I', buf, footer_start)[0])
+    schema = footer.table(1)
+    dtypes = []
+    result = ArrowFile(schema_metadata=_read_key_values(schema, 2))
+    for fld in schema.tables(1):
+        name = fld.string(0)
+        type_table = fld.table(3)
+        type_type = fld.scalar(2, 'B')
+        if type_type == TYPE_FLOATING_POINT:
+            dtype = np.dtype({0: '<f2', 1: '<f4', 2: '<f8'}[type_table.scalar(0, 'h')])
+        elif type_type == TYPE_INT:
+            dtype = np.dtype(f'<{"i" if type_table.scalar(1, "?") else "u"}{type_table.scalar(0, "i") // 8}')
+        else:
+            raise ValueError(f'Column {name} of {path} is not numeric.')
+        dtypes.append((name, dtype))
+        result.metadata[name] = _read_key_values(fld, 6)
+
+    chunks = {name: [] for name, _ in dtypes}
+    for offset, metadata_length, _ in footer.structs(3, 'qi4xq'):
+        position = offset + 8 if bytes(buf[offset : offset + 4]) == CONTINUATION else offset + 4
+        message = _Table(buf, position + struct.unpack_from('<I', buf, position)[0])
+        batch = message.table(2)
+        body = offset + metadata_length
+        length = batch.scalar(0, 'q')
+        nodes = batch.structs(1, 'qq')
+        buffers = batch.structs(2, 'qq')
+        for k, (name, dtype) in enumerate(dtypes):
+            (validity_offset, validity_length), (data_offset, _) = buffers[2 * k], buffers[2 * k + 1]
+            values = np.frombuffer(buf, dtype=dtype, count=length, offset=body + data_offset)
+            if nodes[k][1]:
+                bits = np.frombuffer(buf, dtype=np.uint8, count=validity_length, offset=body + validity_offset)
+                valid = np.unpackbits(bits, count=length, bitorder='little').astype(bool)
+                values = np.ma.MaskedArray(values, mask=~valid)
+            chunks[name].append(values)
+    for name, dtype in dtypes:
+        parts = chunks[name]
+        if len(parts) == 1:
+            result.columns[name] = parts[0]
+        elif any(isinstance(part, np.ma.MaskedArray) for part in parts):
+            result.columns[name] = np.ma.concatenate(parts)
+        else:
+            result.columns[name] = np.concatenate(parts) if parts else np.empty(0, dtype)
+    return result
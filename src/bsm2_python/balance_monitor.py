@@ -0,0 +1,556 @@
+"""Per-step conservation balances of COD, nitrogen and TSS.
+
+A `BalanceMonitor` accounts for one control volume:
+
+    inflow - outflow - conversion - change of inventory = imbalance
+
+Inflows are constant over a step (zero-order hold) and are integrated exactly. Outflows and conversion
+rates depend on the unit states and are integrated with the trapezoidal rule between the start and the
+end of the step. The plant models couple the units sequentially: a downstream unit receives the
+end-of-step outlet of its upstream unit as constant inlet, whereas the upstream unit releases its outlet
+gradually during the step. The mass created or lost by this coupling is booked separately (`coupling`),
+it cancels over time as long as the flows do not change. All remaining persistent losses or productions
+of mass (e.g. an inconsistent connection, a too loose solver tolerance or a non-conservative unit model)
+accumulate in the imbalance. The cumulative imbalance relative to the initial inventory plus the cumulative
+inflow is the drift that is checked against a threshold.
+
+`PlantBalance` builds the control volumes from a BSM1 or BSM2 plant model:
+
+- `activated_sludge`: the five ASM1 reactors and the settler (COD, N, TSS). Conversions are
+  the COD oxidised, the nitrogen lost by denitrification and the TSS produced in the reactors.
+- `digester`: the ADM1 reactor including the ASM2ADM and ADM2ASM interfaces (COD), the produced gas is an outflow.
+"""
+
+import numpy as np
+from numba import jit
+
+from bsm2_python.bsm2.asm1_bsm2 import asm1equations
+from bsm2_python.log import logger
+
+indices_components = np.arange(21)
+SI, SS, XI, XS, XBH, XBA, XP, SO, SNO, SNH, SND, XND, SALK, TSS, Q, TEMP, SD1, SD2, SD3, XD4, XD5 = indices_components
+
+ASM1_QUANTITIES = ('COD', 'N', 'TSS')
+
+# ADM1 states with COD content: S_su ... S_ch4, S_I, X_xc ... X_I
+ADM1_COD_STATES = np.array([0, 1, 2, 3, 4, 5, 6, 7, 8, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23])
+S_GAS_H2, S_GAS_CH4 = 32, 33
+# indices in the ADM1 output vector
+P_GAS, Q_GAS_NORM = 49, 50
+
+
+@jit(nopython=True, cache=True)
+def asm1_content(y, asm1par):
+    """Returns the COD, nitrogen and TSS concentrations of an ASM1 vector.
+
+    Parameters
+    ----------
+    y : np.ndarray(21)
+        ASM1 concentrations. \n
+        [SI, SS, XI, XS, XBH, XBA, XP, SO, SNO, SNH, SND, XND, SALK, TSS, Q, TEMP,
+        SD1, SD2, SD3, XD4, XD5]
+    asm1par : np.ndarray(24)
+        ASM1 parameters, only I_XB and I_XP are used.
+
+    Returns
+    -------
+    content : np.ndarray(3)
+        [COD, N, TSS] [g ⋅ m⁻³].
+    """
+
+    content = np.empty(3)
+    content[0] = y[SI] + y[SS] + y[XI] + y[XS] + y[XBH] + y[XBA] + y[XP]
+    content[1] = y[SNH] + y[SND] + y[XND] + y[SNO] + asm1par[17] * (y[XBH] + y[XBA]) + asm1par[18] * (y[XP] + y[XI])
+    content[2] = y[TSS]
+    return content
+
+
+@jit(nopython=True, cache=True)
+def asm1_loads(streams, asm1par):
+    """Returns the COD, nitrogen and TSS loads of ASM1 streams.
+
+    Parameters
+    ----------
+    streams : np.ndarray(k, 21)
+        ASM1 streams including the flow rate.
+    asm1par : np.ndarray(24)
+        ASM1 parameters.
+
+    Returns
+    -------
+    loads : np.ndarray(3)
+        Summed [COD, N, TSS] loads [g ⋅ d⁻¹].
+    """
+
+    loads = np.zeros(3)
+    for k in range(streams.shape[0]):
+        loads += streams[k, Q] * asm1_content(streams[k], asm1par)
+    return loads
+
+
+@jit(nopython=True, cache=True)
+def asm1_conversion_rates(y, asm1par, kla, volume, tempmodel, activate):
+    """Returns the conversion rates of COD, nitrogen and TSS in an ASM1 reactor.
+
+    The reaction terms are obtained from `asm1equations` without through-flow, so that the
+    kinetics are not duplicated. Positive values are sinks.
+
+    Parameters
+    ----------
+    y : np.ndarray(21)
+        Reactor concentrations.
+    asm1par : np.ndarray(24)
+        ASM1 parameters.
+    kla : float
+        Oxygen transfer coefficient [d⁻¹].
+    volume : float
+        Reactor volume [m³].
+    tempmodel : bool
+        Temperature model of the reactor.
+    activate : bool
+        Dummy states of the reactor.
+
+    Returns
+    -------
+    rates : np.ndarray(3)
+        [COD oxidised, N denitrified, -TSS produced] [g ⋅ d⁻¹].
+    """
+
+    # without flow the transport terms vanish, the temperature stays the one of the reactor
+    y_no_flow = y.copy()
+    y_no_flow[Q] = 0.0
+    reac = asm1equations(0.0, y.copy(), y_no_flow, asm1par, kla, volume, tempmodel, activate)
+    rates = np.empty(3)
+    rates[0] = -(reac[SI] + reac[SS] + reac[XI] + reac[XS] + reac[XBH] + reac[XBA] + reac[XP])
+    rates[1] = -(
+        reac[SNH]
+        + reac[SND]
+        + reac[XND]
+        + reac[SNO]
+        + asm1par[17] * (reac[XBH] + reac[XBA])
+        + asm1par[18] * (reac[XP] + reac[XI])
+    )
+    rates[2] = -(
+        asm1par[19] * reac[XI]
+        + asm1par[20] * reac[XS]
+        + asm1par[21] * reac[XBH]
+        + asm1par[22] * reac[XBA]
+        + asm1par[23] * reac[XP]
+    )
+    return rates * volume
+
+
+@jit(nopython=True, cache=True)
+def settler_content(ys_int, nooflayers, dim, y_underflow, asm1par):
+    """Returns the COD, nitrogen and TSS masses in the layers of the settler.
+
+    The settler only tracks TSS for the particulates. Their composition is taken from the underflow,
+    which carries the composition of the settler inlet.
+
+    Parameters
+    ----------
+    ys_int : np.ndarray(12 * nooflayers)
+        Settler states sorted by components. \n
+        [S_I, S_S, S_O, S_NO, S_NH, S_ND, S_ALK, X_TSS, TEMP, S_D1, S_D2, S_D3]
+    nooflayers : int
+        Number of layers [-].
+    dim : np.ndarray(2)
+        Area and height of the settler [m², m].
+    y_underflow : np.ndarray(21)
+        Underflow (return or waste sludge) of the settler.
+    asm1par : np.ndarray(24)
+        ASM1 parameters.
+
+    Returns
+    -------
+    mass : np.ndarray(3)
+        [COD, N, TSS] [g].
+    """
+
+    layer_volume = dim[0] * dim[1] / nooflayers
+    s_i = ys_int[0:nooflayers].sum()
+    s_s = ys_int[nooflayers : 2 * nooflayers].sum()
+    s_no = ys_int[3 * nooflayers : 4 * nooflayers].sum()
+    s_nh = ys_int[4 * nooflayers : 5 * nooflayers].sum()
+    s_nd = ys_int[5 * nooflayers : 6 * nooflayers].sum()
+    x_tss = ys_int[7 * nooflayers : 8 * nooflayers].sum()
+
+    particulate = y_underflow.copy()
+    particulate[SI] = 0.0
+    particulate[SS] = 0.0
+    particulate[SNO] = 0.0
+    particulate[SNH] = 0.0
+    particulate[SND] = 0.0
+    per_tss = asm1_content(particulate, asm1par)
+    if y_underflow[TSS] > 0.0:
+        per_tss /= y_underflow[TSS]
+    else:
+        per_tss[:] = 0.0
+
+    mass = np.empty(3)
+    mass[0] = s_i + s_s + per_tss[0] * x_tss
+    mass[1] = s_no + s_nh + s_nd + per_tss[1] * x_tss
+    mass[2] = x_tss
+    return mass * layer_volume
+
+
+@jit(nopython=True, cache=True)
+def adm1_cod_content(yd, volume_liq, volume_gas):
+    """Returns the COD mass in the liquid and gas phase of the digester [g]."""
+    liquid = 0.0
+    for k in ADM1_COD_STATES:
+        liquid += yd[k]
+    return 1000.0 * (volume_liq * liquid + volume_gas * (yd[S_GAS_H2] + yd[S_GAS_CH4]))
+
+
+@jit(nopython=True, cache=True)
+def asm1_step_loads(streams_start, streams_end, asm1par, timestep):
+    """Returns the COD, nitrogen and TSS masses carried by ASM1 streams during one step.
+
+    The flow rates of the end of the step hold for the whole step (they are set by the inlets of the units),
+    the concentrations are integrated with the trapezoidal rule.
+
+    Parameters
+    ----------
+    streams_start : np.ndarray(k, 21)
+        Streams at the start of the step.
+    streams_end : np.ndarray(k, 21)
+        Streams at the end of the step.
+    asm1par : np.ndarray(24)
+        ASM1 parameters.
+    timestep : float
+        Length of the step [d].
+
+    Returns
+    -------
+    mass : np.ndarray(3)
+        Summed [COD, N, TSS] masses [g].
+    """
+
+    mass = np.zeros(3)
+    for k in range(streams_end.shape[0]):
+        content = 0.5 * (asm1_content(streams_start[k], asm1par) + asm1_content(streams_end[k], asm1par))
+        mass += timestep * streams_end[k, Q] * content
+    return mass
+
+
+@jit(nopython=True, cache=True)
+def asm1_coupling(outlets_start, outlets_end, asm1par, timestep):
+    """Returns the masses created by passing end-of-step outlets on as constant inlets.
+
+    The downstream unit receives `timestep * Q * c_end`, the upstream unit releases
+    `timestep * Q * (c_start + c_end) / 2`.
+
+    Parameters
+    ----------
+    outlets_start : np.ndarray(k, 21)
+        Outlets at the start of the step.
+    outlets_end : np.ndarray(k, 21)
+        Outlets at the end of the step.
+    asm1par : np.ndarray(24)
+        ASM1 parameters.
+    timestep : float
+        Length of the step [d].
+
+    Returns
+    -------
+    mass : np.ndarray(3)
+        Summed [COD, N, TSS] masses [g].
+    """
+
+    mass = np.zeros(3)
+    for k in range(outlets_end.shape[0]):
+        change = asm1_content(outlets_end[k], asm1par) - asm1_content(outlets_start[k], asm1par)
+        mass += 0.5 * timestep * outlets_end[k, Q] * change
+    return mass
+
+
+class BalanceMonitor:
+    """Creates a BalanceMonitor object for one control volume.
+
+    Parameters
+    ----------
+    quantities : tuple[str] (optional)
+        Names of the balanced quantities. <br>
+        Default is ('COD', 'N', 'TSS').
+    threshold : float (optional)
+        Maximum relative drift, i.e. cumulative imbalance divided by the initial inventory plus the
+        cumulative inflow [-]. <br>
+        Default is 0.01.
+    name : str (optional)
+        Name of the control volume used in warnings. <br>
+        Default is 'plant'.
+    """
+
+    def __init__(self, quantities: tuple = ASM1_QUANTITIES, threshold: float = 0.01, name: str = 'plant'):
+        self.quantities = tuple(quantities)
+        self.threshold = threshold
+        self.name = name
+        self.initial_inventory = None
+        self.inventory = None
+        self._clear()
+
+    def _clear(self):
+        n = len(self.quantities)
+        self.cum_inflow = np.zeros(n)
+        self.cum_outflow = np.zeros(n)
+        self.cum_conversion = np.zeros(n)
+        self.cum_coupling = np.zeros(n)
+        self.imbalance = np.zeros(n)
+        self.step_residual = np.zeros(n)
+        self.flagged = np.zeros(n, dtype=bool)
+        self.flags: list[tuple[int, str, float]] = []
+        self.n_steps = 0
+
+    @property
+    def initialized(self):
+        return self.inventory is not None
+
+    def reset(self, inventory):
+        """Starts the balance at the current inventory of the control volume.
+
+        Parameters
+        ----------
+        inventory : np.ndarray(n)
+            Masses in the control volume [g].
+        """
+
+        self.initial_inventory = np.array(inventory, dtype=float)
+        self.inventory = self.initial_inventory.copy()
+        self._clear()
+
+    def update(self, inflow, outflow, conversion, inventory, step_idx: int | None = None, coupling=None):
+        """Adds one simulation step to the balance.
+
+        Parameters
+        ----------
+        inflow : np.ndarray(n)
+            Masses entering the control volume during the step [g].
+        outflow : np.ndarray(n)
+            Masses leaving the control volume during the step [g].
+        conversion : np.ndarray(n)
+            Masses converted during the step, positive for sinks [g].
+        inventory : np.ndarray(n)
+            Masses in the control volume at the end of the step [g].
+        step_idx : int (optional)
+            Index of the step, used for the flags. <br>
+            Default is the number of updates so far.
+        coupling : np.ndarray(n) (optional)
+            Masses created by the sequential coupling of the units within the control volume [g]. <br>
+            They are tracked separately and do not count as imbalance. Default is zero.
+
+        Returns
+        -------
+        drift : np.ndarray(n)
+            Relative drift after the step [-].
+        """
+
+        if not self.initialized:
+            err = f'Balance {self.name} has to be reset before the first update.'
+            raise RuntimeError(err)
+        inflow = np.asarray(inflow, dtype=float)
+        outflow = np.asarray(outflow, dtype=float)
+        conversion = np.asarray(conversion, dtype=float)
+        inventory = np.asarray(inventory, dtype=float)
+        coupling = np.zeros(len(self.quantities)) if coupling is None else np.asarray(coupling, dtype=float)
+
+        self.step_residual = inflow + coupling - outflow - conversion - (inventory - self.inventory)
+        self.imbalance += self.step_residual
+        self.cum_inflow += inflow
+        self.cum_outflow += outflow
+        self.cum_conversion += conversion
+        self.cum_coupling += coupling
+        self.inventory = inventory.copy()
+
+        step_idx = self.n_steps if step_idx is None else step_idx
+        self.n_steps += 1
+        drift = self.drift
+        for k, quantity in enumerate(self.quantities):
+            exceeded = drift[k] > self.threshold
+            if exceeded and not self.flagged[k]:
+                self.flags.append((step_idx, quantity, float(drift[k])))
+                logger.warning(
+                    '%s balance of %s drifts by %.3g %% at step %s', self.name, quantity, 100 * drift[k], step_idx
+                )
+            self.flagged[k] = exceeded
+        return drift
+
+    @property
+    def drift(self):
+        """Cumulative imbalance relative to the initial inventory plus the cumulative inflow [-]."""
+        return np.abs(self.imbalance) / np.maximum(np.abs(self.initial_inventory) + self.cum_inflow, 1e-12)
+
+    @property
+    def ok(self):
+        """`True` if no quantity exceeds the threshold."""
+        return not self.flagged.any()
+
+    def summary(self):
+        """Returns the cumulative terms of the balance per quantity.
+
+        Returns
+        -------
+        summary : dict{str: dict{str: float}}
+            Inflow, outflow, conversion, coupling, change of inventory and imbalance [g] and drift [-].
+        """
+
+        delta = self.inventory - self.initial_inventory
+        drift = self.drift
+        return {
+            quantity: {
+                'inflow': float(self.cum_inflow[k]),
+                'outflow': float(self.cum_outflow[k]),
+                'conversion': float(self.cum_conversion[k]),
+                'coupling': float(self.cum_coupling[k]),
+                'accumulation': float(delta[k]),
+                'imbalance': float(self.imbalance[k]),
+                'drift': float(drift[k]),
+            }
+            for k, quantity in enumerate(self.quantities)
+        }
+
+
+class PlantBalance:
+    """Creates a PlantBalance object that watches the conservation balances of a BSM1 or BSM2 plant model.
+
+    `observe()` has to be called after every `step()` of the model. The first call only records the
+    state of the plant, the balances start from there.
+
+    Parameters
+    ----------
+    model : BSM1Base | BSM2Base
+        Plant model.
+    threshold : float (optional)
+        Maximum relative drift of all balances [-]. <br>
+        Default is 0.01.
+    """
+
+    def __init__(self, model, threshold: float = 0.01):
+        self.model = model
+        self.reactors = [getattr(model, f'reactor{k}') for k in range(1, 6)]
+        self.asm1par = np.asarray(self.reactors[0].asm1par, dtype=float)
+        self.monitors = {'activated_sludge': BalanceMonitor(ASM1_QUANTITIES, threshold, 'activated_sludge')}
+        self.has_digester = hasattr(model, 'adm1_reactor')
+        if self.has_digester:
+            self.monitors['digester'] = BalanceMonitor(('COD',), threshold, 'digester')
+        self._previous = None
+        self._last_idx = None
+
+    def _snapshot(self):
+        """Copies the unit states and outlet streams at the end of the current step."""
+        model = self.model
+        snapshot = {
+            'reactors': np.array([np.asarray(reactor.y0, dtype=float) for reactor in self.reactors]),
+            'outlets': np.array([model.y_out1, model.y_out2, model.y_out3, model.y_out4, model.y_out5], dtype=float),
+            'outflows': np.array(
+                [
+                    model.y_out5_r,
+                    model.ys_r if hasattr(model, 'ys_r') else model.ys_out,
+                    model.ys_was,
+                    model.ys_of if hasattr(model, 'ys_of') else model.ys_eff,
+                ],
+                dtype=float,
+            ),
+            'settler': np.array(model.settler.ys0, dtype=float),
+        }
+        if self.has_digester:
+            digester = model.adm1_reactor
+            yd = np.array(digester.yd0, dtype=float)
+            q_gas = 0.0
+            if model.yd_out[P_GAS] > 0.0:
+                q_gas = model.yd_out[Q_GAS_NORM] * digester.digesterpar[93] / model.yd_out[P_GAS]
+            snapshot['digester'] = yd
+            snapshot['digester_outflow'] = np.atleast_2d(np.asarray(model.yi_out2, dtype=float))
+            snapshot['gas'] = 1000.0 * q_gas * (yd[S_GAS_H2] + yd[S_GAS_CH4])
+        return snapshot
+
+    def _activated_sludge_inventory(self, snapshot):
+        inventory = np.zeros(3)
+        for reactor, y in zip(self.reactors, snapshot['reactors'], strict=True):
+            inventory += reactor.volume * asm1_content(y, self.asm1par)
+        settler = self.model.settler
+        dim = np.asarray(settler.dim, dtype=float)
+        inventory += settler_content(snapshot['settler'], settler.layer[1], dim, snapshot['outflows'][1], self.asm1par)
+        return inventory
+
+    def _activated_sludge_conversion(self, states):
+        conversion = np.zeros(3)
+        for reactor, y in zip(self.reactors, states, strict=True):
+            asm1par = np.asarray(reactor.asm1par, dtype=float)
+            conversion += asm1_conversion_rates(
+                y, asm1par, reactor.kla, reactor.volume, reactor.tempmodel, reactor.activate
+            )
+        return conversion
+
+    def _update_activated_sludge(self, previous, current, timestep, i):
+        model = self.model
+        inflow = timestep * asm1_loads(np.atleast_2d(model.y_in1), self.asm1par)
+        for reactor in self.reactors:
+            if reactor.carb > 0.0:
+                # the external carbon enters as readily biodegradable substrate
+                inflow[0] += timestep * reactor.carb * reactor.csourceconc
+        outflow = asm1_step_loads(previous['outflows'], current['outflows'], self.asm1par, timestep)
+        conversion_start = self._activated_sludge_conversion(previous['reactors'])
+        conversion_end = self._activated_sludge_conversion(current['reactors'])
+        conversion = 0.5 * timestep * (conversion_start + conversion_end)
+        # reactor outlets pass on to the next reactor and the settler, except for the internal recycle, which
+        # is part of the outflow and returns with the inlet of the next step
+        coupling = asm1_coupling(previous['outlets'], current['outlets'], self.asm1par, timestep) - asm1_coupling(
+            previous['outflows'][:1], current['outflows'][:1], self.asm1par, timestep
+        )
+        inventory = self._activated_sludge_inventory(current)
+        self.monitors['activated_sludge'].update(inflow, outflow, conversion, inventory, i, coupling)
+
+    def _update_digester(self, previous, current, timestep, i):
+        model = self.model
+        digester = model.adm1_reactor
+        inflow = timestep * asm1_loads(np.atleast_2d(model.yd_in), self.asm1par)[:1]
+        liquid = asm1_step_loads(previous['digester_outflow'], current['digester_outflow'], self.asm1par, timestep)
+        gas = 0.5 * timestep * (previous['gas'] + current['gas'])
+        inventory = np.array([adm1_cod_content(current['digester'], digester.volume_liq, digester.volume_gas)])
+        self.monitors['digester'].update(inflow, liquid[:1] + gas, np.zeros(1), inventory, i)
+
+    def observe(self, i: int | None = None):
+        """Adds the last simulated step of the model to the balances.
+
+        Parameters
+        ----------
+        i : int (optional)
+            Index of the simulated step. <br>
+            Default is the step following the previous call.
+
+        Returns
+        -------
+        ok : bool
+            `True` if no balance exceeds its threshold.
+        """
+
+        if i is None:
+            i = 0 if self._last_idx is None else self._last_idx + 1
+        timestep = self.model.timesteps[i]
+        current = self._snapshot()
+        if self._previous is None:
+            self.monitors['activated_sludge'].reset(self._activated_sludge_inventory(current))
+            if self.has_digester:
+                digester = self.model.adm1_reactor
+                inventory = adm1_cod_content(current['digester'], digester.volume_liq, digester.volume_gas)
+                self.monitors['digester'].reset(np.array([inventory]))
+        else:
+            self._update_activated_sludge(self._previous, current, timestep, i)
+            if self.has_digester:
+                self._update_digester(self._previous, current, timestep, i)
+        self._previous = current
+        self._last_idx = i
+        return self.ok
+
+    @property
+    def ok(self):
+        """`True` if no balance exceeds its threshold."""
+        return all(monitor.ok for monitor in self.monitors.values())
+
+    @property
+    def drift(self):
+        """Relative drift per balance and quantity [-]."""
+        return {
+            name: dict(zip(monitor.quantities, monitor.drift, strict=True)) for name, monitor in self.monitors.items()
+        }
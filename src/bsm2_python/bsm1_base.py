@@ -212,7 +212,7 @@ class BSM1Base(BSMBase):
         self.reactor1.kla, self.reactor2.kla, self.reactor3.kla, self.reactor4.kla, self.reactor5.kla = self.klas
 
         # get influent data that is smaller than and closest to current time step
-        y_in_timestep = self.y_in[np.where(self.data_time <= step)[0][-1], :]
+        y_in_timestep = self.y_in[self._influent_row(step), :]
 
         iqi = self.performance.iqi(y_in_timestep)[0]
         self.iqi_all[i] = iqi
@@ -229,7 +229,7 @@ class BSM1Base(BSMBase):
             self.y_out5, (max(self.y_out5[14] - self.qintr, 0.0), float(self.qintr))
         )
 
-        self.ys_out, _, self.ys_eff, self.sludge_height, self.ys_tss_internal = self.settler.output(
+        self.ys_out, self.ys_was, self.ys_eff, self.sludge_height, self.ys_tss_internal = self.settler.output(
             stepsize, step, self.ys_in
         )
 
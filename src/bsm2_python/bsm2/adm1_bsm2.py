@@ -5,6 +5,7 @@ from numba import jit
 from scipy.integrate import odeint
 
 from bsm2_python.bsm2.module import Module
+from bsm2_python.log import logger
 
 # import warnings
 
@@ -104,6 +105,25 @@ class ADM1Reactor(Module):
         No heat losses / transfer embedded!
     temperature : float
         Operational temperature of the anaerobic digester [°C].
+    stride : int
+        Number of time steps integrated at once with the current influent, the outputs are held for the
+        following `stride - 1` calls of `output` (coarse stepping). A change of `stride` takes effect after
+        the held calls, the digester is not integrated again over time steps it has already covered.
+        Default is 1.
+    ph_coupling : str
+        Coupling of the digester pH and the charge balance of the ASM2ADM interface. \n
+        - 'delayed': the interface uses the digester pH of the previous call (default). \n
+        - 'implicit': the interface uses the digester pH at the end of the current step, the algebraic
+          loop is solved by Newton iterations warm-started with the pH and slope of the previous step.
+    ph_tol : float
+        Absolute pH tolerance of the implicit coupling, in the order of the integrator tolerances. Default is 1e-6.
+    ph_maxiter : int
+        Maximum number of Newton iterations of the implicit coupling. Default is 8.
+    ph_iterations : int
+        Number of digester integrations of the last call of `output`.
+    ph_converged : bool
+        `False` if the implicit coupling of the last call of `output` stopped at `ph_maxiter` iterations
+        without reaching `ph_tol`, the state of the last iteration is used then.
     yd_out : np.ndarray(51)
         Effluent concentrations of the 51 components after the ADM1 reactor <br>
         (35 ADM1 components, 9 other gas-related components, Q, T and 5 dummy states). \n
@@ -124,6 +144,21 @@ class ADM1Reactor(Module):
         self.t_op = 0.0
         self.temperature = 0.0
         self.yd_out = np.zeros(51)
+        # tolerances of the integrator
+        self.rtol = 1e-6
+        self.atol = 1e-6
+        # number of time steps per integration, the outputs are held in between (coarse stepping)
+        self.stride = 1
+        self._held = None
+        self._hold_steps = 0
+        # coupling of the digester pH and the interface charge balance
+        self.ph_coupling = 'delayed'
+        self.ph_tol = 1e-6
+        self.ph_maxiter = 8
+        self.ph_iterations = 0
+        self.ph_converged = True
+        self._ph_slope = 0.0  # derivative of the digester pH w.r.t. the interface pH of the last step
+        self._ph_change = 0.0  # digester pH change of the last step
 
     def output(self, timestep, step, y_in1, t_op):
         """Returns the solved differential equations based on ADM1 model.
@@ -167,6 +202,15 @@ class ADM1Reactor(Module):
             Q_D, T_D, S_D1_D, S_D2_D, S_D3_D, X_D4_D, X_D5_D]
         """
 
+        # the held calls are served even if the stride has been changed in the meantime
+        if self._hold_steps > 0 and self._held is not None:
+            self._hold_steps -= 1
+            self.ph_iterations = 0
+            return self._held
+        if self.stride > 1:
+            # integrate the following `stride` time steps at once with the current influent
+            self._hold_steps = self.stride - 1
+            timestep = timestep * self.stride
         self.t_op = t_op
         yd_out = np.zeros(51)
 
@@ -177,50 +221,17 @@ class ADM1Reactor(Module):
         k_h_h2o_base = self.digesterpar[95]
         k_p = self.digesterpar[99]
 
-        t_eval = np.array([step, step + timestep])  # time interval for odeint
-
-        self.y_in1[:21] = y_in1[:21]
-
-        yi_out1 = asm2adm(self.y_in1, t_op, self.interfacepar)
-        # y_out1
-        #  0     1     2     3     4     5      6     7     8      9     10    11   12
-        # [S_SU, S_AA, S_FA, S_VA, S_BU, S_PRO, S_AC, S_H2, S_CH4, S_IC, S_IN, S_I, X_XC,
-        #  13    14    15    16    17    18    19    20     21    22    23   24     25
-        #  X_CH, X_PR, X_LI, X_SU, X_AA, X_FA, X_C4, X_PRO, X_AC, X_H2, X_I, S_CAT, S_AN,
-        #  26   27   28      29      30      31      32
-        #  Q_D, T_D, S_D1_D, S_D2_D, S_D3_D, X_D4_D, X_D5_D]
-        yd_in = np.zeros(42)
-        y_in2 = np.zeros(35)
-
-        # yd_in
-        # 0     1     2     3     4     5      6     7     8      9     10    11   12
-        # S_SU, S_AA, S_FA, S_VA, S_BU, S_PRO, S_AC, S_H2, S_CH4, S_IC, S_IN, S_I, X_XC,
-        # 13    14    15    16    17    18    19     20    21    22   23     24    25
-        # X_CH, X_PR, X_LI, X_SU, X_AA, X_FA, X_C4, X_PRO, X_AC, X_H2, X_I, S_CAT, S_AN,
-        # 26     27     28      29     30      31     32        33         34         35
-        # S_HVA, S_HBU, S_HPRO, S_HAC, S_HCO3, S_NH3, S_GAS_H2, S_GAS_CH4, S_GAS_CO2, Q_D,
-        # 36   37      38      39      40      41
-        # T_D, S_D1_D, S_D2_D, S_D3_D, X_D4_D, X_D5_D
-
-        yd_in[:26] = yi_out1[:26]
-        yd_in[35:] = yi_out1[26:]
-        # [S_SU, S_AA, S_FA, S_VA, S_BU, S_PRO, S_AC, S_H2, S_CH4, S_IC, S_IN, S_I, X_XC, X_CH, X_PR,
-        #  X_LI, X_SU, X_AA, X_FA, X_C4, X_PRO, X_AC, X_H2, X_I, S_CAT, S_AN, S_HVA, S_HBU, S_HPRO, S_HAC,
-        #  S_HCO3, S_NH3, S_GAS_H2, S_GAS_CH4, S_GAS_CO2, Q_D, T_D, S_D1_D, S_D2_D, S_D3_D, X_D4_D, X_D5_D]
-        ode = odeint(
-            adm1equations,
-            self.yd0,
-            t_eval,
-            tfirst=True,
-            args=(yd_in, self.digesterpar, t_op, self.dim),
-            rtol=1e-6,
-            atol=1e-6,
-        )
-        yd_int = ode[1]
-        # [S_SU, S_AA, S_FA, S_VA, S_BU, S_PRO, S_AC, S_H2, S_CH4, S_IC, S_IN, S_I, X_XC, X_CH, X_PR,
-        #  X_LI, X_SU, X_AA, X_FA, X_C4, X_PRO, X_AC, X_H2, X_I, S_CAT, S_AN, S_HVA, S_HBU, S_HPRO, S_HAC,
-        #  S_HCO3, S_NH3, S_GAS_H2, S_GAS_CH4, S_GAS_CO2, Q_D, T_D, S_D1_D, S_D2_D, S_D3_D, X_D4_D, X_D5_D]
+        if self.ph_coupling == 'implicit':
+            yi_out1, yd_in, yd_int = self._implicit_step(timestep, step, y_in1, t_op)
+        elif self.ph_coupling == 'delayed':
+            yi_out1, yd_in, yd_int = self._integrate(timestep, step, y_in1, t_op, self.y_in1[21])
+            self.ph_iterations = 1
+            self.ph_converged = True
+        else:
+            err = f'Unknown pH coupling: {self.ph_coupling}'
+            raise ValueError(err)
         self.yd0[:] = yd_int[:]  # initial integration values for next integration
+        y_in2 = np.zeros(35)
 
         # y = yd_out
         # u = yd_in
@@ -257,17 +268,7 @@ class ADM1Reactor(Module):
         # procT9 = kLa*(yd_int[S_ch4] - 64.0*K_H_ch4*p_gas_ch4)
         # procT10 = kLa*((yd_int[S_IC] - yd_int[S_hco3]) - K_H_co2*p_gas_co2)
 
-        phi = (
-            yd_int[S_CAT]
-            + (yd_int[S_IN] - yd_int[S_NH3])
-            - yd_int[S_HCO3]
-            - yd_int[S_HAC] / 64.0
-            - yd_int[S_HPRO] / 112.0
-            - yd_int[S_HBU] / 160.0
-            - yd_int[S_HVA] / 208.0
-            - yd_int[S_AN]
-        )
-        s_h_ion = -phi * 0.5 + 0.5 * np.sqrt(phi**2 + 4.0 * k_w)
+        s_h_ion = hydrogen_ion(yd_int, k_w)
 
         yd_out[33] = -np.log10(s_h_ion)  # pH
         self.y_in1[21] = yd_out[33]  # pH for ASM2ADM interface
@@ -307,9 +308,133 @@ class ADM1Reactor(Module):
         if step % 10 == 0:
             pass
         self.yd_out = yd_out
+        self._held = (yi_out2, yd_out, yi_out1) if self.stride > 1 else None
 
         return yi_out2, yd_out, yi_out1
 
+    def _integrate(self, timestep, step, y_in1, t_op, ph):
+        """Integrates the digester over one time step with the interface evaluated at the given pH.
+
+        Returns the ADM1 influent after the ASM2ADM interface (33), the digester influent (42) and the
+        digester state at the end of the step (42). The state of the reactor is not changed.
+        """
+
+        t_eval = np.array([step, step + timestep])  # time interval for odeint
+
+        self.y_in1[:21] = y_in1[:21]
+        self.y_in1[21] = ph
+
+        yi_out1 = asm2adm(self.y_in1, t_op, self.interfacepar)
+        # y_out1
+        #  0     1     2     3     4     5      6     7     8      9     10    11   12
+        # [S_SU, S_AA, S_FA, S_VA, S_BU, S_PRO, S_AC, S_H2, S_CH4, S_IC, S_IN, S_I, X_XC,
+        #  13    14    15    16    17    18    19    20     21    22    23   24     25
+        #  X_CH, X_PR, X_LI, X_SU, X_AA, X_FA, X_C4, X_PRO, X_AC, X_H2, X_I, S_CAT, S_AN,
+        #  26   27   28      29      30      31      32
+        #  Q_D, T_D, S_D1_D, S_D2_D, S_D3_D, X_D4_D, X_D5_D]
+        yd_in = np.zeros(42)
+
+        # yd_in
+        # 0     1     2     3     4     5      6     7     8      9     10    11   12
+        # S_SU, S_AA, S_FA, S_VA, S_BU, S_PRO, S_AC, S_H2, S_CH4, S_IC, S_IN, S_I, X_XC,
+        # 13    14    15    16    17    18    19     20    21    22   23     24    25
+        # X_CH, X_PR, X_LI, X_SU, X_AA, X_FA, X_C4, X_PRO, X_AC, X_H2, X_I, S_CAT, S_AN,
+        # 26     27     28      29     30      31     32        33         34         35
+        # S_HVA, S_HBU, S_HPRO, S_HAC, S_HCO3, S_NH3, S_GAS_H2, S_GAS_CH4, S_GAS_CO2, Q_D,
+        # 36   37      38      39      40      41
+        # T_D, S_D1_D, S_D2_D, S_D3_D, X_D4_D, X_D5_D
+
+        yd_in[:26] = yi_out1[:26]
+        yd_in[35:] = yi_out1[26:]
+        # [S_SU, S_AA, S_FA, S_VA, S_BU, S_PRO, S_AC, S_H2, S_CH4, S_IC, S_IN, S_I, X_XC, X_CH, X_PR,
+        #  X_LI, X_SU, X_AA, X_FA, X_C4, X_PRO, X_AC, X_H2, X_I, S_CAT, S_AN, S_HVA, S_HBU, S_HPRO, S_HAC,
+        #  S_HCO3, S_NH3, S_GAS_H2, S_GAS_CH4, S_GAS_CO2, Q_D, T_D, S_D1_D, S_D2_D, S_D3_D, X_D4_D, X_D5_D]
+        ode = odeint(
+            adm1equations,
+            self.yd0,
+            t_eval,
+            tfirst=True,
+            args=(yd_in, self.digesterpar, t_op, self.dim),
+            rtol=self.rtol,
+            atol=self.atol,
+        )
+        yd_int = ode[1]
+        # [S_SU, S_AA, S_FA, S_VA, S_BU, S_PRO, S_AC, S_H2, S_CH4, S_IC, S_IN, S_I, X_XC, X_CH, X_PR,
+        #  X_LI, X_SU, X_AA, X_FA, X_C4, X_PRO, X_AC, X_H2, X_I, S_CAT, S_AN, S_HVA, S_HBU, S_HPRO, S_HAC,
+        #  S_HCO3, S_NH3, S_GAS_H2, S_GAS_CH4, S_GAS_CO2, Q_D, T_D, S_D1_D, S_D2_D, S_D3_D, X_D4_D, X_D5_D]
+        return yi_out1, yd_in, yd_int
+
+    def _implicit_step(self, timestep, step, y_in1, t_op):
+        """Integrates the digester with the interface pH equal to the digester pH at the end of the step.
+
+        Solves ph = F(ph), F being the digester pH after integrating with the interface at pH `ph`, by
+        Newton iterations on g(ph) = F(ph) - ph. The iterations start at the pH of the digester state
+        plus the pH change of the previous step, the derivative of F is taken from secants and carried
+        over to the next step.
+        """
+
+        factor = (1.0 / self.digesterpar[78] - 1.0 / t_op) / (100.0 * self.digesterpar[77])
+        k_w = 10 ** (-self.digesterpar[80]) * math.exp(55900.0 * factor)
+        ph_start = -np.log10(hydrogen_ion(self.yd0, k_w))
+        ph = ph_start + self._ph_change
+        slope = self._ph_slope
+        ph_old = f_old = np.nan
+        iteration = 0
+        while True:
+            iteration += 1
+            yi_out1, yd_in, yd_int = self._integrate(timestep, step, y_in1, t_op, ph)
+            f = -np.log10(hydrogen_ion(yd_int, k_w))
+            if iteration > 1 and ph != ph_old:
+                slope = (f - f_old) / (ph - ph_old)
+            converged = abs(f - ph) <= self.ph_tol
+            if converged or iteration >= self.ph_maxiter:
+                break
+            ph_old, f_old = ph, f
+            # F' is small as the feed is diluted in the digester, the limit keeps the step bounded
+            ph += (f - ph) / (1.0 - min(slope, 0.5))
+        if not converged:
+            logger.warning(
+                'Implicit pH coupling not converged at t = %.4f d after %s iterations, |F(pH) - pH| = %.3e',
+                step,
+                iteration,
+                abs(f - ph),
+            )
+        self.ph_iterations = iteration
+        self.ph_converged = converged
+        self._ph_slope = slope
+        self._ph_change = f - ph_start
+        return yi_out1, yd_in, yd_int
+
+
+@jit(nopython=True, cache=True)
+def hydrogen_ion(yd, k_w):
+    """Returns the hydrogen ion concentration of the digester from the charge balance.
+
+    Parameters
+    ----------
+    yd : np.ndarray(42)
+        Digester state (see `ADM1Reactor`).
+    k_w : float
+        Temperature adjusted ion product of water.
+
+    Returns
+    -------
+    s_h_ion : float
+        Hydrogen ion concentration [kmol/m³].
+    """
+
+    phi = (
+        yd[S_CAT]
+        + (yd[S_IN] - yd[S_NH3])
+        - yd[S_HCO3]
+        - yd[S_HAC] / 64.0
+        - yd[S_HPRO] / 112.0
+        - yd[S_HBU] / 160.0
+        - yd[S_HVA] / 208.0
+        - yd[S_AN]
+    )
+    return -phi * 0.5 + 0.5 * np.sqrt(phi**2 + 4.0 * k_w)
+
 
 @jit(nopython=True, cache=True)
 def adm1equations(t, yd, yd_in, digesterpar, t_op, dim):
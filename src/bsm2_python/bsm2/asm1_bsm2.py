@@ -12,6 +12,12 @@ import numpy as np
 from numba import jit
 from scipy.integrate import odeint
 
+from bsm2_python.bsm2.integrators import (
+    ASM1_STIFF_STATES,
+    hermite_interpolate,
+    imex_integrate,
+    imex_integrate_dense,
+)
 from bsm2_python.bsm2.module import Module
 
 indices_components = np.arange(21)
@@ -269,6 +275,26 @@ class ASM1Reactor(Module):
         otherwise influent wastewater temperature is just passed through process reactors.
     activate : bool
         If true, dummy states are activated, otherwise dummy states are not activated.
+    integrator : str (optional)
+        Integration method. <br>
+        'odeint': LSODA from scipy (default). <br>
+        'imex': Native implicit-explicit scheme, soluble states are treated implicitly.
+    rtol : float (optional)
+        Relative tolerance of the integrator. <br>
+        If not provided, the scipy default is used for 'odeint' and 1e-5 for 'imex'.
+    atol : float (optional)
+        Absolute tolerance of the integrator. <br>
+        If not provided, the scipy default is used for 'odeint' and 1e-4 for 'imex'.
+    dense_output : bool (optional)
+        If `True`, an interpolant of the last integration interval is kept and can be
+        evaluated with `sample` at arbitrary times. 'imex' uses all accepted internal steps,
+        'odeint' a cubic Hermite interpolant between the interval boundaries. <br>
+        Default is `False`.
+    positive : bool (optional)
+        If `True`, the 'imex' integrator projects every stage and accepted step onto non-negative
+        concentrations. The rates in `asm1equations` still clamp negative concentrations, this option
+        only keeps the integrated states from becoming negative. Only available for 'imex'. <br>
+        Default is `False`.
     """
 
     def __init__(
@@ -282,7 +308,18 @@ class ASM1Reactor(Module):
         *,
         tempmodel: bool,
         activate: bool,
+        integrator: str = 'odeint',
+        rtol: float | None = None,
+        atol: float | None = None,
+        dense_output: bool = False,
+        positive: bool = False,
     ):
+        if integrator not in {'odeint', 'imex'}:
+            err = f'Unknown integrator {integrator}. Choose between "odeint" and "imex".'
+            raise ValueError(err)
+        if positive and integrator != 'imex':
+            err = 'The positivity-preserving option is only available for the "imex" integrator.'
+            raise ValueError(err)
         self.kla = kla
         self.volume = volume
         self.y0 = y0
@@ -291,6 +328,13 @@ class ASM1Reactor(Module):
         self.csourceconc = csourceconc
         self.tempmodel = tempmodel
         self.activate = activate
+        self.integrator = integrator
+        self.rtol = rtol
+        self.atol = atol
+        self.h_last = 0.0  # last step size proposed by the native integrator
+        self.dense_output = dense_output
+        self.dense = None  # (ts, ys, fs, y_in) of the last integration interval
+        self.positive = positive
 
     def output(self, timestep: int | float, step: int | float, y_in: np.ndarray) -> np.ndarray:
         """Returns the solved differential equations based on ASM1 model.
@@ -319,16 +363,43 @@ class ASM1Reactor(Module):
         t_eval = np.array([step, step + timestep])  # time interval for odeint
 
         if self.carb > 0.0:
-            y_in = carbonaddition(y_in, self.carb, self.csourceconc)
-
-        ode = odeint(
-            asm1equations,
-            self.y0,
-            t_eval,
-            tfirst=True,
-            args=(y_in, self.asm1par, self.kla, self.volume, self.tempmodel, self.activate),
-        )
-        y_out = ode[1]
+            # carbonaddition works in place, the stream of the upstream unit must not change
+            y_in = carbonaddition(y_in.copy(), self.carb, self.csourceconc)
+
+        args = (y_in, self.asm1par, self.kla, self.volume, self.tempmodel, self.activate)
+        if self.integrator == 'imex':
+            integrate = imex_integrate_dense if self.dense_output else imex_integrate
+            result = integrate(
+                asm1equations,
+                float(step),
+                float(step + timestep),
+                np.asarray(self.y0, dtype=np.float64),
+                args,
+                ASM1_STIFF_STATES,
+                1e-5 if self.rtol is None else self.rtol,
+                1e-4 if self.atol is None else self.atol,
+                self.h_last,
+                self.positive,
+            )
+            y_out, self.h_last = result[0], result[1]
+            if self.dense_output:
+                self.dense = (result[2], result[3], result[4], y_in.copy())
+        else:
+            y_start = np.array(self.y0, dtype=np.float64)
+            ode = odeint(asm1equations, self.y0, t_eval, tfirst=True, args=args, rtol=self.rtol, atol=self.atol)
+            y_out = ode[1]
+            if self.dense_output:
+                ys = np.array([y_start, y_out])
+                fs = np.array([asm1equations(t_eval[k], ys[k].copy(), *args) for k in range(2)])
+                self.dense = (t_eval.astype(np.float64), ys, fs, y_in.copy())
+
+        y_out = self._postprocess(y_out, y_in)
+        self.y0 = y_out  # initial integration values for next integration
+
+        return y_out
+
+    def _postprocess(self, y_out, y_in):
+        """Sets TSS, flow rate, temperature and dummy states of integrated reactor states."""
 
         y_out[TSS] = (
             self.asm1par[19] * y_out[XI]
@@ -345,6 +416,35 @@ class ASM1Reactor(Module):
         if not self.activate:
             y_out[16:20] = 0.0
 
-        self.y0 = y_out  # initial integration values for next integration
-
         return y_out
+
+    def sample(self, t: float | np.ndarray) -> np.ndarray:
+        """Returns the reactor concentrations at arbitrary times within the last integration interval.
+
+        Requires `dense_output=True`.
+
+        Parameters
+        ----------
+        t : float | np.ndarray(m)
+            Sample time(s) within [step, step + timestep] of the last `output` call [d].
+
+        Returns
+        -------
+        y_sample : np.ndarray(21) | np.ndarray(m, 21)
+            Concentrations of the 21 components at the sample time(s). \n
+            [SI, SS, XI, XS, XBH, XBA, XP, SO, SNO, SNH, SND, XND, SALK, TSS, Q, TEMP,
+            SD1, SD2, SD3, XD4, XD5]
+        """
+
+        if self.dense is None:
+            raise ValueError('No dense output available. Set dense_output=True and call output() first.')
+        ts, ys, fs, y_in = self.dense
+        t_query = np.atleast_1d(np.asarray(t, dtype=np.float64))
+        eps = 1e-12 * max(abs(ts[-1]), 1.0)
+        if np.any(t_query < ts[0] - eps) or np.any(t_query > ts[-1] + eps):
+            err = f'Sample times have to be within the last integration interval [{ts[0]}, {ts[-1]}].'
+            raise ValueError(err)
+        y_sample = hermite_interpolate(ts, ys, fs, t_query)
+        for y_row in y_sample:
+            self._postprocess(y_row, y_in)
+        return y_sample[0] if np.ndim(t) == 0 else y_sample
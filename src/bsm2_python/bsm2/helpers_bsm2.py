@@ -2,11 +2,12 @@ import warnings
 from typing import TypedDict
 
 import numpy as np
-from numba import int32
+from numba import float64, int32
 from numba.experimental import jitclass
 from numba.typed import List
 
 from bsm2_python.bsm2.module import Module
+from bsm2_python.bsm2.smoothing import smooth_min
 
 
 @jitclass
@@ -52,7 +53,7 @@ class Combiner(Module):
         return out
 
 
-@jitclass(spec=(('sp_type', int32),))
+@jitclass(spec=(('sp_type', int32), ('smoothing', float64)))
 class Splitter(Module):
     """Splits an array in ASM1 format into multiple arrays in ASM1 format.
 
@@ -63,10 +64,15 @@ class Splitter(Module):
         - 1: Split ratio is specified in splitratio parameter (default).
         - 2: Split ratio is not specified, but a threshold value is specified in qthreshold parameter
                 everything above qthreshold is split into the second flow.
+    smoothing : float (optional)
+        Relative width of the smoothed threshold of type 2 splitters (see `smoothing.smooth_min`). The first
+        flow is at most smoothing ⋅ qthreshold / 2 below min(Q, qthreshold). <br>
+        Default is 0 (sharp threshold).
     """
 
-    def __init__(self, sp_type=1):
+    def __init__(self, sp_type=1, smoothing=0.0):
         self.sp_type = sp_type
+        self.smoothing = smoothing
 
     def output(self, in1: np.ndarray, splitratio: tuple = (0.0, 0.0), qthreshold: float = 0):
         """Splits an array in ASM1 format into multiple arrays in ASM1 format.
@@ -113,7 +119,11 @@ class Splitter(Module):
                 if splitratio[0] != 0 or splitratio[1] != 0:
                     err = 'splitratio[0] and splitratio[1] must be 0 for type 2 splitter'
                     raise ValueError(err)
-                splitratio = (qthreshold, in1[14] - qthreshold) if in1[14] >= qthreshold else (in1[14], 0)
+                if self.smoothing > 0:
+                    q_first = max(smooth_min(in1[14], qthreshold, self.smoothing * qthreshold), 0.0)
+                    splitratio = (q_first, in1[14] - q_first)
+                else:
+                    splitratio = (qthreshold, in1[14] - qthreshold) if in1[14] >= qthreshold else (in1[14], 0)
             for i, _ in enumerate(splitratio):
                 actual_splitratio = splitratio[i] / sum(splitratio)
                 out = np.zeros(21)
@@ -0,0 +1,137 @@
+# Copyright (2006)
+#  Ulf Jeppsson
+#  Dept. Industrial Electrical Engineering and Automation (IEA), Lund University, Sweden
+#  https://www.lth.se/iea/
+
+import numpy as np
+from numba import jit
+from scipy.integrate import odeint
+
+from bsm2_python.bsm2.module import Module
+
+indices_components = np.arange(21)
+SI, SS, XI, XS, XBH, XBA, XP, SO, SNO, SNH, SND, XND, SALK, TSS, Q, TEMP, SD1, SD2, SD3, XD4, XD5 = indices_components
+
+
+@jit(nopython=True, cache=True)
+def hyddelayequations(t, x, y_in, timeconst):
+    """Returns an array containing the differential equations of a first order hydraulic delay.
+
+    The loads (concentration times flow rate) and the flow rate are delayed, the temperature
+    follows the input with the same time constant.
+
+    Parameters
+    ----------
+    t : float
+        Time interval for integration, needed for the solver [d].
+    x : np.ndarray(21)
+        Loads of the 21 components [g ⋅ d⁻¹], flow rate [m³ ⋅ d⁻¹] and temperature [°C]. \n
+        [SI, SS, XI, XS, XBH, XBA, XP, SO, SNO, SNH, SND, XND, SALK, TSS, Q, TEMP,
+        SD1, SD2, SD3, XD4, XD5]
+    y_in : np.ndarray(21)
+        Concentrations of the 21 components at the inlet of the delay
+        (13 ASM1 components, TSS, Q, T and 5 dummy states).
+    timeconst : float
+        Time constant of the delay [d].
+
+    Returns
+    -------
+    dx : np.ndarray(21)
+        Array containing the 21 differential equations of the delayed loads.
+    """
+
+    dx = np.zeros(21)
+    if timeconst > 0.000001:
+        dx[:] = (y_in * y_in[Q] - x) / timeconst
+        dx[Q] = (y_in[Q] - x[Q]) / timeconst
+        dx[TEMP] = (y_in[TEMP] - x[TEMP]) / timeconst
+    return dx
+
+
+class HydraulicDelay(Module):
+    """This implements a first order hydraulic delay of flow rate and loads (hyddelayv3).
+
+    The loads are delayed instead of the concentrations, so that the delay conserves mass.
+    The concentrations at the outlet are recalculated from the delayed loads and the delayed flow rate.
+    TSS is recalculated from the particulate components. For T = 0 the input is passed through.
+
+    Parameters
+    ----------
+    asm1par : np.ndarray(24)
+        ASM1 parameters, only the conversion factors to TSS are used. \n
+        [mu_H, K_S, K_OH, K_NO, b_H, mu_A, K_NH, K_OA, b_A, ny_g, k_a, k_h, K_X, ny_h,
+        Y_H, Y_A, f_P, i_XB, i_XP, X_I2TSS, X_S2TSS, X_BH2TSS, X_BA2TSS, X_P2TSS]
+    timeconst : float
+        Time constant of the delay [d].
+    x0 : np.ndarray(21) (optional)
+        Initial loads [g ⋅ d⁻¹], flow rate [m³ ⋅ d⁻¹] and temperature [°C]. <br>
+        If not provided, the delay starts at steady state with the first input.
+    """
+
+    def __init__(self, asm1par, timeconst, x0=None):
+        self.asm1par = asm1par
+        self.timeconst = timeconst
+        self.x0 = None if x0 is None else np.array(x0, dtype=float)
+        # tolerances of the integrator, None uses the scipy defaults
+        self.rtol = None
+        self.atol = None
+
+    def output(self, timestep, step, y_in):
+        """Returns the concentrations at the outlet of the hydraulic delay.
+
+        Parameters
+        ----------
+        timestep : float
+            Size of integration interval [d].
+        step : float
+            Upper boundary for integration interval [d].
+        y_in : np.ndarray(21)
+            Concentrations of the 21 components at the inlet of the delay
+            (13 ASM1 components, TSS, Q, T and 5 dummy states). \n
+            [SI, SS, XI, XS, XBH, XBA, XP, SO, SNO, SNH, SND, XND, SALK, TSS, Q, TEMP,
+            SD1, SD2, SD3, XD4, XD5]
+
+        Returns
+        -------
+        y_out : np.ndarray(21)
+            Concentrations of the 21 components at the outlet of the delay
+            (13 ASM1 components, TSS, Q, T and 5 dummy states). \n
+            [SI, SS, XI, XS, XBH, XBA, XP, SO, SNO, SNH, SND, XND, SALK, TSS, Q, TEMP,
+            SD1, SD2, SD3, XD4, XD5]
+        """
+
+        if self.timeconst <= 0.000001:
+            return np.array(y_in, dtype=float)
+        if self.x0 is None:
+            self.x0 = y_in * y_in[Q]
+            self.x0[Q] = y_in[Q]
+            self.x0[TEMP] = y_in[TEMP]
+
+        t_eval = np.array([step, step + timestep])  # time interval for odeint
+        odes = odeint(
+            hyddelayequations,
+            self.x0,
+            t_eval,
+            tfirst=True,
+            args=(np.asarray(y_in, dtype=float), self.timeconst),
+            rtol=self.rtol,
+            atol=self.atol,
+        )
+        self.x0 = odes[1]
+        return self.concentrations(self.x0)
+
+    def concentrations(self, x):
+        """Returns the concentrations belonging to the loads `x` of the delay."""
+        y_out = np.zeros(21)
+        if x[Q] > 0:
+            y_out[:] = x / x[Q]
+            y_out[TSS] = (
+                self.asm1par[19] * x[XI]
+                + self.asm1par[20] * x[XS]
+                + self.asm1par[21] * x[XBH]
+                + self.asm1par[22] * x[XBA]
+                + self.asm1par[23] * x[XP]
+            ) / x[Q]
+        y_out[Q] = x[Q]
+        y_out[TEMP] = x[TEMP]
+        return y_out
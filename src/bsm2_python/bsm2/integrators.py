@@ -0,0 +1,283 @@
+"""Native (numba) integrators for the unit models.
+
+The right-hand side functions of the units (e.g. `asm1equations`) are passed as first-class jitted
+functions together with their argument tuple, i.e. they are called as `rhs(t, y, *args)`.
+
+- `imex_integrate`: Implicit-explicit scheme. A small stiff subset of the states (oxygen transfer and fast
+  Monod kinetics on the soluble states) is treated linearly implicit with a dense Jacobian block,
+  all other states are integrated explicitly. Error control by step doubling with Richardson extrapolation.
+- `imex_integrate_dense`: Same scheme, additionally returns the accepted step points and derivatives so that
+  `hermite_interpolate` can sample the solution at arbitrary times without forcing step boundaries.
+
+With `positive=True`, steps leaving the non-negative orthant are rejected instead of relying on the clamping
+of negative concentrations inside the right-hand side.
+"""
+
+import numpy as np
+from numba import jit
+
+indices_components = np.arange(21)
+SI, SS, XI, XS, XBH, XBA, XP, SO, SNO, SNH, SND, XND, SALK, TSS, Q, TEMP, SD1, SD2, SD3, XD4, XD5 = indices_components
+
+# soluble ASM1 states with fast dynamics: substrate, oxygen, nitrate, ammonia, soluble organic nitrogen, alkalinity
+ASM1_STIFF_STATES = np.array([SS, SO, SNO, SNH, SND, SALK])
+
+
+@jit(nopython=True, cache=True)
+def _evaluate(rhs, t, y, args):
+    """Evaluates `rhs` on a copy of `y`, as some unit equations clip the passed state in place."""
+    return rhs(t, y.copy(), *args)
+
+
+@jit(nopython=True, cache=True)
+def stiff_jacobian(rhs, t, y, f0, stiff_idx, args):
+    """Returns the finite difference Jacobian of the stiff states with respect to the stiff states.
+
+    Parameters
+    ----------
+    rhs : function
+        Jitted right-hand side `rhs(t, y, *args)`.
+    t : float
+        Current time [d].
+    y : np.ndarray
+        Current state.
+    f0 : np.ndarray
+        `rhs` evaluated at `(t, y)`.
+    stiff_idx : np.ndarray
+        Indices of the stiff states.
+    args : tuple
+        Additional arguments of `rhs`.
+
+    Returns
+    -------
+    jac : np.ndarray(len(stiff_idx), len(stiff_idx))
+        Jacobian block d f[stiff_idx] / d y[stiff_idx].
+    """
+
+    n_stiff = len(stiff_idx)
+    jac = np.zeros((n_stiff, n_stiff))
+    for j in range(n_stiff):
+        k = stiff_idx[j]
+        delta = 1.5e-8 * max(abs(y[k]), 1.0)
+        y_pert = y.copy()
+        y_pert[k] += delta
+        f_pert = _evaluate(rhs, t, y_pert, args)
+        for i in range(n_stiff):
+            jac[i, j] = (f_pert[stiff_idx[i]] - f0[stiff_idx[i]]) / delta
+    return jac
+
+
+@jit(nopython=True, cache=True)
+def imex_euler_step(y, h, f0, jac, stiff_idx):
+    """One linearly implicit-explicit Euler step.
+
+    Non-stiff states: y + h * f(y). <br>
+    Stiff states: y + (I - h * J)⁻¹ * h * f(y).
+    """
+
+    y_new = y + h * f0
+    n_stiff = len(stiff_idx)
+    lhs = np.eye(n_stiff) - h * jac
+    rhs_stiff = np.empty(n_stiff)
+    for i in range(n_stiff):
+        rhs_stiff[i] = h * f0[stiff_idx[i]]
+    delta = np.linalg.solve(lhs, rhs_stiff)
+    for i in range(n_stiff):
+        y_new[stiff_idx[i]] = y[stiff_idx[i]] + delta[i]
+    return y_new
+
+
+@jit(nopython=True, cache=True)
+def error_norm(err, y_old, y_new, rtol, atol):
+    """Weighted RMS norm of the local error estimate."""
+    acc = 0.0
+    for k in range(len(err)):
+        scale = atol + rtol * max(abs(y_old[k]), abs(y_new[k]))
+        acc += (err[k] / scale) ** 2
+    return np.sqrt(acc / len(err))
+
+
+@jit(nopython=True, cache=True)
+def _undershoot(y, tol):
+    """Returns `True` if a state is below -tol."""
+    for k in range(len(y)):
+        if y[k] < -tol:
+            return True
+    return False
+
+
+@jit(nopython=True, cache=True)
+def _imex_core(rhs, t0, t1, y0, args, stiff_idx, rtol, atol, h_init, record, positive):
+    t = t0
+    y = y0.copy()
+    span = t1 - t0
+    h = min(h_init, span) if h_init > 0 else span
+    h_min = 1e-12 * max(abs(span), 1.0)
+    n_accepted = 0
+    n_rejected = 0
+    f0 = _evaluate(rhs, t, y, args)
+    ts = [t0]
+    ys = [y0.copy()]
+    fs = [f0]
+    while t1 - t > 1e-12 * max(abs(t1), 1.0):
+        h_step = min(h, t1 - t)
+        jac = stiff_jacobian(rhs, t, y, f0, stiff_idx, args)
+
+        y_full = imex_euler_step(y, h_step, f0, jac, stiff_idx)
+        y_half = imex_euler_step(y, 0.5 * h_step, f0, jac, stiff_idx)
+        if positive and h_step > h_min and _undershoot(y_half, 0.0):
+            # the right-hand side is only evaluated at non-negative states, where its clamping is inactive
+            n_rejected += 1
+            h = max(0.25 * h_step, h_min)
+            continue
+        f_half = _evaluate(rhs, t + 0.5 * h_step, y_half, args)
+        y_two = imex_euler_step(y_half, 0.5 * h_step, f_half, jac, stiff_idx)
+
+        err = error_norm(y_two - y_full, y, y_two, rtol, atol)
+        if positive and h_step > h_min and _undershoot(y_two, 0.0):
+            # an undershoot means the step is too large, treat it like an error
+            err = max(err, 4.0)
+        if err <= 1.0 or h_step <= h_min:
+            t += h_step
+            y = 2.0 * y_two - y_full
+            if positive and _undershoot(y, 0.0):
+                # the extrapolation may undershoot close to zero, fall back to the two half steps
+                y = np.maximum(y_two, 0.0)
+            f0 = _evaluate(rhs, t, y, args)
+            n_accepted += 1
+            if record:
+                ts.append(t)
+                ys.append(y.copy())
+                fs.append(f0)
+        else:
+            n_rejected += 1
+        factor = 5.0 if err == 0.0 else min(5.0, max(0.2, 0.9 / np.sqrt(err)))
+        h = max(h_step * factor, h_min)
+    return y, h, n_accepted, n_rejected, ts, ys, fs
+
+
+@jit(nopython=True, cache=True)
+def imex_integrate(rhs, t0, t1, y0, args, stiff_idx, rtol, atol, h_init, positive=False):
+    """Integrates `rhs` from `t0` to `t1` with the adaptive IMEX scheme.
+
+    Every step is computed once with step size h and twice with h/2 (sharing the Jacobian block),
+    the difference is the error estimate and the extrapolated value 2 * y_h/2 - y_h is accepted.
+
+    Parameters
+    ----------
+    rhs : function
+        Jitted right-hand side `rhs(t, y, *args)`.
+    t0 : float
+        Start time [d].
+    t1 : float
+        End time [d].
+    y0 : np.ndarray
+        Initial state.
+    args : tuple
+        Additional arguments of `rhs`.
+    stiff_idx : np.ndarray
+        Indices of the states treated implicitly.
+    rtol : float
+        Relative tolerance.
+    atol : float
+        Absolute tolerance.
+    h_init : float
+        Initial step size [d], e.g. the last accepted step size of the previous call.
+    positive : bool (optional)
+        If `True`, the states are kept non-negative: steps whose intermediate stage or result is negative
+        are rejected and retried with a smaller step size, an undershooting extrapolation falls back to the
+        two half steps. The right-hand side is only evaluated at non-negative states, so its clamping of
+        negative concentrations is never active. <br>
+        Default is `False`.
+
+    Returns
+    -------
+    y : np.ndarray
+        State at `t1`.
+    h : float
+        Proposed next step size [d].
+    n_accepted : int
+        Number of accepted steps.
+    n_rejected : int
+        Number of rejected steps.
+    """
+
+    y, h, n_accepted, n_rejected, _, _, _ = _imex_core(
+        rhs, t0, t1, y0, args, stiff_idx, rtol, atol, h_init, False, positive
+    )
+    return y, h, n_accepted, n_rejected
+
+
+@jit(nopython=True, cache=True)
+def imex_integrate_dense(rhs, t0, t1, y0, args, stiff_idx, rtol, atol, h_init, positive=False):
+    """Integrates like `imex_integrate` and additionally returns the data for dense output.
+
+    Returns
+    -------
+    y : np.ndarray
+        State at `t1`.
+    h : float
+        Proposed next step size [d].
+    ts : np.ndarray(k)
+        Times of the accepted step points including `t0` and `t1` [d].
+    ys : np.ndarray(k, n)
+        States at `ts`.
+    fs : np.ndarray(k, n)
+        Derivatives at `ts`.
+    """
+
+    y, h, _, _, ts_list, ys_list, fs_list = _imex_core(
+        rhs, t0, t1, y0, args, stiff_idx, rtol, atol, h_init, True, positive
+    )
+    n_points = len(ts_list)
+    ts = np.empty(n_points)
+    ys = np.empty((n_points, len(y0)))
+    fs = np.empty((n_points, len(y0)))
+    for k in range(n_points):
+        ts[k] = ts_list[k]
+        ys[k] = ys_list[k]
+        fs[k] = fs_list[k]
+    return y, h, ts, ys, fs
+
+
+@jit(nopython=True, cache=True)
+def hermite_interpolate(ts, ys, fs, t_query):
+    """Samples a piecewise cubic Hermite interpolant through the accepted step points.
+
+    Parameters
+    ----------
+    ts : np.ndarray(k)
+        Sorted times of the step points [d].
+    ys : np.ndarray(k, n)
+        States at `ts`.
+    fs : np.ndarray(k, n)
+        Derivatives at `ts`.
+    t_query : np.ndarray(m)
+        Sample times within [ts[0], ts[-1]] [d].
+
+    Returns
+    -------
+    y_query : np.ndarray(m, n)
+        Interpolated states at `t_query`.
+    """
+
+    n_points = len(ts)
+    y_query = np.empty((len(t_query), ys.shape[1]))
+    for q in range(len(t_query)):
+        t = t_query[q]
+        if n_points == 1:
+            y_query[q] = ys[0]
+            continue
+        k = np.searchsorted(ts, t, side='right') - 1
+        k = min(max(k, 0), n_points - 2)
+        h = ts[k + 1] - ts[k]
+        if h <= 0.0:
+            y_query[q] = ys[k + 1]
+            continue
+        s = (t - ts[k]) / h
+        h00 = (1.0 + 2.0 * s) * (1.0 - s) ** 2
+        h10 = s * (1.0 - s) ** 2
+        h01 = s**2 * (3.0 - 2.0 * s)
+        h11 = s**2 * (s - 1.0)
+        y_query[q] = h00 * ys[k] + h10 * h * fs[k] + h01 * ys[k + 1] + h11 * h * fs[k + 1]
+    return y_query
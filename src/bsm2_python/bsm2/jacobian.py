@@ -0,0 +1,317 @@
+"""Compressed finite difference Jacobians for units and plants without analytic derivatives.
+
+A plain finite difference Jacobian needs one evaluation of the right-hand side per state. Most unit
+equations are sparse, e.g. every layer of the settler only exchanges with its neighbours, so that columns
+without common nonzero rows can be perturbed together:
+
+- `detect_sparsity`: Jacobian pattern from finite differences at a few randomly perturbed states,
+  optionally combined with a known structural pattern (e.g. `settler_sparsity`).
+- `colour_columns`: greedy colouring of the column intersection graph (structurally orthogonal columns
+  get the same colour).
+- `ColouredJacobian`: finite differences with one evaluation (two for central differences) per colour.
+
+The pattern is detected once per model. Dependencies that vanish at all probed states (e.g. on one side of
+a switching condition) are not found by perturbation and have to be given as structure, otherwise they
+corrupt the entries of the columns sharing their colour.
+"""
+
+import numpy as np
+
+from bsm2_python.log import logger
+
+
+def _step_sizes(x, rel_step, min_scale):
+    return rel_step * np.maximum(np.abs(x), min_scale)
+
+
+def fd_jacobian(func, x, f0=None, rel_step: float = 1.49e-8, min_scale: float = 1.0):
+    """Returns the dense forward difference Jacobian of `func` at `x` (one evaluation per state).
+
+    Parameters
+    ----------
+    func : Callable[[np.ndarray], np.ndarray]
+        Right-hand side F(x).
+    x : np.ndarray(n)
+        State.
+    f0 : np.ndarray(m) (optional)
+        `func(x)`.
+    rel_step : float (optional)
+        Relative perturbation. <br>
+        Default is 1.49e-8 (square root of the machine precision).
+    min_scale : float (optional)
+        Lower bound of the state magnitude used for the perturbation. <br>
+        Default is 1.
+
+    Returns
+    -------
+    jac : np.ndarray(m, n)
+        dF/dx.
+    """
+
+    x = np.asarray(x, dtype=float)
+    if f0 is None:
+        f0 = func(x.copy())
+    delta = _step_sizes(x, rel_step, min_scale)
+    jac = np.empty((len(f0), len(x)))
+    for j in range(len(x)):
+        x_pert = x.copy()
+        x_pert[j] += delta[j]
+        jac[:, j] = (func(x_pert) - f0) / delta[j]
+    return jac
+
+
+def detect_sparsity(
+    func,
+    x,
+    *,
+    n_probes: int = 3,
+    spread: float = 0.2,
+    structure=None,
+    seed: int = 0,
+    rel_step: float = 1.49e-8,
+    min_scale: float = 1.0,
+):
+    """Returns the sparsity pattern of the Jacobian of `func` near `x`.
+
+    The pattern is the union of the nonzero entries of dense finite difference Jacobians at `x` and at
+    `n_probes - 1` states randomly perturbed by the relative `spread`, so that entries vanishing by chance at
+    `x` are found. This costs n_probes ⋅ (n + 1) evaluations and is done once per model.
+
+    Parameters
+    ----------
+    func : Callable[[np.ndarray], np.ndarray]
+        Right-hand side F(x).
+    x : np.ndarray(n)
+        Representative state.
+    n_probes : int (optional)
+        Number of probed states. <br>
+        Default is 3.
+    spread : float (optional)
+        Relative random perturbation of the additional probes. <br>
+        Default is 0.2.
+    structure : np.ndarray(m, n) (optional)
+        Known structural nonzeros, combined with the detected pattern.
+    seed : int (optional)
+        Seed of the random perturbations. <br>
+        Default is 0.
+    rel_step : float (optional)
+        Relative finite difference perturbation. <br>
+        Default is 1.49e-8.
+    min_scale : float (optional)
+        Lower bound of the state magnitude used for the perturbation. <br>
+        Default is 1.
+
+    Returns
+    -------
+    pattern : np.ndarray(m, n)
+        `True` for structurally nonzero entries of dF/dx.
+    """
+
+    x = np.asarray(x, dtype=float)
+    rng = np.random.default_rng(seed)
+    pattern = None
+    for probe in range(n_probes):
+        x_probe = x if probe == 0 else x * (1.0 + spread * rng.uniform(-1.0, 1.0, len(x)))
+        nonzero = fd_jacobian(func, x_probe, rel_step=rel_step, min_scale=min_scale) != 0.0
+        pattern = nonzero if pattern is None else pattern | nonzero
+    if structure is not None:
+        pattern = pattern | np.asarray(structure, dtype=bool)
+    return pattern
+
+
+def colour_columns(pattern):
+    """Returns a colouring of the columns of `pattern` such that columns of one colour share no nonzero row.
+
+    Greedy colouring in the order of decreasing column count (largest first).
+
+    Parameters
+    ----------
+    pattern : np.ndarray(m, n)
+        Sparsity pattern of the Jacobian.
+
+    Returns
+    -------
+    colours : np.ndarray(n)
+        Colour of every column, numbered from 0.
+    """
+
+    pattern = np.asarray(pattern, dtype=bool)
+    n = pattern.shape[1]
+    colours = np.full(n, -1, dtype=int)
+    # rows already occupied by the columns of every colour
+    occupied = []
+    for j in np.argsort(-pattern.sum(axis=0), kind='stable'):
+        rows = pattern[:, j]
+        for colour, used in enumerate(occupied):
+            if not np.any(used & rows):
+                used |= rows
+                colours[j] = colour
+                break
+        else:
+            colours[j] = len(occupied)
+            occupied.append(rows.copy())
+    return colours
+
+
+def compress(pattern, colours):
+    """Returns the nonzero entries of `pattern` grouped by colour, e.g. for jitted finite difference kernels.
+
+    Returns
+    -------
+    ptr : np.ndarray(n_colours + 1)
+        The entries of colour c are `rows[ptr[c]:ptr[c + 1]]`, `cols[ptr[c]:ptr[c + 1]]`.
+    rows : np.ndarray(nnz)
+        Row indices of the nonzero entries.
+    cols : np.ndarray(nnz)
+        Column indices of the nonzero entries.
+    """
+
+    rows, cols = np.nonzero(pattern)
+    order = np.argsort(colours[cols], kind='stable')
+    rows, cols = rows[order], cols[order]
+    n_colours = int(colours.max()) + 1 if len(colours) else 0
+    ptr = np.searchsorted(colours[cols], np.arange(n_colours + 1)).astype(np.int64)
+    return ptr, rows.astype(np.int64), cols.astype(np.int64)
+
+
+def bandwidth(pattern):
+    """Returns the lower and upper bandwidth (ml, mu) of a square sparsity pattern."""
+    rows, cols = np.nonzero(pattern)
+    if len(rows) == 0:
+        return 0, 0
+    return int(max(np.max(rows - cols), 0)), int(max(np.max(cols - rows), 0))
+
+
+def settler_sparsity(nooflayers: int, tempmodel: bool = True):
+    """Returns the structural Jacobian pattern of `settlerequations`.
+
+    Every component only exchanges with the neighbouring layers, the sedimentation flux of the TSS
+    depends on the TSS of the neighbouring layers (both sides of the flux limitation and of the
+    clarification threshold are included). The pattern is tridiagonal within every component block.
+
+    Parameters
+    ----------
+    nooflayers : int
+        Number of layers of the settler.
+    tempmodel : bool (optional)
+        If `False`, the temperature states have a vanishing right-hand side. <br>
+        Default is `True`.
+
+    Returns
+    -------
+    pattern : np.ndarray(12 ⋅ nooflayers, 12 ⋅ nooflayers)
+        `True` for structurally nonzero entries.
+    """
+
+    block = np.eye(nooflayers, dtype=bool) | np.eye(nooflayers, k=1, dtype=bool) | np.eye(nooflayers, k=-1, dtype=bool)
+    blocks = [block] * 12
+    if not tempmodel:
+        blocks[8] = np.zeros_like(block)
+    pattern = np.zeros((12 * nooflayers, 12 * nooflayers), dtype=bool)
+    for k, blk in enumerate(blocks):
+        pattern[k * nooflayers : (k + 1) * nooflayers, k * nooflayers : (k + 1) * nooflayers] = blk
+    return pattern
+
+
+class ColouredJacobian:
+    """Creates a ColouredJacobian object.
+
+    Parameters
+    ----------
+    func : Callable[[np.ndarray], np.ndarray]
+        Right-hand side F(x). Must not change the passed state.
+    x0 : np.ndarray(n)
+        Representative state for the sparsity detection.
+    pattern : np.ndarray(m, n) (optional)
+        Sparsity pattern. <br>
+        If not provided, it is detected with `detect_sparsity` at `x0`.
+    structure : np.ndarray(m, n) (optional)
+        Known structural nonzeros, combined with the detected pattern.
+    central : bool (optional)
+        If `True`, central differences are used (two evaluations per colour). States in [0, step) are
+        differentiated one-sided, as most unit equations clip negative concentrations. <br>
+        Default is `False`.
+    rel_step : float (optional)
+        Relative perturbation of the states. <br>
+        Default is 1.49e-8 for forward and 6e-6 for central differences.
+    min_scale : float (optional)
+        Lower bound of the state magnitude used for the perturbation. <br>
+        Default is 1.
+    n_probes : int (optional)
+        Number of probed states for the sparsity detection. <br>
+        Default is 3.
+    """
+
+    def __init__(
+        self,
+        func,
+        x0,
+        *,
+        pattern=None,
+        structure=None,
+        central: bool = False,
+        rel_step: float | None = None,
+        min_scale: float = 1.0,
+        n_probes: int = 3,
+    ):
+        self.func = func
+        self.central = central
+        self.rel_step = rel_step if rel_step is not None else (6e-6 if central else 1.49e-8)
+        self.min_scale = min_scale
+        if pattern is None:
+            pattern = detect_sparsity(
+                func, x0, n_probes=n_probes, structure=structure, rel_step=self.rel_step, min_scale=min_scale
+            )
+        self.pattern = np.asarray(pattern, dtype=bool)
+        self.colours = colour_columns(self.pattern)
+        self.n_colours = int(self.colours.max()) + 1 if len(self.colours) else 0
+        ptr, rows, cols = compress(self.pattern, self.colours)
+        self._entries = [(rows[ptr[c] : ptr[c + 1]], cols[ptr[c] : ptr[c + 1]]) for c in range(self.n_colours)]
+        self._groups = [np.where(self.colours == c)[0] for c in range(self.n_colours)]
+        logger.debug(
+            'Coloured Jacobian: %s states, %s nonzeros, %s colours', self.pattern.shape[1], len(rows), self.n_colours
+        )
+
+    def __call__(self, x, f0=None):
+        """Returns the Jacobian dF/dx at `x`.
+
+        Parameters
+        ----------
+        x : np.ndarray(n)
+            State.
+        f0 : np.ndarray(m) (optional)
+            `func(x)`, saves one evaluation for forward differences.
+
+        Returns
+        -------
+        jac : np.ndarray(m, n)
+            dF/dx, zero outside of the pattern.
+        """
+
+        x = np.asarray(x, dtype=float)
+        delta = _step_sizes(x, self.rel_step, self.min_scale)
+        if self.central:
+            # one-sided differences for states that would be clipped
+            delta_minus = np.where((x >= 0.0) & (x < delta), 0.0, delta)
+        else:
+            if f0 is None:
+                f0 = self.func(x.copy())
+            delta_minus = np.zeros_like(delta)
+        jac = np.zeros(self.pattern.shape)
+        for group, (rows, cols) in zip(self._groups, self._entries):
+            x_plus = x.copy()
+            x_plus[group] += delta[group]
+            f_plus = self.func(x_plus)
+            if self.central:
+                x_minus = x.copy()
+                x_minus[group] -= delta_minus[group]
+                f_minus = self.func(x_minus)
+            else:
+                f_minus = f0
+            jac[rows, cols] = (f_plus[rows] - f_minus[rows]) / (delta[cols] + delta_minus[cols])
+        return jac
+
+    @property
+    def evaluations(self):
+        """Number of evaluations of the right-hand side per Jacobian."""
+        return self.n_colours * (2 if self.central else 1)
@@ -118,6 +118,9 @@ class PrimaryClarifier(Module):
         self.x_vector = x_vector
         self.tempmodel = tempmodel
         self.activate = activate
+        # tolerances of the integrator, None uses the scipy defaults
+        self.rtol = None
+        self.atol = None
 
     def output(self, timestep, step, yp_in):
         """Returns the overflow and underflow concentrations from a
@@ -170,7 +173,13 @@ class PrimaryClarifier(Module):
         t_eval = np.array([step, step + timestep])  # time interval for odeint
 
         ode = odeint(
-            primclarequations, self.yp0, t_eval, tfirst=True, args=(yp_in, self.p_par, self.volume, self.tempmodel)
+            primclarequations,
+            self.yp0,
+            t_eval,
+            tfirst=True,
+            args=(yp_in, self.p_par, self.volume, self.tempmodel),
+            rtol=self.rtol,
+            atol=self.atol,
         )
 
         yp_int = ode[1]
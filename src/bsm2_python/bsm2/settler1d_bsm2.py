@@ -13,13 +13,14 @@ from numba import jit
 from scipy.integrate import odeint
 
 from bsm2_python.bsm2.module import Module
+from bsm2_python.bsm2.smoothing import smooth_min, smooth_step
 
 indices_components = np.arange(21)
 SI, SS, XI, XS, XBH, XBA, XP, SO, SNO, SNH, SND, XND, SALK, TSS, Q, TEMP, SD1, SD2, SD3, XD4, XD5 = indices_components
 
 
 @jit(nopython=True, cache=True)
-def settlerequations(t, ys, ys_in, sedpar, dim, layer, q_r, q_w, tempmodel, modeltype):
+def settlerequations(t, ys, ys_in, sedpar, dim, layer, q_r, q_w, tempmodel, modeltype, smoothing=0.0):
     """Returns an array containing the differential equations of a non-reactive sedimentation tank
     with variable number of layers (default model is 10 layers), which is compatible with ASM1 model.
 
@@ -58,6 +59,13 @@ def settlerequations(t, ys, ys_in, sedpar, dim, layer, q_r, q_w, tempmodel, mode
         - 0: Model with nooflayers for solubles (IWA/COST Benchmark).
         - 1: Model with 1 layer for solubles (GSP-X implementation) (not implemented yet).
         - 2: Model with 0 layers for solubles (old WEST implementation) (not implemented yet).
+    smoothing : float (optional)
+        Relative width of the smoothed switches, see `bsm2_python.bsm2.smoothing`. The flux limitation
+        min(J_i, J_i+1) and the cap of the settling velocity at v0_max are replaced by `smooth_min`
+        with width smoothing ⋅ (J_i + J_i+1) resp. smoothing ⋅ v0_max, the clarification threshold by
+        `smooth_step` with width smoothing ⋅ X_t. Each flux deviates by at most smoothing ⋅ (J_i + J_i+1) / 2
+        plus the blending of the threshold within a few widths of X_t. <br>
+        Default is 0 (original switches).
 
     Returns
     -------
@@ -103,6 +111,8 @@ def settlerequations(t, ys, ys_in, sedpar, dim, layer, q_r, q_w, tempmodel, mode
             np.exp(-sedpar[2] * (ystemp[i + 7 * nooflayers] - sedpar[4] * ys_in[TSS]))
             - np.exp(-sedpar[3] * (ystemp[i + 7 * nooflayers] - sedpar[4] * ys_in[TSS]))
         )  # ystemp[i+7*nooflayers] is TSS
+        if smoothing > 0.0:
+            vs[i] = smooth_min(vs[i], sedpar[0], smoothing * sedpar[0])
         vs[vs > sedpar[0]] = sedpar[0]
         vs[vs < 0.0] = 0.0
 
@@ -112,7 +122,15 @@ def settlerequations(t, ys, ys_in, sedpar, dim, layer, q_r, q_w, tempmodel, mode
 
     # sludge flux due to sedimentation of each layer:
     for i in range(nooflayers - 1):
-        if i < (feedlayer - 1 - eps) and ystemp[i + 1 + 7 * nooflayers] <= sedpar[5]:
+        if smoothing > 0.0:
+            js_min = smooth_min(js_temp[i], js_temp[i + 1], smoothing * (js_temp[i] + js_temp[i + 1]))
+            if i < (feedlayer - 1 - eps):
+                # weight of the flux limitation above the threshold concentration X_t
+                limited = smooth_step(ystemp[i + 1 + 7 * nooflayers] - sedpar[5], smoothing * sedpar[5])
+                js[i + 1] = (1.0 - limited) * js_temp[i] + limited * js_min
+            else:
+                js[i + 1] = js_min
+        elif i < (feedlayer - 1 - eps) and ystemp[i + 1 + 7 * nooflayers] <= sedpar[5]:
             js[i + 1] = js_temp[i]
         elif js_temp[i] < js_temp[i + 1]:
             js[i + 1] = js_temp[i]
@@ -419,6 +437,34 @@ def get_output(ys_int, ys_in, nooflayers, tempmodel, q_r, q_w, dim, asm1par, sed
     return ys_ret, ys_was, ys_eff, sludge_height, ys_tss_internal
 
 
+def remap_layers(values, nooflayers):
+    """Returns layer averages on a grid of `nooflayers` equal layers.
+
+    Conservative remapping between uniform layer grids: every new layer gets the overlap-weighted mean of
+    the old layers, so that the total mass of every component is preserved.
+
+    Parameters
+    ----------
+    values : np.ndarray(..., n)
+        Layer averages, sorted from top to bottom along the last axis.
+    nooflayers : int
+        Number of layers of the new grid.
+
+    Returns
+    -------
+    remapped : np.ndarray(..., nooflayers)
+        Layer averages on the new grid.
+    """
+
+    values = np.asarray(values, dtype=float)
+    edges_old = np.linspace(0.0, 1.0, values.shape[-1] + 1)
+    edges_new = np.linspace(0.0, 1.0, nooflayers + 1)
+    upper = np.maximum(edges_new[:-1, None], edges_old[None, :-1])
+    weights = np.clip(np.minimum(edges_new[1:, None], edges_old[None, 1:]) - upper, 0.0, None)
+    weights /= weights.sum(axis=1, keepdims=True)
+    return values @ weights.T
+
+
 class Settler(Module):
     """This is a implementation defining a n-layer settler model.
 
@@ -474,6 +520,13 @@ class Settler(Module):
         self.asm1par = asm1par
         self.tempmodel = tempmodel
         self.modeltype = modeltype
+        # tolerances of the integrator, None uses the scipy defaults
+        self.rtol = None
+        self.atol = None
+        # relative width of the smoothed flux switches, 0 uses the original switches (see `settlerequations`)
+        self.smoothing = 0.0
+        # layers of the constructed settler, `set_layers` may simulate with fewer layers
+        self.full_layer = np.array(layer)
 
         if self.modeltype != 0:
             err = 'Model type not implemented yet. Choose modeltype = 0'
@@ -538,7 +591,9 @@ class Settler(Module):
             self.ys0,
             t_eval,
             tfirst=True,
-            args=(ys_in, self.sedpar, self.dim, self.layer, q_r, q_w, self.tempmodel, self.modeltype),
+            args=(ys_in, self.sedpar, self.dim, self.layer, q_r, q_w, self.tempmodel, self.modeltype, self.smoothing),
+            rtol=self.rtol,
+            atol=self.atol,
         )
         ys_int = odes[1]
         self.ys0 = ys_int
@@ -546,5 +601,30 @@ class Settler(Module):
         ys_ret, ys_was, ys_eff, sludge_height, ys_tss_internal = get_output(
             ys_int, ys_in, nooflayers, self.tempmodel, self.q_r, self.q_w, self.dim, self.asm1par, self.sedpar
         )
+        if nooflayers != self.full_layer[1]:
+            ys_tss_internal = remap_layers(ys_tss_internal, self.full_layer[1])
 
         return ys_ret, ys_was, ys_eff, sludge_height, ys_tss_internal
+
+    def set_layers(self, nooflayers):
+        """Changes the number of layers simulated by the settler.
+
+        The state is remapped conservatively (see `remap_layers`), the feed layer is placed at the height of
+        the original feed layer. The internal TSS output keeps the resolution of the constructed settler.
+
+        Parameters
+        ----------
+        nooflayers : int
+            Number of layers, e.g. 5 for a faster and less accurate settler with 10 layers.
+        """
+
+        old = int(self.layer[1])
+        if nooflayers == old:
+            return
+        self.ys0 = remap_layers(np.reshape(self.ys0, (12, old)), nooflayers).ravel()
+        full_feed, full_n = self.full_layer
+        if nooflayers == full_n:
+            self.layer = self.full_layer.copy()
+        else:
+            feedlayer = max(int(np.ceil(full_feed * nooflayers / full_n)), 1)
+            self.layer = np.array((feedlayer, nooflayers), dtype=self.full_layer.dtype)
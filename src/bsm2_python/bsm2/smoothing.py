@@ -0,0 +1,31 @@
+"""Smooth replacements for the switching functions of the unit models.
+
+The settler flux limitation, the clarification threshold, the storage bypass and the threshold splitter
+switch between branches with `min` or `if`. The kinks are harmless for time integration with small steps,
+but spoil the Jacobians of steady-state and sensitivity computations. The functions below replace them by
+smooth approximations with a width `w`; `w = 0` recovers the original switch exactly.
+
+- `smooth_min(a, b, w)`: 0.5 ⋅ (a + b - sqrt((a - b)² + w²)). Never larger than min(a, b), the deviation
+  is at most w / 2 (reached for a = b) and below w² / (4 ⋅ |a - b|) away from the kink.
+- `smooth_step(x, w)`: 0.5 ⋅ (1 + tanh(x / w)) instead of the Heaviside step H(x). The deviation is at most
+  0.5 (at x = 0) and below exp(-2 ⋅ |x| / w) away from the switching point.
+"""
+
+import numpy as np
+from numba import jit
+
+
+@jit(nopython=True, cache=True)
+def smooth_min(a, b, w):
+    """Returns a smooth lower approximation of min(a, b) with width `w` (deviation at most w / 2)."""
+    if w <= 0.0:
+        return min(a, b)
+    return 0.5 * (a + b - np.sqrt((a - b) ** 2 + w**2))
+
+
+@jit(nopython=True, cache=True)
+def smooth_step(x, w):
+    """Returns a smooth approximation of the Heaviside step H(x) with width `w`, H(0) is taken as 1."""
+    if w <= 0.0:
+        return 1.0 if x >= 0.0 else 0.0
+    return 0.5 * (1.0 + np.tanh(x / w))
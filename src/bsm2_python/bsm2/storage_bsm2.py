@@ -14,6 +14,7 @@ from scipy.integrate import odeint
 
 from bsm2_python.bsm2.helpers_bsm2 import Combiner
 from bsm2_python.bsm2.module import Module
+from bsm2_python.bsm2.smoothing import smooth_step
 
 indices_components = np.arange(22)
 SI, SS, XI, XS, XBH, XBA, XP, SO, SNO, SNH, SND, XND, SALK, TSS, Q, TEMP, SD1, SD2, SD3, XD4, XD5, VOL = (
@@ -108,6 +109,11 @@ class Storage(Module):
         self.activate = activate
         self.yst0 = yst0
         self.bypasscombiner = Combiner()
+        # tolerances of the integrator, None uses the scipy defaults
+        self.rtol = None
+        self.atol = None
+        # relative width of the smoothed bypass and emptying switches, 0 keeps the sharp switches
+        self.smoothing = 0.0
 
     def output(self, timestep, step, yst_in, qstorage):
         """Returns the solved differential equations for the storage tank.
@@ -143,31 +149,49 @@ class Storage(Module):
         yst_in1[:21] = yst_in[:]
         yst_bp[:] = yst_in[:]
 
-        if (self.curr_vol <= (0.9 * self.max_vol)) & (self.curr_vol >= (0.1 * self.max_vol)):
-            yst_in1[14] = yst_in[14]
-            # qstorage = qstorage
-            yst_bp[14] = 0
-
-        if (self.curr_vol >= (0.9 * self.max_vol)) & (yst_in[14] > qstorage):
-            yst_in1[14] = 0
-            qstorage = 0
-            yst_bp[14] = yst_in[14]
-
-        if (self.curr_vol >= (0.9 * self.max_vol)) & (yst_in[14] <= qstorage):
-            yst_in1[14] = yst_in[14]
-            # qstorage = qstorage
-            yst_bp[14] = 0
-
-        if self.curr_vol <= (0.1 * self.max_vol):
-            yst_in1[14] = yst_in[14]
-            qstorage = 0
-            yst_bp[14] = 0
+        if self.smoothing > 0:
+            # smooth bypass fraction: full tank and inflow above the default flow rate
+            full = smooth_step(self.curr_vol - 0.9 * self.max_vol, self.smoothing * self.max_vol)
+            excess = smooth_step(yst_in[14] - qstorage, self.smoothing * qstorage)
+            empty = smooth_step(0.1 * self.max_vol - self.curr_vol, self.smoothing * self.max_vol)
+            bypass = full * excess
+            yst_in1[14] = (1 - bypass) * yst_in[14]
+            yst_bp[14] = bypass * yst_in[14]
+            qstorage = qstorage * (1 - bypass) * (1 - empty)
+        else:
+            if (self.curr_vol <= (0.9 * self.max_vol)) & (self.curr_vol >= (0.1 * self.max_vol)):
+                yst_in1[14] = yst_in[14]
+                # qstorage = qstorage
+                yst_bp[14] = 0
+
+            if (self.curr_vol >= (0.9 * self.max_vol)) & (yst_in[14] > qstorage):
+                yst_in1[14] = 0
+                qstorage = 0
+                yst_bp[14] = yst_in[14]
+
+            if (self.curr_vol >= (0.9 * self.max_vol)) & (yst_in[14] <= qstorage):
+                yst_in1[14] = yst_in[14]
+                # qstorage = qstorage
+                yst_bp[14] = 0
+
+            if self.curr_vol <= (0.1 * self.max_vol):
+                yst_in1[14] = yst_in[14]
+                qstorage = 0
+                yst_bp[14] = 0
 
         yst_in1[21] = qstorage
 
         t_eval = np.array([step, step + timestep])  # time interval for odeint
 
-        ode = odeint(storageequations, self.yst0, t_eval, tfirst=True, args=(yst_in1, self.tempmodel, self.activate))
+        ode = odeint(
+            storageequations,
+            self.yst0,
+            t_eval,
+            tfirst=True,
+            args=(yst_in1, self.tempmodel, self.activate),
+            rtol=self.rtol,
+            atol=self.atol,
+        )
 
         yst_int = ode[1]
         # y = yst_out
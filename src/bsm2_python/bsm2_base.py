@@ -28,6 +28,7 @@ from bsm2_python.bsm2.settler1d_bsm2 import Settler
 from bsm2_python.bsm2.storage_bsm2 import Storage
 from bsm2_python.bsm2.thickener_bsm2 import Thickener
 from bsm2_python.bsm_base import BSMBase
+from bsm2_python.derived_quantities import DerivedQuantities
 
 path_name = os.path.dirname(__file__)
 
@@ -281,8 +282,47 @@ class BSM2Base(BSMBase):
 
         self.qintr = asm1init.QINTR
         self.y_out5_r[14] = self.qintr
+
+        self.derived = DerivedQuantities()
+        self._declare_derived_quantities()
         # --8<-- [end:step_7]
 
+    def _declare_derived_quantities(self):
+        """Declares the derived quantities evaluated once per step.
+
+        Subclasses can extend the graph by overriding this method and calling `super()`.
+        """
+
+        self.derived.declare(
+            'tss_mass',
+            lambda: self.performance.tss_mass_bsm2(
+                self.yp_of,
+                self.yp_uf,
+                self.yp_internal,
+                self.y_out1,
+                self.y_out2,
+                self.y_out3,
+                self.y_out4,
+                self.y_out5,
+                self.ys_tss_internal,
+                self.yd_out,
+                self.yst_out,
+                self.yst_vol,
+            ),
+        )
+        self.derived.declare('ydw_s_tss_flow', lambda: self.performance.tss_flow(self.ydw_s))
+        self.derived.declare('y_eff_tss_flow', lambda: self.performance.tss_flow(self.y_eff))
+        self.derived.declare(
+            'added_carbon_mass',
+            lambda: self.performance.added_carbon_mass(
+                reginit.CARB1 + reginit.CARB2 + reginit.CARB3 + reginit.CARB4 + reginit.CARB5,
+                reginit.CARBONSOURCECONC,
+            ),
+        )
+        self.derived.declare('heat_demand', lambda: self.performance.heat_demand_step(self.yd_in, reginit.T_OP)[0])
+        self.derived.declare('gas_production', lambda: self.performance.gas_production(self.yd_out, reginit.T_OP))
+        self.derived.declare('electricity_demand', lambda: self.ae + self.pe + self.me)
+
     # --8<-- [start:step_8]
     def step(self, i: int, *args, **kwargs):
         # --8<-- [end:step_8]
@@ -304,7 +344,7 @@ class BSM2Base(BSMBase):
 
         # --8<-- [start:step_10]
         # get influent data that is smaller than and closest to current time step
-        y_in_timestep = self.y_in[np.where(self.data_time <= step)[0][-1], :]
+        y_in_timestep = self.y_in[self._influent_row(step), :]
 
         iqi = self.performance.iqi(y_in_timestep)[0]
         self.iqi_all[i] = iqi
@@ -321,8 +361,8 @@ class BSM2Base(BSMBase):
 
         # --8<-- [start:step_12]
         y_bp_as, y_as_bp_c_eff = self.bypass_reactor.output(y_c_as_bp, (1 - reginit.QBYPASSAS, reginit.QBYPASSAS))
-        y_in1 = self.combiner_reactor.output(self.ys_r, y_bp_as, self.yst_sp_as, self.yt_sp_as, self.y_out5_r)
-        self.y_out1 = self.reactor1.output(stepsize, step, y_in1)
+        self.y_in1 = self.combiner_reactor.output(self.ys_r, y_bp_as, self.yst_sp_as, self.yt_sp_as, self.y_out5_r)
+        self.y_out1 = self.reactor1.output(stepsize, step, self.y_in1)
         self.y_out2 = self.reactor2.output(stepsize, step, self.y_out1)
         self.y_out3 = self.reactor3.output(stepsize, step, self.y_out2)
         self.y_out4 = self.reactor4.output(stepsize, step, self.y_out3)
@@ -376,29 +416,17 @@ class BSM2Base(BSMBase):
         # --8<-- [end:step_15]
 
         # --8<-- [start:step_16]
-        tss_mass = self.performance.tss_mass_bsm2(
-            self.yp_of,
-            self.yp_uf,
-            self.yp_internal,
-            self.y_out1,
-            self.y_out2,
-            self.y_out3,
-            self.y_out4,
-            self.y_out5,
-            self.ys_tss_internal,
-            self.yd_out,
-            self.yst_out,
-            self.yst_vol,
-        )
+        # all units are updated, derived quantities of this step are evaluated lazily from here on
+        self.derived.invalidate(i)
+        tss_mass = self.derived['tss_mass']
         # --8<-- [end:step_16]
 
         # --8<-- [start:step_17]
-        ydw_s_tss_flow = self.performance.tss_flow(self.ydw_s)
-        y_eff_tss_flow = self.performance.tss_flow(self.y_eff)
-        carb = reginit.CARB1 + reginit.CARB2 + reginit.CARB3 + reginit.CARB4 + reginit.CARB5
-        added_carbon_mass = self.performance.added_carbon_mass(carb, reginit.CARBONSOURCECONC)
-        self.heat_demand = self.performance.heat_demand_step(self.yd_in, reginit.T_OP)[0]
-        ch4_prod, h2_prod, co2_prod, q_gas = self.performance.gas_production(self.yd_out, reginit.T_OP)
+        ydw_s_tss_flow = self.derived['ydw_s_tss_flow']
+        y_eff_tss_flow = self.derived['y_eff_tss_flow']
+        added_carbon_mass = self.derived['added_carbon_mass']
+        self.heat_demand = self.derived['heat_demand']
+        ch4_prod, h2_prod, co2_prod, q_gas = self.derived['gas_production']
         # --8<-- [end:step_17]
 
         # --8<-- [start:step_18]
@@ -405,7 +405,7 @@ class BSM2CustomLayout(BSMBase):
 
         # wwtp simulation step
         # get influent data that is smaller than and closest to current time step
-        y_in_timestep = self.y_in[np.where(self.data_time <= step)[0][-1], :]
+        y_in_timestep = self.y_in[self._influent_row(step), :]
 
         iqi = self.performance.iqi(y_in_timestep)[0]
         self.iqi_all[i] = iqi
@@ -186,6 +186,7 @@ class BSM2OLEM(BSM2Base):
         self.contr_prices_all = np.zeros((len(self.simtime), 1))
         self.prices_all = np.zeros((len(self.simtime), 1))
         self.income_all = np.zeros((len(self.simtime), 1))
+        self.net_electricity_all = np.zeros(len(self.simtime))
         self.klas_all = np.zeros((len(self.simtime), len(self.klas)))
         self.chps_electricity_all = np.zeros((len(self.simtime), len(self.chps)))
         self.chps_heat_all = np.zeros((len(self.simtime), len(self.chps)))
@@ -212,7 +213,7 @@ class BSM2OLEM(BSM2Base):
         if self.stabilized:
             # Energy Management
             gas_production, gas_parameters = self.get_gas_production()
-            electricity_demand = self.ae + self.pe + self.me
+            electricity_demand = self.derived['electricity_demand']
             # aeration efficiency in standard conditions in process water (sae),
             # 25 kgO2/kWh, src: T. Frey, Invent Umwelt- und Verfahrenstechnik AG
             # alpha_sae = 2.5
@@ -281,6 +282,7 @@ class BSM2OLEM(BSM2Base):
             )
 
             net_electricity = electricity_demand - chp_production
+            self.net_electricity_all[i] = net_electricity
 
             el_price_idx = np.argmin(np.abs(self.controller.price_times - self.simtime[i]))
             self.income_all[i] = self.economics.get_income(net_electricity, self.simtime, i)
@@ -296,26 +298,12 @@ class BSM2OLEM(BSM2Base):
                 'electricity', [electricity_demand, self.controller.electricity_prices[el_price_idx]], self.simtime[i]
             )
 
-            tss_mass = self.performance.tss_mass_bsm2(
-                self.yp_of,
-                self.yp_uf,
-                self.yp_internal,
-                self.y_out1,
-                self.y_out2,
-                self.y_out3,
-                self.y_out4,
-                self.y_out5,
-                self.ys_tss_internal,
-                self.yd_out,
-                self.yst_out,
-                self.yst_vol,
-            )
-            ydw_s_tss_flow = self.performance.tss_flow(self.ydw_s)
-            y_eff_tss_flow = self.performance.tss_flow(self.y_eff)
-            carb = reginit.CARB1 + reginit.CARB2 + reginit.CARB3 + reginit.CARB4 + reginit.CARB5
-            added_carbon_mass = self.performance.added_carbon_mass(carb, reginit.CARBONSOURCECONC)
-            self.heat_demand = self.performance.heat_demand_step(self.yd_in, reginit.T_OP)[0]
-            ch4_prod, h2_prod, co2_prod, q_gas = self.performance.gas_production(self.yd_out, reginit.T_OP)
+            # already evaluated in BSM2Base.step, values are taken from the per-step cache
+            tss_mass = self.derived['tss_mass']
+            ydw_s_tss_flow = self.derived['ydw_s_tss_flow']
+            y_eff_tss_flow = self.derived['y_eff_tss_flow']
+            added_carbon_mass = self.derived['added_carbon_mass']
+            ch4_prod, h2_prod, co2_prod, q_gas = self.derived['gas_production']
             # This calculates an approximate oci value for each time step,
             # neglecting changes in the tss mass inside the whole plant
             self.oci_all[i] = self.oci_dynamic(
@@ -368,6 +356,29 @@ class BSM2OLEM(BSM2Base):
 
         self.finish_evaluation()
 
+    def evaluate_price_scenarios(self, electricity_prices: np.ndarray, price_times: np.ndarray | None = None):
+        """Re-prices the recorded net electricity of a finished simulation under alternative tariffs.
+
+        Parameters
+        ----------
+        electricity_prices : np.ndarray(p) | np.ndarray(m, p)
+            One price series or one row per price scenario [€ ⋅ MWh⁻¹].
+        price_times : np.ndarray(p) (optional)
+            Times of the price series [d]. <br>
+            If not provided, the times of the default price series are used.
+
+        Returns
+        -------
+        income : np.ndarray(m, n)
+            Income per scenario and step [€].
+        expenditures : np.ndarray(m, n)
+            Expenditures per scenario and step [€].
+        cum_cash_flow : np.ndarray(m, n)
+            Cumulative balance per scenario and step [€].
+        """
+
+        return self.economics.evaluate_batch(self.net_electricity_all, self.simtime, electricity_prices, price_times)
+
     def get_gas_production(self):
         """Returns the gas production of the plant.
 
@@ -4,12 +4,12 @@ It models basic input and output data,
 and deals with model-independent parameters.
 """
 
-import csv
 import os
 
 import numpy as np
 
 from bsm2_python.evaluation import Evaluation
+from bsm2_python.influent import load_influent, read_influent
 from bsm2_python.log import logger
 
 path_name = os.path.dirname(__file__)
@@ -26,7 +26,8 @@ class BSMBase:
         Influent data. Has to be a 2D array. <br>
         First column is time [d], the rest are 21 components
         (13 ASM1 components, TSS, Q, T and 5 dummy states).
-        If a string is provided, it is interpreted as a file name.
+        If a string is provided, it is interpreted as a file name of a CSV file or a binary influent store
+        (`.npy`), see `influent.read_influent`.
         If not provided, the influent data from BSM2 is used. \n
         [SI, SS, XI, XS, XBH, XBA, XP, SO, SNO, SNH, SND, XND, SALK, TSS, Q, TEMP, SD1, SD2, SD3, XD4, XD5]
     timestep : float (optional)
@@ -58,11 +59,9 @@ class BSMBase:
     ):
         if data_in is None:
             # dyninfluent from BSM2:
-            with open(path_name + '/data/dyninfluent_bsm2.csv', encoding='utf-8-sig') as f:
-                self.data_in = np.array(list(csv.reader(f, delimiter=','))).astype(float)
+            self.data_in = read_influent(path_name + '/data/dyninfluent_bsm2.csv')
         elif isinstance(data_in, str):
-            with open(data_in, encoding='utf-8-sig') as f:
-                self.data_in = np.array(list(csv.reader(f, delimiter=','))).astype(float)
+            self.data_in = load_influent(data_in)
         elif isinstance(data_in, np.ndarray):
             self.data_in = data_in.astype(float)
         else:
@@ -136,6 +135,8 @@ class BSMBase:
 
         self.stabilized = False
         self.evaluator = Evaluation(data_out)
+        # index of the next time step simulated by `advance`
+        self.next_step = 0
 
     def __repr__(self):
         return f'BSMBase(data_in={self.data_in}, timesteps={len(self.timesteps)}, \
@@ -168,6 +169,108 @@ class BSMBase:
         """
         raise NotImplementedError('Child classes must implement the simulate() method.')
 
+    def advance(self, n_steps: int, *, callback=None, sample_time: float | None = None, record=None, observer=None):
+        """Simulates the next `n_steps` time steps, starting at `next_step`.
+
+        The steps are simulated by calling `step` from Python, the step sequence is not compiled: the units
+        integrate with `odeint`, which takes about 90 % of the time of a BSM1 step, the dispatch of the
+        step the remaining 10 %. `advance` saves the loop and the bookkeeping of the caller, not the
+        Python calls per step.
+
+        Parameters
+        ----------
+        n_steps : int
+            Number of time steps to simulate. Limited to the remaining steps of `simtime`.
+        callback : Callable[[BSMBase, int], dict | None] (optional)
+            Called before the step at every sample instant with the model and the step index,
+            e.g. to change setpoints or KLa values. A returned dict is passed as keyword arguments
+            to `step` until the next sample instant.
+        sample_time : float (optional)
+            Sample time of the callback [d]. A step is a sample instant if it is the first one of
+            `advance` or if it starts a new sample period. <br>
+            If not provided, the callback is called before every step.
+        record : list[str] (optional)
+            Names of the recorded quantities, e.g. ['y_eff'] for `y_eff_all`. <br>
+            If not provided, all arrays recorded per time step are returned.
+        observer : Callable[[BSMBase, int], bool | None] (optional)
+            Called after every step with the model and the step index, e.g. `OperationalIndicators`.
+            If it returns `True`, the simulation stops after this step.
+
+        Returns
+        -------
+        recorded : dict{str: np.ndarray}
+            'simtime' and the recorded quantities of the simulated steps.
+            The arrays are views of the preallocated `<name>_all` arrays of the model.
+        """
+
+        start = self.next_step
+        stop = min(start + max(int(n_steps), 0), len(self.simtime))
+        if callback is None:
+            sample_steps = ()
+        elif sample_time is None:
+            sample_steps = range(start, stop)
+        else:
+            periods = np.floor(self.simtime[start:stop] / sample_time + 1e-9)
+            sample_steps = start + np.flatnonzero(np.diff(periods, prepend=-np.inf) > 0)
+        sample_steps = set(np.asarray(sample_steps, dtype=int).tolist())
+
+        step_kwargs = {}
+        for i in range(start, stop):
+            if i in sample_steps:
+                step_kwargs = callback(self, i) or step_kwargs
+            self.step(i, **step_kwargs)
+            self.next_step = i + 1
+            if observer is not None and observer(self, i):
+                logger.info('Simulation stopped by the observer after step %s', i)
+                stop = i + 1
+                break
+        return self._recorded(start, stop, record)
+
+    def run_until(self, t: float, **kwargs):
+        """Simulates all time steps starting before `t`, see `advance`.
+
+        Parameters
+        ----------
+        t : float
+            Time until which the plant is simulated [d].
+        **kwargs
+            Keyword arguments of `advance`.
+
+        Returns
+        -------
+        recorded : dict{str: np.ndarray}
+            'simtime' and the recorded quantities of the simulated steps.
+        """
+
+        n_steps = int(np.searchsorted(self.simtime, t, side='left')) - self.next_step
+        return self.advance(max(n_steps, 0), **kwargs)
+
+    def _influent_row(self, t: float) -> int:
+        """Returns the row of the influent data that is smaller than and closest to time `t`."""
+        row = int(np.searchsorted(self.data_time, t, side='right')) - 1
+        if row < 0:
+            err = f'No influent data at t = {t} d, the influent data starts at {self.data_time[0]} d.'
+            raise ValueError(err)
+        return row
+
+    def _recorded(self, start: int, stop: int, record=None):
+        """Returns views of the arrays recorded per time step for the steps `start` ... `stop - 1`."""
+        n = len(self.simtime)
+        if record is None:
+            record = [
+                name[:-4]
+                for name, value in vars(self).items()
+                if name.endswith('_all') and isinstance(value, np.ndarray) and value.shape[:1] == (n,)
+            ]
+        recorded = {'simtime': self.simtime[start:stop]}
+        for name in record:
+            values = getattr(self, f'{name}_all', None)
+            if values is None:
+                err = f'{name}_all is not recorded by {type(self).__name__}.'
+                raise ValueError(err)
+            recorded[name] = values[start:stop]
+        return recorded
+
     def _stabilize(self, check_vars: list[str], atol: float = 1e-3):
         """Stabilizes the plant.
 
@@ -0,0 +1,506 @@
+"""Numerical continuation of plant steady states over design and operating parameters.
+
+Instead of re-stabilising the plant by dynamic simulation for every value of a swept parameter, the
+steady state F(x, p) = 0 is tracked with pseudo-arclength continuation:
+
+- predictor: step of length ds along the tangent of the solution branch,
+- corrector: chord Newton iteration on F(x, p) = 0 together with the arclength condition,
+  reusing the LU factorisation of the Jacobian of the previous point as long as it contracts,
+- detection: folds (the parameter component of the tangent changes sign) and stability changes
+  (the largest real part of the Jacobian eigenvalues changes sign).
+
+States with an identically vanishing right-hand side (flow rate, dummy states, temperature without
+temperature model) and states that stay zero are not part of the steady-state problem and are kept at
+their initial value.
+
+`activated_sludge_problem` and `digester_problem` build F for the activated sludge line (KLa, waste
+flow rate, internal and external recycle) and the anaerobic digester (operational temperature).
+"""
+
+from collections.abc import Callable
+from dataclasses import dataclass, field
+
+import numpy as np
+from scipy.linalg import lu_factor, lu_solve
+
+from bsm2_python.bsm2.adm1_bsm2 import adm1equations, asm2adm
+from bsm2_python.bsm2.jacobian import ColouredJacobian, fd_jacobian
+from bsm2_python.kla_adjoint import N_REACTORS, line_parameters, line_rhs, line_sparsity
+from bsm2_python.log import logger
+
+# positions of the swept quantities in the parameter tuple of `line_rhs`
+LINE_FLOW_PARAMETERS = {'qintr': 4, 'qr': 5, 'qw': 6}
+
+
+def damped_update(x, delta, tau: float = 0.9):
+    """Returns x - alpha * delta with the largest alpha (at most 1) that keeps positive states positive.
+
+    Positive states may shrink at most by the fraction `tau` per update. States that are practically zero
+    do not restrict the step (they would block any progress), they are projected back to zero instead.
+
+    Returns
+    -------
+    x_new : np.ndarray
+        Updated state.
+    alpha : float
+        Applied step fraction.
+    """
+
+    shrinking = (x > 1e-12) & (delta > 0.0)
+    alpha = min(1.0, tau * np.min(x[shrinking] / delta[shrinking])) if np.any(shrinking) else 1.0
+    x_new = x - alpha * delta
+    x_new[(x >= 0.0) & (x_new < 0.0)] = 0.0
+    return x_new, alpha
+
+
+@dataclass
+class ContinuationResult:
+    """Solution branch of a continuation run.
+
+    parameters : np.ndarray(k)
+        Parameter values of the points.
+    states : np.ndarray(k, n)
+        Steady states of the points.
+    max_real_eigenvalue : np.ndarray(k)
+        Largest real part of the Jacobian eigenvalues [d⁻¹]. Negative values indicate stable steady states.
+    stable : np.ndarray(k)
+        `True` for stable steady states.
+    folds : list[int]
+        Indices of the points after which the branch turns back in the parameter (fold / saddle-node).
+    stability_changes : list[int]
+        Indices of the points after which the stability changes.
+    n_rhs : int
+        Number of evaluations of the right-hand side.
+    n_factorisations : int
+        Number of Jacobian evaluations and LU factorisations.
+    """
+
+    parameters: np.ndarray
+    states: np.ndarray
+    max_real_eigenvalue: np.ndarray
+    stable: np.ndarray
+    folds: list = field(default_factory=list)
+    stability_changes: list = field(default_factory=list)
+    n_rhs: int = 0
+    n_factorisations: int = 0
+
+
+class SteadyStateContinuation:
+    """Creates a SteadyStateContinuation object.
+
+    Parameters
+    ----------
+    func : Callable[[np.ndarray, float], np.ndarray]
+        Right-hand side F(x, p) of the plant or unit.
+    x0 : np.ndarray(n)
+        Initial guess of the steady state at `p0`, e.g. the current state of a stabilised model.
+    p0 : float
+        Initial parameter value.
+    ds : float (optional)
+        Initial arclength step in scaled variables. <br>
+        Default is 0.05.
+    ds_min : float (optional)
+        Smallest arclength step before the run is stopped. <br>
+        Default is 1e-5.
+    ds_max : float (optional)
+        Largest arclength step. <br>
+        Default is 0.5.
+    tol : float (optional)
+        Convergence tolerance of the scaled Newton updates. <br>
+        Default is 1e-8.
+    max_corrector : int (optional)
+        Maximum number of corrector iterations per point. <br>
+        Default is 10.
+    structure : np.ndarray(n, n) (optional)
+        Known structural nonzeros of dF/dx, combined with the sparsity pattern detected at `x0`
+        (see `bsm2_python.bsm2.jacobian`). Required for dependencies hidden by switching conditions,
+        e.g. `line_sparsity` for the activated sludge line.
+    """
+
+    def __init__(
+        self,
+        func: Callable,
+        x0,
+        p0: float,
+        *,
+        ds: float = 0.05,
+        ds_min: float = 1e-5,
+        ds_max: float = 0.5,
+        tol: float = 1e-8,
+        max_corrector: int = 10,
+        structure=None,
+    ):
+        self._func = func
+        self.x_full = np.array(x0, dtype=float)
+        self.p0 = float(p0)
+        self.ds = ds
+        self.ds_min = ds_min
+        self.ds_max = ds_max
+        self.tol = tol
+        self.max_corrector = max_corrector
+        self.n_rhs = 0
+        self.n_factorisations = 0
+
+        f0 = self.func_full(self.x_full, self.p0)
+        jac_x = fd_jacobian(lambda x: self.func_full(x, self.p0), self.x_full, f0, rel_step=1e-8, min_scale=1e-3)
+        dynamic = (np.abs(jac_x).sum(axis=1) > 0.0) | (f0 != 0.0)
+        # states without inflow that stay zero (e.g. cations in the digester), Newton steps would push them
+        # below zero where the unit equations clip them
+        vanishing = (np.abs(self.x_full) < 1e-14) & (np.abs(f0) < 1e-14)
+        self.active = np.where(dynamic & ~vanishing)[0]
+        # scaling of the states and of the parameter for the arclength
+        self.x_scale = 1.0 + np.abs(self.x_full[self.active])
+        self.p_scale = max(abs(self.p0), 1.0)
+        # the states enter the arclength as root mean square, so that they weigh as much as the parameter
+        self.arc_scale = self.x_scale * np.sqrt(len(self.active))
+
+        # compressed central differences with a relative perturbation: the pH of the digester follows from a
+        # charge balance with strong cancellation, one-sided differences of trace states are too inaccurate
+        if structure is not None:
+            structure = np.asarray(structure, dtype=bool)[np.ix_(self.active, self.active)]
+        self._p = self.p0
+        self._jac_x = ColouredJacobian(
+            lambda x: self.func(x, self._p),
+            self.x_full[self.active],
+            structure=structure,
+            central=True,
+            rel_step=1e-8,
+            min_scale=1e-3,
+        )
+
+    def func_full(self, x, p):
+        self.n_rhs += 1
+        return self._func(x, p)
+
+    def _expand(self, x_active):
+        x = self.x_full.copy()
+        x[self.active] = x_active
+        return x
+
+    def func(self, x_active, p):
+        """Right-hand side restricted to the active states."""
+        return self.func_full(self._expand(x_active), p)[self.active]
+
+    def jacobian(self, x_active, p):
+        """Jacobians of the restricted right-hand side with respect to the active states and the parameter."""
+        self.n_factorisations += 1
+        self._p = p
+        jac_x = self._jac_x(x_active)
+        delta = 1e-8 * max(abs(p), 1.0)
+        jac_p = (self.func(x_active, p + delta) - self.func(x_active, p - delta)) / (2.0 * delta)
+        return jac_x, jac_p
+
+    def solve(self, x_active, p, max_steps: int = 400):
+        """Solves F(x, p) = 0 at fixed parameter by pseudo-transient continuation.
+
+        Implicit Euler steps with growing step size are taken until the step size is so large that
+        the implicit Euler step is Newton's method for F(x, p) = 0. Updates are damped so that positive
+        concentrations stay positive.
+
+        Parameters
+        ----------
+        x_active : np.ndarray
+            Initial guess of the active states.
+        p : float
+            Parameter value.
+        max_steps : int (optional)
+            Maximum number of pseudo time steps. <br>
+            Default is 400.
+
+        Returns
+        -------
+        x_active : np.ndarray
+            Steady state of the active states.
+        """
+
+        x = np.array(x_active, dtype=float)
+        identity = np.eye(len(x))
+        h = 1e-3
+        for _ in range(max_steps):
+            z, converged = self._implicit_euler(x, p, h, identity)
+            if not converged:
+                h *= 0.25
+                if h < 1e-8:
+                    break
+                continue
+            change = np.max(np.abs(z - x) / self.x_scale)
+            x = z
+            if h >= 1e6 and change < 1e2 * self.tol:
+                return x
+            h = min(h * 4.0, 1e8)
+        err = f'Steady state at parameter {p} not found.'
+        raise RuntimeError(err)
+
+    def _implicit_euler(self, x, p, h, identity):
+        """Solves z - x - h * F(z, p) = 0 by a damped Newton method.
+
+        The damping uses the natural monotonicity test: the simplified Newton correction of the trial point
+        has to be smaller than the Newton correction. Unlike the residual norm, this is insensitive to the
+        scaling of the equations (the acid-base rates of the digester are about 1e10 times faster than the
+        biological rates).
+        """
+
+        z = x.copy()
+        f_z = self.func(z, p)
+        for _ in range(self.max_corrector):
+            jac_x, _ = self.jacobian(z, p)
+            lu = lu_factor(identity - h * jac_x)
+            delta = lu_solve(lu, z - x - h * f_z)
+            size = np.max(np.abs(delta) / self.x_scale)
+            if size < self.tol:
+                return damped_update(z, delta)[0], True
+            z_new, alpha = damped_update(z, delta)
+            for _ in range(20):
+                f_new = self.func(z_new, p)
+                delta_bar = lu_solve(lu, z_new - x - h * f_new)
+                if np.max(np.abs(delta_bar) / self.x_scale) < (1.0 - 0.5 * alpha) * size:
+                    break
+                alpha *= 0.5
+                z_new, _ = damped_update(z, alpha * delta)
+            else:
+                return z, False
+            z, f_z = z_new, f_new
+        return z, False
+
+    def _augmented(self, jac_x, jac_p, tangent):
+        n = len(self.active)
+        aug = np.empty((n + 1, n + 1))
+        aug[:n, :n] = jac_x * self.arc_scale
+        aug[:n, n] = jac_p * self.p_scale
+        aug[n] = tangent
+        return lu_factor(aug)
+
+    def _tangent(self, lu, tangent_prev):
+        rhs = np.zeros(len(tangent_prev))
+        rhs[-1] = 1.0
+        tangent = lu_solve(lu, rhs)
+        tangent /= np.linalg.norm(tangent)
+        if tangent @ tangent_prev < 0.0:
+            tangent = -tangent
+        return tangent
+
+    def _correct(self, w, w_pred, tangent, lu):
+        """Chord Newton iteration on F = 0 and the arclength condition, refactorising if it contracts slowly."""
+        n = len(self.active)
+        step_prev = np.inf
+        for iteration in range(self.max_corrector):
+            residual = np.concatenate(
+                (self.func(w[:n] * self.arc_scale, w[n] * self.p_scale), [tangent @ (w - w_pred)])
+            )
+            delta = lu_solve(lu, residual)
+            w = w - delta
+            step = np.max(np.abs(delta))
+            if not np.all(np.isfinite(w)):
+                break
+            if step < self.tol:
+                return True, iteration, w
+            if step > 0.25 * step_prev:
+                jac_x, jac_p = self.jacobian(w[:n] * self.arc_scale, w[n] * self.p_scale)
+                lu = self._augmented(jac_x, jac_p, tangent)
+            step_prev = step
+        return False, self.max_corrector, w
+
+    def _eigenvalues(self, jac_x):
+        return np.max(np.linalg.eigvals(jac_x).real)
+
+    def run(self, p_end: float, max_points: int = 200):
+        """Tracks the steady state from `p0` towards `p_end`.
+
+        Parameters
+        ----------
+        p_end : float
+            Final parameter value.
+        max_points : int (optional)
+            Maximum number of continuation points. <br>
+            Default is 200.
+
+        Returns
+        -------
+        result : ContinuationResult
+            Points of the solution branch.
+        """
+
+        n = len(self.active)
+        x = self.solve(self.x_full[self.active], self.p0)
+        p = self.p0
+        direction = 1.0 if p_end >= p else -1.0
+
+        jac_x, jac_p = self.jacobian(x, p)
+        tangent = np.zeros(n + 1)
+        tangent[-1] = direction
+        lu = self._augmented(jac_x, jac_p, tangent)
+        tangent = self._tangent(lu, tangent)
+
+        params, states, eig = [p], [self._expand(x)], [self._eigenvalues(jac_x)]
+        folds, changes = [], []
+        ds = self.ds
+        while len(params) < max_points and (p_end - p) * direction > 0.0:
+            w_prev = np.concatenate((x / self.arc_scale, [p / self.p_scale]))
+            w_pred = w_prev + ds * tangent
+            w = w_pred.copy()
+            lu_corr = self._augmented(jac_x, jac_p, tangent)
+            try:
+                converged, iteration, w = self._correct(w, w_pred, tangent, lu_corr)
+            except ZeroDivisionError:
+                # predictor left the physical domain (e.g. vanishing biomass)
+                converged = False
+            if not converged:
+                ds *= 0.5
+                if ds < self.ds_min:
+                    logger.warning('Continuation stopped at parameter %s: step size too small.', p)
+                    break
+                continue
+
+            x_new = w[:n] * self.arc_scale
+            p_new = w[n] * self.p_scale
+            jac_x, jac_p = self.jacobian(x_new, p_new)
+            lu = self._augmented(jac_x, jac_p, tangent)
+            tangent_new = self._tangent(lu, tangent)
+            if tangent_new[-1] * tangent[-1] < 0.0:
+                folds.append(len(params) - 1)
+                logger.info('Fold detected between parameter %s and %s', p, p_new)
+            x, p, tangent = x_new, p_new, tangent_new
+            params.append(p)
+            states.append(self._expand(x))
+            eig.append(self._eigenvalues(jac_x))
+            if (eig[-1] < 0.0) != (eig[-2] < 0.0):
+                changes.append(len(params) - 2)
+                logger.info('Stability change between parameter %s and %s', params[-2], p)
+            # step control by the distance of the corrected point from the predictor (curvature of the branch)
+            distance = np.linalg.norm(w - w_pred) / ds
+            if distance < 0.1:
+                ds = min(ds * 1.5, self.ds_max)
+            elif distance > 0.3:
+                ds *= 0.7
+
+        if (p_end - p) * direction < 0.0 and not folds:
+            # land exactly on the requested end value
+            x = self.solve(x, p_end)
+            params[-1] = p_end
+            states[-1] = self._expand(x)
+            eig[-1] = self._eigenvalues(self.jacobian(x, p_end)[0])
+
+        eig = np.array(eig)
+        return ContinuationResult(
+            np.array(params),
+            np.array(states),
+            eig,
+            eig < 0.0,
+            folds,
+            changes,
+            self.n_rhs,
+            self.n_factorisations,
+        )
+
+
+def _flow_weighted_mean(streams):
+    streams = np.atleast_2d(np.asarray(streams, dtype=float))
+    flows = streams[:, 14]
+    mean = np.average(streams, axis=0, weights=flows) if flows.sum() > 0.0 else streams.mean(axis=0)
+    mean[14] = flows.mean()
+    return mean
+
+
+def _mean_line_inflow(model):
+    """Returns the mean external inflow of the activated sludge line of a plant model."""
+    if not hasattr(model, 'adm1_reactor'):
+        return _flow_weighted_mean(model.y_in)
+    n_steps = int(np.count_nonzero(model.to_as_all[:, 14]))
+    if n_steps == 0:
+        raise ValueError('Simulate at least one step or provide the inflow of the activated sludge line.')
+    # primary clarifier effluent, storage tank and thickener returns are mixed before the first reactor
+    streams = np.concatenate(
+        (model.to_as_all[:n_steps], model.qstorage2AS_all[:n_steps], model.qthick2AS_all[:n_steps])
+    )
+    inflow = _flow_weighted_mean(streams)
+    # the three streams are mixed, the flow rates add up
+    inflow[14] = 3.0 * streams[:, 14].mean()
+    return inflow
+
+
+def activated_sludge_problem(model, parameter: str, inflow=None):
+    """Returns the steady-state problem of the activated sludge line of a plant model.
+
+    Parameters
+    ----------
+    model : BSM1Base | BSM2Base
+        Plant model. Its current reactor and settler states are the initial guess.
+    parameter : str
+        Swept parameter: 'kla1' ... 'kla5' [d⁻¹], 'qw', 'qintr' or 'qr' [m³ ⋅ d⁻¹].
+    inflow : np.ndarray(21) (optional)
+        Constant external inflow to the first reactor. <br>
+        If not provided, the flow-weighted mean of the influent data (BSM1) or of the recorded inflows from
+        the primary clarifier, storage tank and thickener of the simulated steps (BSM2) is used.
+
+    Returns
+    -------
+    func : Callable[[np.ndarray, float], np.ndarray]
+        Right-hand side F(x, p).
+    x0 : np.ndarray
+        Current state of the line.
+    p0 : float
+        Current value of the parameter.
+    """
+
+    x0, params = line_parameters(model)
+    klas = np.array([float(getattr(model, f'reactor{k}').kla) for k in range(1, N_REACTORS + 1)])
+    if inflow is None:
+        inflow = _mean_line_inflow(model)
+    inflow = np.asarray(inflow, dtype=float)
+
+    if parameter.startswith('kla') and parameter[3:].isdigit() and 1 <= int(parameter[3:]) <= N_REACTORS:
+        idx = int(parameter[3:]) - 1
+
+        def func(x, p):
+            klas_p = klas.copy()
+            klas_p[idx] = p
+            return line_rhs(x, klas_p, inflow, params)
+
+        return func, x0, klas[idx]
+    if parameter in LINE_FLOW_PARAMETERS:
+        idx = LINE_FLOW_PARAMETERS[parameter]
+
+        def func(x, p):
+            params_p = params[:idx] + (float(p),) + params[idx + 1 :]
+            return line_rhs(x, klas, inflow, params_p)
+
+        return func, x0, params[idx]
+    err = f'Unknown parameter {parameter} of the activated sludge line.'
+    raise ValueError(err)
+
+
+def digester_problem(model, inflow=None):
+    """Returns the steady-state problem of the anaerobic digester over its operational temperature.
+
+    Parameters
+    ----------
+    model : BSM2Base
+        Plant model with `adm1_reactor`. Its current digester state is the initial guess.
+    inflow : np.ndarray(21) (optional)
+        Constant ASM1 inflow to the digester. <br>
+        Default is the inflow of the last step. The pH used by the ASM2ADM interface is the one of the last step.
+
+    Returns
+    -------
+    func : Callable[[np.ndarray, float], np.ndarray]
+        Right-hand side F(yd, t_op) with t_op in [K].
+    x0 : np.ndarray(42)
+        Current digester state.
+    p0 : float
+        Current operational temperature [K].
+    """
+
+    reactor = model.adm1_reactor
+    # the ASM2ADM interface uses the digester pH of the last step, it is kept fixed
+    y_in1 = np.array(reactor.y_in1, dtype=float)
+    if inflow is not None:
+        y_in1[:21] = np.asarray(inflow, dtype=float)[:21]
+
+    def func(yd, t_op):
+        yi_out1 = asm2adm(y_in1, t_op, reactor.interfacepar)
+        yd_in = np.zeros(42)
+        yd_in[:26] = yi_out1[:26]
+        yd_in[35:] = yi_out1[26:]
+        return adm1equations(0.0, yd.copy(), yd_in, reactor.digesterpar, t_op, reactor.dim)
+
+    return func, np.array(reactor.yd0, dtype=float), float(reactor.t_op)
@@ -0,0 +1,113 @@
+"""Per-step graph of derived quantities (KPIs and plant-wide sums).
+
+Each quantity is declared once with a function and the names of the quantities it depends on.
+Values are computed lazily on first access and cached until the graph is invalidated,
+which the plant models do once per simulation step after all units have been updated.
+Subclasses and controllers read from the same cache instead of calling `PlantPerformance` again.
+"""
+
+from collections.abc import Callable
+
+
+class DerivedQuantities:
+    """Creates a DerivedQuantities object.
+
+    Quantities are evaluated at most once between two calls of `invalidate()`.
+    """
+
+    def __init__(self):
+        self._funcs: dict[str, Callable] = {}
+        self._deps: dict[str, tuple[str, ...]] = {}
+        self._cache: dict = {}
+        self._evaluating: set[str] = set()
+        self.step_idx = -1
+
+    def declare(self, name: str, func: Callable, deps: tuple[str, ...] | list[str] = ()):
+        """Declares a derived quantity.
+
+        Parameters
+        ----------
+        name : str
+            Name of the quantity.
+        func : Callable
+            Function that computes the quantity. It is called with the values of `deps` as positional arguments.
+        deps : tuple[str] (optional)
+            Names of the quantities `func` depends on. <br>
+            Default is ().
+        """
+
+        for dep in deps:
+            if dep == name:
+                err = f'Quantity {name} cannot depend on itself.'
+                raise ValueError(err)
+            if dep not in self._funcs:
+                err = f'Dependency {dep} of quantity {name} has to be declared first.'
+                raise ValueError(err)
+        self._funcs[name] = func
+        self._deps[name] = tuple(deps)
+        # redeclaring a quantity invalidates it and everything computed from it
+        self._drop(name)
+
+    def _drop(self, name: str):
+        self._cache.pop(name, None)
+        for other, deps in self._deps.items():
+            if name in deps and other in self._cache:
+                self._drop(other)
+
+    def invalidate(self, step_idx: int | None = None):
+        """Clears all cached values. Has to be called whenever the plant state has changed.
+
+        Parameters
+        ----------
+        step_idx : int (optional)
+            Index of the time step the following values belong to [-].
+        """
+
+        self._cache.clear()
+        if step_idx is not None:
+            self.step_idx = step_idx
+
+    def get(self, name: str):
+        """Returns the value of a derived quantity, computing it and its dependencies if necessary.
+
+        Parameters
+        ----------
+        name : str
+            Name of the quantity.
+
+        Returns
+        -------
+        value : Any
+            Value of the quantity for the current step.
+        """
+
+        if name in self._cache:
+            return self._cache[name]
+        if name not in self._funcs:
+            err = f'Derived quantity {name} is not declared.'
+            raise KeyError(err)
+        if name in self._evaluating:
+            err = f'Cyclic dependency detected while evaluating {name}.'
+            raise RuntimeError(err)
+        self._evaluating.add(name)
+        try:
+            value = self._funcs[name](*(self.get(dep) for dep in self._deps[name]))
+        finally:
+            self._evaluating.discard(name)
+        self._cache[name] = value
+        return value
+
+    def __getitem__(self, name: str):
+        return self.get(name)
+
+    def __contains__(self, name: str):
+        return name in self._funcs
+
+    def is_cached(self, name: str):
+        """Returns `True` if the quantity has already been computed in the current step."""
+        return name in self._cache
+
+    @property
+    def names(self):
+        """Names of all declared quantities."""
+        return list(self._funcs)
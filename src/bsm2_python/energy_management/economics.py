@@ -2,6 +2,7 @@ import csv
 import os
 
 import numpy as np
+from numba import jit
 
 from bsm2_python.energy_management.boiler import Boiler
 from bsm2_python.energy_management.chp import CHP
@@ -30,6 +31,73 @@ planning_permit_certificate = 0.1  # Planung, Genehmigung, Gutachten 10% CAPEX,
 reserve = 0.05  # 5% CAPEX, source: eta excel
 
 
+@jit(nopython=True, cache=True)
+def nearest_indices(reference, times):
+    """Returns for every entry of `times` the index of the closest value in the sorted array `reference`.
+
+    Equivalent to `np.argmin(np.abs(reference - t))` for each `t`, ties resolve to the lower index.
+
+    Parameters
+    ----------
+    reference : np.ndarray
+        Sorted reference times.
+    times : np.ndarray
+        Times to look up.
+
+    Returns
+    -------
+    np.ndarray
+        Indices into `reference`.
+    """
+
+    idx = np.searchsorted(reference, times)
+    out = np.empty(len(times), dtype=np.int64)
+    n_ref = len(reference)
+    for k in range(len(times)):
+        right = min(idx[k], n_ref - 1)
+        left = max(idx[k] - 1, 0)
+        if abs(reference[left] - times[k]) <= abs(reference[right] - times[k]):
+            out[k] = left
+        else:
+            out[k] = right
+    return out
+
+
+@jit(nopython=True, cache=True)
+def commodity_cash_flows(net_demand, step_prices, time_diffs, income, expenditures):
+    """Adds income and expenditures of a traded commodity for all price scenarios and time steps.
+
+    Same sign rules as `Economics.get_income` and `Economics.get_expenditures`:
+    selling at positive or buying at negative prices yields income, the other two cases are expenditures.
+
+    Parameters
+    ----------
+    net_demand : np.ndarray(n)
+        Bought minus sold amount per time step.
+    step_prices : np.ndarray(m, n)
+        Price of each scenario at each time step.
+    time_diffs : np.ndarray(n)
+        Length of each time step.
+    income : np.ndarray(m, n)
+        Income per scenario and step, updated in place [€].
+    expenditures : np.ndarray(m, n)
+        Expenditures per scenario and step, updated in place [€].
+    """
+
+    for s in range(step_prices.shape[0]):
+        for k in range(len(net_demand)):
+            net = net_demand[k]
+            price = step_prices[s, k]
+            if net < 0 and price > 0:
+                income[s, k] += -net * price * time_diffs[k]
+            elif net > 0 and price < 0:
+                income[s, k] += net * -price * time_diffs[k]
+            if net > 0 and price > 0:
+                expenditures[s, k] += net * price * time_diffs[k]
+            elif net < 0 and price < 0:
+                expenditures[s, k] += net * price * time_diffs[k]
+
+
 class Economics:
     """A class that represents the economic aspects of the energy management.
 
@@ -332,3 +400,102 @@ class Economics:
             expenditure_electricity = net_electricity_wwtp * self.electricity_prices[el_price_idx] * time_diff
         self.cum_cash_flow -= expenditure_capex + expenditure_opex + expenditure_electricity
         return expenditure_capex + expenditure_opex + expenditure_electricity
+
+    def get_fixed_cost_rate(self):
+        """Returns capex and opex per unit of time, both grow linearly with the time difference.
+
+        Returns
+        -------
+        float
+            Sum of capex and opex for a time difference of 1 [€].
+        """
+
+        return self.get_total_capex(1.0) + self.get_total_opex(1.0)
+
+    def evaluate_batch(
+        self,
+        net_electricity: np.ndarray,
+        simtime: np.ndarray,
+        electricity_prices: np.ndarray | None = None,
+        price_times: np.ndarray | None = None,
+        *,
+        net_heat: np.ndarray | None = None,
+        heat_prices: float | np.ndarray = 0.0,
+        net_gas: np.ndarray | None = None,
+        gas_prices: float | np.ndarray = 0.0,
+    ):
+        """Evaluates the cash flows of a finished simulation for any number of price scenarios at once.
+
+        Gives the same result as calling `get_income` and `get_expenditures` for every step,
+        but the price lookup and the capex/opex terms are computed once for all steps.
+        Does not change `cum_cash_flow`.
+
+        Parameters
+        ----------
+        net_electricity : np.ndarray(n)
+            Recorded electricity bought from the grid minus the electricity sold to the grid [kW].
+        simtime : np.ndarray(n)
+            Simulation times of the recorded steps [d].
+        electricity_prices : np.ndarray(p) | np.ndarray(m, p) (optional)
+            One price series or one row per price scenario [€ ⋅ MWh⁻¹]. <br>
+            If not provided, the prices loaded at construction are used.
+        price_times : np.ndarray(p) (optional)
+            Sorted times of the price series [d]. <br>
+            If not provided, the price times loaded at construction are used.
+        net_heat : np.ndarray(n) (optional)
+            Recorded heat bought minus heat sold [kW]. Only evaluated if given.
+        heat_prices : float | np.ndarray(n) | np.ndarray(m, n) (optional)
+            Heat price per step and scenario. <br>
+            Default is 0.
+        net_gas : np.ndarray(n) (optional)
+            Recorded gas bought minus gas sold. Only evaluated if given.
+        gas_prices : float | np.ndarray(n) | np.ndarray(m, n) (optional)
+            Gas price per step and scenario. <br>
+            Default is 0.
+
+        Returns
+        -------
+        income : np.ndarray(m, n)
+            Income per scenario and step [€].
+        expenditures : np.ndarray(m, n)
+            Expenditures per scenario and step, including capex and opex [€].
+        cum_cash_flow : np.ndarray(m, n)
+            Cumulative balance of income and expenditures [€].
+        """
+
+        net_electricity = np.asarray(net_electricity, dtype=np.float64).flatten()
+        simtime = np.asarray(simtime, dtype=np.float64).flatten()
+        if len(net_electricity) != len(simtime):
+            raise ValueError('net_electricity and simtime need to have the same length.')
+        if electricity_prices is None:
+            electricity_prices = self.electricity_prices
+        if price_times is None:
+            price_times = self.price_times
+        prices = np.atleast_2d(np.asarray(electricity_prices, dtype=np.float64))
+        price_times = np.asarray(price_times, dtype=np.float64)
+        if prices.shape[1] != len(price_times):
+            raise ValueError('Every price scenario needs one value per entry of price_times.')
+
+        time_diffs = np.diff(simtime, prepend=0.0)
+        n_scen, n_steps = prices.shape[0], len(simtime)
+
+        step_prices = np.ascontiguousarray(prices[:, nearest_indices(price_times, simtime)])
+        income = np.zeros((n_scen, n_steps))
+        expenditures = np.zeros((n_scen, n_steps))
+        # capex and opex are identical for all scenarios and linear in the time difference
+        expenditures += self.get_fixed_cost_rate() * time_diffs
+        commodity_cash_flows(net_electricity, step_prices, time_diffs, income, expenditures)
+
+        for net, commodity_prices in ((net_heat, heat_prices), (net_gas, gas_prices)):
+            if net is None:
+                continue
+            net = np.asarray(net, dtype=np.float64).flatten()
+            if len(net) != n_steps:
+                raise ValueError('Recorded heat and gas series need the same length as simtime.')
+            commodity_prices = np.ascontiguousarray(
+                np.broadcast_to(np.asarray(commodity_prices, dtype=np.float64), (n_scen, n_steps))
+            )
+            commodity_cash_flows(net, commodity_prices, time_diffs, income, expenditures)
+
+        cum_cash_flow = np.cumsum(income - expenditures, axis=1)
+        return income, expenditures, cum_cash_flow
@@ -1,6 +1,7 @@
 from __future__ import annotations
 from typing import Dict, Any, Callable, List
 import numpy as np
+from numba import jit
 import sys
 import os
 import importlib.util
@@ -119,6 +120,68 @@ def make_combiner(node_id: str, params: Dict[str, Any]):
             return {"out_combined": result}
     return CombinerAdapter()
 
+_SPLIT_RATIO = 0
+_THRESHOLD = 1
+
+
+@jit(nopython=True, cache=True)
+def _split_ratio_flows(total_flow, ratios, blank, remainder_target, flows):
+    """N-way split of `total_flow` by precompiled ratios.
+
+    Blank outputs share the remainder equally; without blanks the remainder goes to
+    `remainder_target` (last explicit output).
+    """
+    n_blank = 0
+    assigned = 0.0
+    for k in range(len(ratios)):
+        if blank[k]:
+            n_blank += 1
+        else:
+            flows[k] = ratios[k] * total_flow
+            assigned += flows[k]
+    remaining = max(total_flow - assigned, 0.0)
+    if n_blank > 0:
+        share = remaining / n_blank if remaining > 0 else 0.0
+        for k in range(len(ratios)):
+            if blank[k]:
+                flows[k] = share
+    elif remaining > 0 and remainder_target >= 0:
+        flows[remainder_target] += remaining
+
+
+@jit(nopython=True, cache=True)
+def _threshold_flows(total_flow, thresholds, blank, flows):
+    """N-way split of `total_flow` by precompiled thresholds, the remainder goes to the first blank output."""
+    remaining = total_flow
+    for k in range(len(thresholds)):
+        if blank[k]:
+            continue
+        take = min(thresholds[k], remaining)
+        flows[k] = take
+        remaining = max(remaining - take, 0.0)
+    if remaining > 0:
+        for k in range(len(thresholds)):
+            if blank[k]:
+                flows[k] = remaining
+                break
+
+
+@jit(nopython=True, cache=True)
+def _split_streams(x, mode_code, ratios, ratio_blank, remainder_target, thresholds, threshold_blank, streams):
+    """Writes one row per output into `streams`: the inlet composition with its split flow rate."""
+    count = streams.shape[0]
+    flows = np.zeros(count)
+    total_flow = max(x[14], 0.0) if len(x) > 14 else 0.0
+    if mode_code == _THRESHOLD:
+        _threshold_flows(total_flow, thresholds, threshold_blank, flows)
+    else:
+        _split_ratio_flows(total_flow, ratios, ratio_blank, remainder_target, flows)
+    for k in range(count):
+        streams[k, :] = x
+        if len(x) > 14:
+            streams[k, 14] = flows[k]
+
+
 @register("splitter")
 def make_splitter(node_id: str, params: Dict[str, Any]):
     output_handles: List[str] = list(params.get("__output_handles__", []))
@@ -158,6 +221,10 @@ def make_splitter(node_id: str, params: Dict[str, Any]):
             self.split_ratio_spec = self._to_list(split_ratio_spec)
             self.threshold_spec = self._to_list(threshold_spec)
             self.threshold_mapping = self._map_thresholds()
+            # rules are compiled once, the per-step work happens in the split kernels
+            self._mode_code = _THRESHOLD if self.mode == "threshold" else _SPLIT_RATIO
+            self._ratios, self._ratio_blank, self._remainder_target = self._compile_split_ratio()
+            self._thresholds, self._threshold_blank = self._compile_threshold()
 
         @staticmethod
         def _is_blank(value: Any) -> bool:
@@ -209,108 +276,78 @@ def make_splitter(node_id: str, params: Dict[str, Any]):
 
             return mapped
 
-        def _compute_split_ratio_flows(self, total_flow: float) -> List[float]:
+        def _compile_split_ratio(self):
+            """Compiles the split ratio spec into (ratios, blank mask, remainder target)."""
             count = len(self.output_handles)
-            if count == 0:
-                return []
-
             specs = list(self.split_ratio_spec)
             if len(specs) < count:
                 specs.extend(["" for _ in range(count - len(specs))])
             elif len(specs) > count:
                 specs = specs[:count]
 
-            flows = [0.0] * count
+            ratios = np.zeros(count, dtype=np.float64)
+            blank = np.zeros(count, dtype=np.bool_)
             explicit: List[tuple[int, float]] = []
-            blank_indices: List[int] = []
-
             for idx, spec in enumerate(specs):
                 numeric = self._coerce_float(spec)
                 if numeric is None:
-                    blank_indices.append(idx)
+                    blank[idx] = True
                 else:
                     explicit.append((idx, numeric))
 
-            if not explicit and blank_indices:
-                share = total_flow / len(blank_indices) if blank_indices else 0.0
-                for idx in blank_indices:
-                    flows[idx] = share
-                return flows
-
             ratio_sum = sum(value for _, value in explicit)
             scale = 1.0
             if ratio_sum > 1.0 and ratio_sum > 0:
                 scale = 1.0 / ratio_sum
-
-            assigned = 0.0
             for idx, value in explicit:
-                ratio = max(value * scale, 0.0)
-                flows[idx] = ratio * total_flow
-                assigned += flows[idx]
+                ratios[idx] = max(value * scale, 0.0)
 
-            remaining = max(total_flow - assigned, 0.0)
-            if blank_indices:
-                share = remaining / len(blank_indices) if remaining > 0 else 0.0
-                for idx in blank_indices:
-                    flows[idx] = share
-            elif remaining > 0 and explicit:
-                last_idx = explicit[-1][0]
-                flows[last_idx] += remaining
+            # without blank outputs the remainder goes to the last explicit output
+            remainder_target = explicit[-1][0] if explicit and not blank.any() else -1
+            return ratios, blank, remainder_target
 
-            return flows
-
-        def _compute_threshold_flows(self, total_flow: float) -> List[float]:
+        def _compile_threshold(self):
+            """Compiles the mapped thresholds into (threshold vector, blank mask)."""
             count = len(self.output_handles)
-            if count == 0:
-                return []
-
             mapped = list(self.threshold_mapping)
             if len(mapped) < count:
                 mapped.extend(["" for _ in range(count - len(mapped))])
             elif len(mapped) > count:
                 mapped = mapped[:count]
 
-            flows = [0.0] * count
-            remaining = max(total_flow, 0.0)
-            blank_indices: List[int] = []
-
+            thresholds = np.zeros(count, dtype=np.float64)
+            blank = np.zeros(count, dtype=np.bool_)
             for idx, spec in enumerate(mapped):
                 numeric = self._coerce_float(spec)
                 if numeric is None:
-                    blank_indices.append(idx)
-                    continue
-                take = min(numeric, remaining)
-                flows[idx] = take
-                remaining = max(remaining - take, 0.0)
+                    blank[idx] = True
+                else:
+                    thresholds[idx] = numeric
+            return thresholds, blank
 
-            for idx in blank_indices:
-                if remaining <= 0:
-                    break
-                flows[idx] = remaining
-                remaining = 0.0
+        def _compute_split_ratio_flows(self, total_flow: float) -> List[float]:
+            flows = np.zeros(len(self.output_handles))
+            _split_ratio_flows(total_flow, self._ratios, self._ratio_blank, self._remainder_target, flows)
+            return flows.tolist()
 
-            return flows
+        def _compute_threshold_flows(self, total_flow: float) -> List[float]:
+            flows = np.zeros(len(self.output_handles))
+            _threshold_flows(max(total_flow, 0.0), self._thresholds, self._threshold_blank, flows)
+            return flows.tolist()
 
         def step(self, dt, current_step, inputs):
             x = inputs.get("in_main")
             if x is None:
                 return {}
 
-            total_flow = float(x[14]) if len(x) > 14 else 0.0
-            total_flow = max(total_flow, 0.0)
-
-            if self.mode == "threshold":
-                flows = self._compute_threshold_flows(total_flow)
-            else:
-                flows = self._compute_split_ratio_flows(total_flow)
-
-            outputs: Dict[str, np.ndarray] = {}
-            for handle, flow in zip(self.output_handles, flows):
-                stream = x.copy()
-                stream[14] = flow
-                outputs[handle] = stream
+            count = len(self.output_handles)
+            x = np.asarray(x, dtype=np.float64)
+            streams = np.empty((count, len(x)))
+            if count:
+                _split_streams(x, self._mode_code, self._ratios, self._ratio_blank, self._remainder_target,
+                               self._thresholds, self._threshold_blank, streams)
 
-            return outputs
+            return {handle: streams[k] for k, handle in enumerate(self.output_handles)}
 
     return SplitterAdapter()
 
@@ -2,6 +2,12 @@ from __future__ import annotations
 from collections import defaultdict, deque
 from typing import Dict, List, Set, Tuple, Any
 
+import numpy as np
+from numba import jit
+
+# layouts with more nodes are scheduled with the iterative CSR kernels (no recursion limit)
+NATIVE_MIN_NODES = 200
+
 def build_graph(nodes: List[Dict[str, Any]], edges: List[Dict[str, Any]]):
     node_ids: Set[str] = {n["id"] for n in nodes}
     adj: Dict[str, List[str]] = defaultdict(list)
@@ -129,8 +135,181 @@ def internal_order(component: Set[str], adj: Dict[str, List[str]], tears: Set[Tu
         raise RuntimeError("Internal topo order incomplete; more tears needed")
     return order
 
+def build_csr(nodes: List[Dict[str, Any]], edges: List[Dict[str, Any]]):
+    """CSR adjacency of the flowsheet: successors of node i are indices[indptr[i]:indptr[i + 1]],
+    edge_ids holds the id of every entry. Edges to unknown nodes are skipped like in `build_graph`."""
+    node_list = [n["id"] for n in nodes]
+    pos = {nid: i for i, nid in enumerate(node_list)}
+    pairs = [(pos[e["source_node_id"]], pos[e["target_node_id"]], e["id"]) for e in edges
+             if e["source_node_id"] in pos and e["target_node_id"] in pos]
+    src = np.fromiter((p[0] for p in pairs), dtype=np.int64, count=len(pairs))
+    dst = np.fromiter((p[1] for p in pairs), dtype=np.int64, count=len(pairs))
+    perm = np.argsort(src, kind="stable")
+    indptr = np.zeros(len(node_list) + 1, dtype=np.int64)
+    np.cumsum(np.bincount(src, minlength=len(node_list)), out=indptr[1:])
+    edge_ids = [pairs[k][2] for k in perm]
+    return node_list, indptr, dst[perm], edge_ids
+
+@jit(nopython=True, cache=True)
+def _tarjan_csr(indptr, indices):
+    # Tarjan with an explicit call stack; components are numbered in reverse topological order
+    n = len(indptr) - 1
+    index = np.full(n, -1, dtype=np.int64); low = np.zeros(n, dtype=np.int64)
+    onstack = np.zeros(n, dtype=np.bool_); comp = np.full(n, -1, dtype=np.int64)
+    stack = np.empty(n, dtype=np.int64); call_v = np.empty(n, dtype=np.int64); call_e = np.empty(n, dtype=np.int64)
+    sp = 0; counter = 0; n_comps = 0
+    for root in range(n):
+        if index[root] >= 0: continue
+        index[root] = counter; low[root] = counter; counter += 1
+        stack[sp] = root; sp += 1; onstack[root] = True
+        call_v[0] = root; call_e[0] = indptr[root]; cp = 1
+        while cp > 0:
+            v = call_v[cp - 1]; e = call_e[cp - 1]
+            if e < indptr[v + 1]:
+                call_e[cp - 1] = e + 1
+                w = indices[e]
+                if index[w] < 0:
+                    index[w] = counter; low[w] = counter; counter += 1
+                    stack[sp] = w; sp += 1; onstack[w] = True
+                    call_v[cp] = w; call_e[cp] = indptr[w]; cp += 1
+                elif onstack[w]:
+                    low[v] = min(low[v], index[w])
+                continue
+            cp -= 1
+            if low[v] == index[v]:
+                while True:
+                    sp -= 1; w = stack[sp]; onstack[w] = False; comp[w] = n_comps
+                    if w == v: break
+                n_comps += 1
+            if cp > 0:
+                u = call_v[cp - 1]; low[u] = min(low[u], low[v])
+    return comp, n_comps
+
+@jit(nopython=True, cache=True)
+def _group_csr(comp, n_comps):
+    # members of component c are members[ptr[c]:ptr[c + 1]] (ascending node index)
+    ptr = np.zeros(n_comps + 1, dtype=np.int64)
+    for v in range(len(comp)): ptr[comp[v] + 1] += 1
+    for c in range(n_comps): ptr[c + 1] += ptr[c]
+    fill = ptr[:-1].copy(); members = np.empty(len(comp), dtype=np.int64)
+    for v in range(len(comp)):
+        members[fill[comp[v]]] = v; fill[comp[v]] += 1
+    return ptr, members
+
+@jit(nopython=True, cache=True)
+def _kahn_condensation(indptr, indices, comp, n_comps, ptr, members):
+    indeg = np.zeros(n_comps, dtype=np.int64)
+    for u in range(len(comp)):
+        for e in range(indptr[u], indptr[u + 1]):
+            if comp[indices[e]] != comp[u]: indeg[comp[indices[e]]] += 1
+    order = np.empty(n_comps, dtype=np.int64); tail = 0
+    for c in range(n_comps):
+        if indeg[c] == 0: order[tail] = c; tail += 1
+    head = 0
+    while head < tail:
+        c = order[head]; head += 1
+        for k in range(ptr[c], ptr[c + 1]):
+            u = members[k]
+            for e in range(indptr[u], indptr[u + 1]):
+                cv = comp[indices[e]]
+                if cv != c:
+                    indeg[cv] -= 1
+                    if indeg[cv] == 0: order[tail] = cv; tail += 1
+    return order, tail
+
+@jit(nopython=True, cache=True)
+def _tears_csr(indptr, indices, comp):
+    # iterative DFS within the components, edges back to a gray node are torn
+    n = len(indptr) - 1
+    colour = np.zeros(n, dtype=np.int8); tear = np.zeros(len(indices), dtype=np.bool_)
+    call_v = np.empty(n, dtype=np.int64); call_e = np.empty(n, dtype=np.int64)
+    for root in range(n):
+        if colour[root] != 0: continue
+        colour[root] = 1; call_v[0] = root; call_e[0] = indptr[root]; cp = 1
+        while cp > 0:
+            v = call_v[cp - 1]; e = call_e[cp - 1]
+            if e < indptr[v + 1]:
+                call_e[cp - 1] = e + 1
+                w = indices[e]
+                if comp[w] != comp[v]: continue
+                if colour[w] == 0:
+                    colour[w] = 1; call_v[cp] = w; call_e[cp] = indptr[w]; cp += 1
+                elif colour[w] == 1:
+                    tear[e] = True
+                continue
+            colour[v] = 2; cp -= 1
+    return tear
+
+@jit(nopython=True, cache=True)
+def _internal_order_csr(indptr, indices, comp, tear, ptr, members):
+    # Kahn within every component on the edges that are not torn, written to the slots of `members`
+    indeg = np.zeros(len(comp), dtype=np.int64)
+    for u in range(len(comp)):
+        for e in range(indptr[u], indptr[u + 1]):
+            if not tear[e] and comp[indices[e]] == comp[u]: indeg[indices[e]] += 1
+    order = np.empty(len(comp), dtype=np.int64); complete = True
+    for c in range(len(ptr) - 1):
+        head = ptr[c]; tail = ptr[c]
+        for k in range(ptr[c], ptr[c + 1]):
+            if indeg[members[k]] == 0: order[tail] = members[k]; tail += 1
+        while head < tail:
+            u = order[head]; head += 1
+            for e in range(indptr[u], indptr[u + 1]):
+                w = indices[e]
+                if not tear[e] and comp[w] == c:
+                    indeg[w] -= 1
+                    if indeg[w] == 0: order[tail] = w; tail += 1
+        if tail != ptr[c + 1]: complete = False
+    return order, complete
+
+def schedule_csr(data: Dict[str, Any]) -> Dict[str, Any]:
+    """Same plan as `schedule`, computed with iterative kernels on CSR adjacency arrays.
+    Component ids and the order within a stage may differ, both plans are valid."""
+    node_list, indptr, indices, edge_ids = build_csr(data["nodes"], data["edges"])
+    comp, n_comps = _tarjan_csr(indptr, indices)
+    ptr, members = _group_csr(comp, n_comps)
+    comp_order, n_ordered = _kahn_condensation(indptr, indices, comp, n_comps, ptr, members)
+    if n_ordered != n_comps:
+        raise RuntimeError("Condensation graph unexpectedly cyclic")
+    tear = _tears_csr(indptr, indices, comp)
+    order, complete = _internal_order_csr(indptr, indices, comp, tear, ptr, members)
+    if not complete:
+        raise RuntimeError("Internal topo order incomplete; more tears needed")
+
+    src = np.repeat(np.arange(len(node_list)), np.diff(indptr))
+    self_loop = np.zeros(len(node_list), dtype=bool)
+    self_loop[src[src == indices]] = True
+    tears_by_comp: Dict[int, List[str]] = defaultdict(list)
+    seen: Set[Tuple[int, int]] = set()
+    for e in np.flatnonzero(tear):
+        pair = (int(src[e]), int(indices[e]))
+        if pair not in seen:  # parallel edges are torn together, one id per pair like `schedule`
+            seen.add(pair); tears_by_comp[int(comp[src[e]])].append(edge_ids[e])
+
+    stages = []
+    for cid in comp_order.tolist():
+        idx = members[ptr[cid]:ptr[cid + 1]]
+        if len(idx) == 1 and not self_loop[idx[0]]:
+            n = node_list[idx[0]]
+            stages.append({"type": "acyclic", "nodes": [n], "order": [n], "component_id": cid})
+            continue
+        stages.append({
+            "type": "loop",
+            "nodes": sorted(node_list[i] for i in idx),
+            "internal_order": [node_list[i] for i in order[ptr[cid]:ptr[cid + 1]]],
+            "tear_edges": tears_by_comp[cid],
+            "component_id": cid
+        })
+    return {
+        "stages": stages,
+        "node_to_comp": dict(zip(node_list, comp.tolist())),
+        "comp_order": comp_order.tolist(),
+    }
+
 def schedule(data: Dict[str, Any]) -> Dict[str, Any]:
     nodes = data["nodes"]; edges = data["edges"]
+    if len(nodes) > NATIVE_MIN_NODES:
+        return schedule_csr(data)
     node_ids, adj, self_loops, edge_ids_by_pair, in_edges, out_edges = build_graph(nodes, edges)
     sccs = tarjan_scc(node_ids, adj)
     H, node2comp = build_condensation(adj, sccs)
@@ -5,6 +5,7 @@ import math
 import matplotlib.pyplot as plt
 import numpy as np
 
+from bsm2_python.arrow_ipc import ArrowWriter
 from bsm2_python.log import logger
 
 
@@ -15,6 +16,7 @@ class Evaluation:
     ----------
     filepath : str (optional)
         Path to the file where the data will be exported.
+        Files ending with '.arrow' are written as Arrow IPC files, see `export_arrow`.
         If not provided, the data will not be exported.
     """
 
@@ -173,6 +175,9 @@ class Evaluation:
         if not self.data_objects:
             logger.warning('No data to export')
             return
+        if self.filepath.endswith('.arrow'):
+            self.export_arrow(self.filepath)
+            return
         with open(self.filepath, 'w', encoding='utf-8') as f:
             header = ''
             for i, data_object in enumerate(self.data_objects):
@@ -212,6 +217,34 @@ class Evaluation:
                 f.write(line + '\n')
         logger.info('Data exported to ' + self.filepath)
 
+    def export_arrow(self, filepath: str):
+        """Exports the data stored in the data objects to an Arrow IPC file.
+
+        Every exported data object gives the columns '<name>.timestamp' and '<name>.<column name>' with the
+        units as field metadata. Columns of data objects with fewer timestamps are padded with nulls.
+
+        Parameters
+        ----------
+        filepath : str
+            Path to the Arrow file.
+        """
+
+        data_objects = [data_object for data_object in self.data_objects if data_object.export]
+        num_rows = max((data_object.num_timestamps for data_object in data_objects), default=0)
+        fields, columns = [], []
+        for data_object in data_objects:
+            mask = np.arange(num_rows) >= data_object.num_timestamps
+            fields.append((data_object.name + '.timestamp', float, {'unit': 'd'}))
+            timestamps = np.resize(np.asarray(data_object.timestamps, dtype=float), num_rows)
+            columns.append(np.ma.MaskedArray(timestamps, mask))
+            for key, value in data_object.data_dict.items():
+                fields.append((data_object.name + '.' + key, float, {'unit': value['unit']}))
+                values = np.resize(np.asarray(value['values'], dtype=float), num_rows)
+                columns.append(np.ma.MaskedArray(values, mask))
+        with ArrowWriter(filepath, fields) as writer:
+            writer.write_batch(columns)
+        logger.info('Data exported to ' + filepath)
+
     def plot_data(self):
         """Plots the data stored in the vars_dicts list."""
 
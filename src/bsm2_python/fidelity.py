@@ -0,0 +1,221 @@
+"""Adaptive model fidelity for simulations with real-time deadlines.
+
+A `FidelityController` steps a plant and measures the wall time per step. If the (smoothed) latency
+exceeds the deadline, the plant is switched to the next coarser `FidelityLevel`, if the load allows,
+it is switched back. Levels combine
+
+- a reduced number of settler layers (`Settler.set_layers`, state remapped conservatively),
+- coarse stepping of the digester (`ADM1Reactor.stride`),
+- looser integrator tolerances of selected units (see `tolerance_tuning`).
+
+Every level carries an estimated relative error of the recorded outputs compared to full fidelity,
+set by hand or measured with `calibrate`. Levels whose error exceeds the accuracy budget are skipped,
+the controller switches to the nearest coarser (or finer) level within the budget.
+"""
+
+import dataclasses
+import time
+from dataclasses import dataclass
+
+import numpy as np
+
+from bsm2_python.log import logger
+from bsm2_python.scenario_tree import ModelSnapshot
+from bsm2_python.tolerance_tuning import apply_tolerances, find_units
+
+
+@dataclass
+class FidelityLevel:
+    """Model variant of a fidelity level.
+
+    name : str
+        Name of the level.
+    settler_layers : int | None
+        Number of settler layers, `None` keeps the layers of the constructed settler.
+    digester_stride : int
+        Time steps per integration of the digester.
+    tolerances : dict{str: tuple(float, float)} | None
+        (rtol, atol) per unit, the other units keep their tolerances.
+    error : float
+        Estimated relative error of the recorded outputs, see `FidelityController.calibrate`.
+    """
+
+    name: str
+    settler_layers: int | None = None
+    digester_stride: int = 1
+    tolerances: dict | None = None
+    error: float = 0.0
+
+
+DEFAULT_LEVELS = (
+    FidelityLevel('full'),
+    FidelityLevel('reduced settler', settler_layers=5),
+    FidelityLevel('coarse', settler_layers=5, digester_stride=4),
+)
+"""Fidelity levels from full to coarsest."""
+
+
+class FidelityController:
+    """Creates a FidelityController object.
+
+    Parameters
+    ----------
+    model : BSMBase
+        Plant model, e.g. `BSM2OL`.
+    deadline : float
+        Wall time available per time step [s].
+    levels : list[FidelityLevel] (optional)
+        Fidelity levels from full to coarsest. <br>
+        Default is `DEFAULT_LEVELS`.
+    accuracy_budget : float (optional)
+        Largest acceptable estimated error of a level. <br>
+        Default is no limit.
+    smoothing : float (optional)
+        Weight of the newest latency in the exponential moving average. <br>
+        Default is 0.3.
+    recover_at : float (optional)
+        Switch back to the next finer level if its expected latency is below this fraction of the deadline.
+        <br> Default is 0.7.
+    patience : int (optional)
+        Minimum number of steps between two switches. <br>
+        Default is 5.
+    """
+
+    def __init__(
+        self,
+        model,
+        deadline: float,
+        levels=DEFAULT_LEVELS,
+        accuracy_budget: float = np.inf,
+        smoothing: float = 0.3,
+        recover_at: float = 0.7,
+        patience: int = 5,
+    ):
+        self.model = model
+        self.deadline = deadline
+        # own copies, `calibrate` sets the errors of the levels of this controller only
+        self.levels = [dataclasses.replace(level) for level in levels]
+        self.accuracy_budget = accuracy_budget
+        self.smoothing = smoothing
+        self.recover_at = recover_at
+        self.patience = patience
+        settler = getattr(model, 'settler', None)
+        self._full_layers = int(settler.full_layer[1]) if settler is not None else None
+        self._tolerances = {name: (unit.rtol, unit.atol) for name, unit in find_units(model).items()}
+        self.level = 0
+        self.latency = None  # smoothed wall time per step [s]
+        self.level_latency = {}  # last smoothed latency per level [s]
+        self.history = [(model.next_step, self.levels[0].name)]
+        self._since_switch = 0
+        self.apply(0)
+
+    def apply(self, level: int):
+        """Switches the plant to fidelity level `level` (index into `levels`)."""
+        spec = self.levels[level]
+        settler = getattr(self.model, 'settler', None)
+        if settler is not None:
+            settler.set_layers(spec.settler_layers or self._full_layers)
+        digester = getattr(self.model, 'adm1_reactor', None)
+        if digester is not None:
+            digester.stride = spec.digester_stride
+        apply_tolerances(self.model, {**self._tolerances, **(spec.tolerances or {})})
+        self.level = level
+
+    def _next_allowed(self, level, direction):
+        """Returns the nearest level after `level` towards coarser (+1) or finer (-1) levels whose error is
+        within the accuracy budget, `None` if there is none."""
+        level += direction
+        while 0 <= level < len(self.levels):
+            if self.levels[level].error <= self.accuracy_budget:
+                return level
+            level += direction
+        return None
+
+    def _switch(self, level):
+        if self.latency is not None:
+            self.level_latency[self.level] = self.latency
+        logger.info(
+            'Fidelity: %s -> %s at step %s (latency %.3g s, deadline %.3g s)',
+            self.levels[self.level].name,
+            self.levels[level].name,
+            self.model.next_step,
+            self.latency,
+            self.deadline,
+        )
+        self.apply(level)
+        self.history.append((self.model.next_step, self.levels[level].name))
+        self._since_switch = 0
+
+    def step(self, i: int, **kwargs):
+        """Simulates time step `i` of the plant and adapts the fidelity to the measured latency."""
+        start = time.perf_counter()
+        self.model.step(i, **kwargs)
+        self.model.next_step = i + 1
+        elapsed = time.perf_counter() - start
+        if self.latency is None:
+            self.latency = elapsed
+        else:
+            self.latency = (1 - self.smoothing) * self.latency + self.smoothing * elapsed
+        self._since_switch += 1
+        if self._since_switch < self.patience:
+            return
+        if self.latency > self.deadline:
+            coarser = self._next_allowed(self.level, 1)
+            if coarser is not None:
+                self._switch(coarser)
+            return
+        finer = self._next_allowed(self.level, -1)
+        if finer is not None:
+            # expected latency of the finer level, scaled with the current load
+            finer_latency = self.level_latency.get(finer)
+            current = self.level_latency.get(self.level)
+            expected = self.latency * (finer_latency / current if finer_latency and current else 2.0)
+            if expected < self.recover_at * self.deadline:
+                self._switch(finer)
+
+    def advance(self, n_steps: int, **kwargs):
+        """Simulates the next `n_steps` time steps of the plant, see `step`."""
+        start = self.model.next_step
+        for i in range(start, min(start + n_steps, len(self.model.simtime))):
+            self.step(i, **kwargs)
+
+    def calibrate(self, n_steps: int, record=None, **kwargs):
+        """Estimates the error of every level by simulating the next `n_steps` time steps with each level.
+
+        The plant is reset to its current state afterwards. The error of a level is the largest deviation of
+        the recorded quantities from full fidelity, relative to their largest magnitude.
+
+        Parameters
+        ----------
+        n_steps : int
+            Number of time steps of the comparison.
+        record : list[str] (optional)
+            Names of the compared quantities, e.g. ['y_eff']. <br>
+            If not provided, all arrays recorded per time step are compared.
+        **kwargs
+            Keyword arguments of `step`.
+
+        Returns
+        -------
+        errors : list[float]
+            Estimated error per level (also stored in the levels).
+        """
+
+        current = self.level
+        snapshot = ModelSnapshot(self.model)
+        reference = None
+        for level, spec in enumerate(self.levels):
+            snapshot.restore(self.model)
+            self.apply(level)
+            recorded = self.model.advance(n_steps, callback=lambda *_: kwargs, sample_time=np.inf, record=record)
+            recorded = {name: np.array(values) for name, values in recorded.items() if name != 'simtime'}
+            if reference is None:
+                reference = recorded
+            spec.error = max(
+                float(np.max(np.abs(recorded[name] - ref)) / max(np.max(np.abs(ref)), 1e-12))
+                for name, ref in reference.items()
+            )
+            logger.info('Fidelity level %s: estimated error %.3g', spec.name, spec.error)
+        snapshot.restore(self.model)
+        self.apply(current)
+        return [spec.error for spec in self.levels]
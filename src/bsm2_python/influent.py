@@ -0,0 +1,361 @@
+"""Fast ingest of influent files.
+
+Influent CSV files (time + 21 components, see `BSMBase`) are parsed by a compiled parser in byte chunks
+that are processed by several threads without the GIL:
+
+1. the file is memory-mapped and split at line ends into chunks,
+2. the data rows of every chunk are counted, giving the first output row of every chunk,
+3. every chunk is parsed and validated directly into the output array.
+
+The output can be a binary influent store, a `.npy` file that is memory-mapped by `load_influent` and
+`BSMBase` instead of parsing the CSV file again.
+"""
+
+import os
+from concurrent.futures import ThreadPoolExecutor
+
+import numpy as np
+from numba import jit
+
+COMPONENTS = (
+    'SI',
+    'SS',
+    'XI',
+    'XS',
+    'XBH',
+    'XBA',
+    'XP',
+    'SO',
+    'SNO',
+    'SNH',
+    'SND',
+    'XND',
+    'SALK',
+    'TSS',
+    'Q',
+    'TEMP',
+    'SD1',
+    'SD2',
+    'SD3',
+    'XD4',
+    'XD5',
+)
+COLUMNS = ('time', *COMPONENTS)
+"""Columns of the influent data."""
+
+TEMP = COLUMNS.index('TEMP')
+
+_ERRORS = {
+    1: 'invalid number',
+    2: 'wrong number of columns',
+    3: 'value is not finite',
+    4: 'negative value',
+    5: 'time is not increasing',
+}
+
+_POW10 = np.array([10.0**k for k in range(23)])
+
+NEWLINE, CR, SPACE, TAB, COMMA = 10, 13, 32, 9, 44
+MAX_MANTISSA = 100000000000000000
+
+
+@jit(nopython=True, cache=True, nogil=True)
+def _count_rows(buf, start, stop):
+    rows = 0
+    blank = True
+    for i in range(start, stop):
+        c = buf[i]
+        if c == NEWLINE:
+            if not blank:
+                rows += 1
+            blank = True
+        elif c != CR and c != SPACE and c != TAB:
+            blank = False
+    if not blank:
+        rows += 1
+    return rows
+
+
+@jit(nopython=True, cache=True, nogil=True)
+def _parse_float(buf, i, stop):
+    """Parses a decimal number starting at `i`.
+
+    Returns the value, the index after the number, success and whether the value is correctly rounded
+    (mantissa below 2^53 and |exponent| <= 22, otherwise it is parsed again by Python).
+    """
+    negative = False
+    if i < stop and (buf[i] == 45 or buf[i] == 43):  # - +
+        negative = buf[i] == 45
+        i += 1
+    mantissa = 0
+    exponent = 0
+    digits = 0
+    exact = True
+    while i < stop and 48 <= buf[i] <= 57:
+        if mantissa < MAX_MANTISSA:
+            mantissa = 10 * mantissa + (buf[i] - 48)
+        else:
+            exponent += 1
+            exact = False
+        digits += 1
+        i += 1
+    if i < stop and buf[i] == 46:  # .
+        i += 1
+        while i < stop and 48 <= buf[i] <= 57:
+            if mantissa < MAX_MANTISSA:
+                mantissa = 10 * mantissa + (buf[i] - 48)
+                exponent -= 1
+            elif buf[i] != 48:
+                exact = False
+            digits += 1
+            i += 1
+    if digits == 0:
+        return 0.0, i, False, exact
+    if i < stop and (buf[i] == 101 or buf[i] == 69):  # e E
+        i += 1
+        negative_exponent = False
+        if i < stop and (buf[i] == 45 or buf[i] == 43):
+            negative_exponent = buf[i] == 45
+            i += 1
+        if i >= stop or not 48 <= buf[i] <= 57:
+            return 0.0, i, False, exact
+        e = 0
+        while i < stop and 48 <= buf[i] <= 57:
+            if e < 10000:
+                e = 10 * e + (buf[i] - 48)
+            i += 1
+        exponent += -e if negative_exponent else e
+    value = float(mantissa)
+    if mantissa > 1 << 53:
+        exact = False
+    if 0 <= exponent <= 22:
+        value *= _POW10[exponent]
+    elif -22 <= exponent < 0:
+        value /= _POW10[-exponent]
+    else:
+        value *= 10.0**exponent
+        exact = exact and mantissa == 0
+    return -value if negative else value, i, True, exact
+
+
+@jit(nopython=True, cache=True, nogil=True)
+def _parse_chunk(buf, start, stop, out, row, colmap, inexact):
+    """Parses the rows of `buf[start:stop]` into `out` from `row` on.
+
+    Start, end and output index of values that are not correctly rounded are stored in `inexact`.
+    Returns the first row after the chunk (the failing row on error), an error code (0 if the chunk was parsed)
+    and the number of inexact values.
+    """
+    ncols = len(colmap)
+    n_inexact = 0
+    i = start
+    while i < stop:
+        while i < stop and (buf[i] == SPACE or buf[i] == TAB or buf[i] == CR):
+            i += 1
+        if i < stop and buf[i] == NEWLINE:
+            i += 1
+            continue
+        if i >= stop:
+            break
+        col = 0
+        while True:
+            while i < stop and (buf[i] == SPACE or buf[i] == TAB):
+                i += 1
+            token = i
+            value, i, ok, exact = _parse_float(buf, i, stop)
+            if not ok:
+                return row, 1, n_inexact
+            if col < ncols and colmap[col] >= 0:
+                out[row, colmap[col]] = value
+                if not exact:
+                    if n_inexact < len(inexact):
+                        inexact[n_inexact, 0] = token
+                        inexact[n_inexact, 1] = i
+                        inexact[n_inexact, 2] = row * out.shape[1] + colmap[col]
+                    n_inexact += 1
+            col += 1
+            while i < stop and (buf[i] == SPACE or buf[i] == TAB or buf[i] == CR):
+                i += 1
+            if i < stop and buf[i] == COMMA:
+                i += 1
+            elif i >= stop or buf[i] == NEWLINE:
+                i += 1
+                break
+            else:
+                return row, 1, n_inexact
+        if col != ncols:
+            return row, 2, n_inexact
+        row += 1
+    return row, 0, n_inexact
+
+
+@jit(nopython=True, cache=True, nogil=True)
+def _validate_rows(data, start, stop, temp):
+    """Returns the first invalid row of `data[start:stop]` and an error code (-1, 0 if all rows are valid)."""
+    for row in range(start, stop):
+        for col in range(data.shape[1]):
+            value = data[row, col]
+            if not np.isfinite(value):
+                return row, 3
+            if value < 0 and col != temp and col != 0:
+                return row, 4
+        if row > start and data[row, 0] <= data[row - 1, 0]:
+            return row, 5
+    return -1, 0
+
+
+@jit(nopython=True, cache=True, nogil=True)
+def _find_newline(buf, i):
+    while i < len(buf) and buf[i] != NEWLINE:
+        i += 1
+    return min(i + 1, len(buf))
+
+
+def _chunks(buf, start, chunk_size):
+    """Splits `buf[start:]` into chunks of about `chunk_size` bytes that end at line ends."""
+    bounds = [start]
+    while bounds[-1] < len(buf):
+        bounds.append(_find_newline(buf, min(bounds[-1] + chunk_size, len(buf))))
+    return list(zip(bounds[:-1], bounds[1:], strict=True))
+
+
+def _header(buf):
+    """Returns the byte offset of the first data line and the column names of a header line (or None)."""
+    start = 3 if buf[:3].tobytes() == b'\xef\xbb\xbf' else 0
+    while True:
+        stop = _find_newline(buf, start)
+        line = buf[start:stop].tobytes().decode('utf-8', errors='replace').strip()
+        if line or stop >= len(buf):
+            break
+        start = stop
+    if any(ch.isalpha() and ch not in 'eE' for ch in line):
+        return stop, [name.strip().strip('"').strip("'") for name in line.split(',')], line
+    return start, None, line
+
+
+def _column_map(names, n_source, columns, defaults):
+    """Returns the output column of every source column (-1 if unused) and the defaults of unmapped columns."""
+    if columns is None:
+        if names is not None and {name.lower() for name in names} >= {name.lower() for name in COLUMNS}:
+            lower = [name.lower() for name in names]
+            columns = {name: lower.index(name.lower()) for name in COLUMNS}
+        else:
+            columns = {name: k for k, name in enumerate(COLUMNS) if k < n_source}
+    colmap = -np.ones(n_source, dtype=np.int64)
+    for target, source in columns.items():
+        if target not in COLUMNS:
+            raise ValueError(f'Unknown influent column {target!r}, expected one of {COLUMNS}.')
+        if isinstance(source, str):
+            if names is None or source not in names:
+                raise ValueError(f'Column {source!r} not found in the header of the influent file.')
+            source = names.index(source)
+        if not 0 <= source < n_source:
+            raise ValueError(f'Column {source} of {target!r} is out of range, the file has {n_source} columns.')
+        colmap[source] = COLUMNS.index(target)
+    fill = {}
+    for k, name in enumerate(COLUMNS):
+        if k not in colmap:
+            if defaults is None or name not in defaults:
+                raise ValueError(f'Influent column {name!r} is neither mapped nor given in defaults.')
+            fill[k] = defaults[name]
+    return colmap, fill
+
+
+def read_influent(
+    path: str,
+    columns: dict | None = None,
+    defaults: dict | None = None,
+    store: str | None = None,
+    n_threads: int | None = None,
+    chunk_size: int = 1 << 24,
+    validate: bool = True,
+):
+    """Reads an influent CSV file with several threads.
+
+    Parameters
+    ----------
+    path : str
+        Path of the CSV file. Lines are separated by newlines, values by commas. An optional header line
+        names the columns.
+    columns : dict{str: int | str} (optional)
+        Source column (index or header name) of every influent column in `COLUMNS`. <br>
+        If not provided, columns are matched by the header names or taken in the order of `COLUMNS`.
+    defaults : dict{str: float} (optional)
+        Constant values of influent columns that are not in the file, e.g. {'SD1': 0}.
+    store : str (optional)
+        Path of a binary influent store (`.npy`). If provided, the file is parsed directly into the
+        memory-mapped store.
+    n_threads : int (optional)
+        Number of parsing threads. <br>
+        Default is the number of CPUs.
+    chunk_size : int (optional)
+        Bytes per chunk. <br>
+        Default is 16 MiB.
+    validate : bool (optional)
+        Checks that all values are finite, all components except the temperature are not negative
+        and the time is strictly increasing. <br>
+        Default is True.
+
+    Returns
+    -------
+    data_in : np.ndarray(n, 22)
+        Influent data (a memory map of `store` if provided).
+    """
+
+    if os.path.getsize(path) == 0:
+        raise ValueError(f'Influent file {path} is empty.')
+    buf = np.memmap(path, dtype=np.uint8, mode='r')
+    start, names, first = _header(buf)
+    n_source = len(first.split(',')) if names is None else len(names)
+    colmap, fill = _column_map(names, n_source, columns, defaults)
+    chunks = _chunks(buf, start, max(chunk_size, 1))
+    n_threads = n_threads or os.cpu_count() or 1
+
+    with ThreadPoolExecutor(max_workers=n_threads) as executor:
+        counts = list(executor.map(lambda chunk: _count_rows(buf, *chunk), chunks))
+        offsets = np.concatenate(([0], np.cumsum(counts)))
+        shape = (int(offsets[-1]), len(COLUMNS))
+        if store is None:
+            data = np.empty(shape)
+        else:
+            data = np.lib.format.open_memmap(store, mode='w+', dtype=np.float64, shape=shape)
+        for k, value in fill.items():
+            data[:, k] = value
+
+        def parse(k):
+            inexact = np.empty((1024, 3), dtype=np.int64)
+            row, code, n_inexact = _parse_chunk(buf, *chunks[k], data, offsets[k], colmap, inexact)
+            if n_inexact > len(inexact) and code == 0:
+                inexact = np.empty((n_inexact, 3), dtype=np.int64)
+                row, code, n_inexact = _parse_chunk(buf, *chunks[k], data, offsets[k], colmap, inexact)
+            flat = data.reshape(-1)
+            for start, stop, index in inexact[: min(n_inexact, len(inexact))]:
+                flat[index] = float(buf[start:stop].tobytes())
+            if code == 0 and validate:
+                row, code = _validate_rows(data, offsets[k], offsets[k + 1], TEMP)
+            return row, code
+
+        errors = [(row, code) for row, code in executor.map(parse, range(len(chunks))) if code]
+    if errors:
+        row, code = min(errors)
+        raise ValueError(f'Influent file {path}, data row {row + 1}: {_ERRORS[code]}.')
+    if validate:
+        for row in offsets[1:-1]:
+            if 0 < row < len(data) and data[row, 0] <= data[row - 1, 0]:
+                raise ValueError(f'Influent file {path}, data row {row + 1}: {_ERRORS[5]}.')
+    if store is not None:
+        data.flush()
+    return data
+
+
+def load_influent(path: str, **kwargs):
+    """Loads influent data from a binary influent store (`.npy`, memory-mapped copy-on-write) or a CSV file.
+
+    Keyword arguments are passed to `read_influent`.
+    """
+    if path.endswith('.npy'):
+        data = np.load(path, mmap_mode='c')
+        if data.ndim != 2 or data.shape[1] != len(COLUMNS):
+            raise ValueError(f'Influent store {path} has shape {data.shape}, expected (n, {len(COLUMNS)}).')
+        return data
+    return read_influent(path, **kwargs)
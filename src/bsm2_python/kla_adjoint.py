@@ -0,0 +1,626 @@
+"""Gradients of aeration cost and effluent quality with respect to KLa trajectories by a discrete adjoint.
+
+The sequential `odeint` calls of the plant models cannot be differentiated. `KlaAdjoint` therefore
+integrates the activated sludge line (five ASM1 reactors, internal recycle, settler and return sludge)
+as one coupled system with the implicit Euler method, using the same right-hand sides
+(`asm1equations`, `settlerequations`) as the plant models. For this discrete model, the gradient of
+
+    J = w_ae * AE + w_eqi * EQI + w_penalty * P
+
+with respect to all KLa values of all time steps is obtained in a single backward pass:
+
+- AE: mean aeration energy [kWh ⋅ d⁻¹] as in `PlantPerformance.aerationenergy_step`,
+- EQI: mean effluent quality index [kg(PU) ⋅ d⁻¹] as in `PlantPerformance.eqi`,
+- P: mean smoothed exceedance of the effluent ammonia limit [g(N) ⋅ m⁻³].
+
+The Jacobians of the right-hand side are computed by coloured finite differences. Memory is bounded by
+checkpointing: only every `checkpoint_every`-th state is stored during the forward pass and the
+states in between are recomputed segment by segment during the backward pass.
+"""
+
+from dataclasses import dataclass
+
+import numpy as np
+from numba import jit
+from scipy.optimize import minimize
+
+from bsm2_python.bsm2.asm1_bsm2 import asm1equations, carbonaddition
+from bsm2_python.bsm2.jacobian import ColouredJacobian, compress, settler_sparsity
+from bsm2_python.bsm2.settler1d_bsm2 import get_output, settlerequations
+
+indices_components = np.arange(21)
+SI, SS, XI, XS, XBH, XBA, XP, SO, SNO, SNH, SND, XND, SALK, TSS, Q, TEMP, SD1, SD2, SD3, XD4, XD5 = indices_components
+
+N_REACTORS = 5
+N_ASM1 = 21
+# indices of the pollutant weighting factors in the plant performance parameters
+BSS, BCOD, BNKJ, BNO, BBOD5 = 5, 6, 7, 8, 9
+
+
+@jit(nopython=True, cache=True)
+def _mix(y_a, y_b):
+    """Mixes two ASM1 streams by their flow rates."""
+    y_out = y_a.copy()
+    q_total = y_a[Q] + y_b[Q]
+    if q_total > 0.0:
+        y_out[0:14] = (y_a[0:14] * y_a[Q] + y_b[0:14] * y_b[Q]) / q_total
+        y_out[15:21] = (y_a[15:21] * y_a[Q] + y_b[15:21] * y_b[Q]) / q_total
+    y_out[Q] = q_total
+    return y_out
+
+
+@jit(nopython=True, cache=True)
+def _reactor_tss(y, asm1par):
+    return asm1par[19] * y[XI] + asm1par[20] * y[XS] + asm1par[21] * y[XBH] + asm1par[22] * y[XBA] + asm1par[23] * y[XP]
+
+
+@jit(nopython=True, cache=True)
+def line_streams(x, y_ext, asm1pars, carbs, csourceconc, qintr, q_r, q_w, sedpar, dim, layer, tempmodel):
+    """Returns the reactor inlets, the settler inlet, the return sludge and the effluent of the coupled line.
+
+    Parameters
+    ----------
+    x : np.ndarray(5 * 21 + 12 * nooflayers)
+        Reactor concentrations followed by the settler states.
+    y_ext : np.ndarray(21)
+        External inflow to the first reactor (without internal recycle and return sludge).
+
+    Returns
+    -------
+    inlets : np.ndarray(5, 21)
+        Inlets of the reactors (after carbon addition).
+    ys_in : np.ndarray(21)
+        Settler inlet.
+    ys_ret : np.ndarray(21)
+        Return sludge.
+    ys_eff : np.ndarray(21)
+        Effluent.
+    """
+
+    nooflayers = layer[1]
+    n_r = N_REACTORS * N_ASM1
+    ys = x[n_r:]
+    flow_ext = y_ext[Q]
+    flow_carb = 0.0
+    for k in range(N_REACTORS):
+        flow_carb += carbs[k]
+    q5 = flow_ext + qintr + q_r + flow_carb
+
+    y5 = x[(N_REACTORS - 1) * N_ASM1 : n_r].copy()
+    y5[TSS] = _reactor_tss(y5, asm1pars[N_REACTORS - 1])
+    if not tempmodel:
+        y5[TEMP] = y_ext[TEMP]
+    ys_in = y5.copy()
+    ys_in[Q] = q5 - qintr
+    ys_ret, _, ys_eff, _, _ = get_output(ys, ys_in, nooflayers, tempmodel, q_r, q_w, dim, asm1pars[0], sedpar)
+
+    recycle = y5.copy()
+    recycle[Q] = qintr
+    inlets = np.empty((N_REACTORS, N_ASM1))
+    y_in = _mix(_mix(y_ext, ys_ret), recycle)
+    for k in range(N_REACTORS):
+        if k > 0:
+            y_in = x[(k - 1) * N_ASM1 : k * N_ASM1].copy()
+            y_in[TSS] = _reactor_tss(y_in, asm1pars[k - 1])
+            y_in[Q] = inlets[k - 1, Q]
+            if not tempmodel:
+                y_in[TEMP] = inlets[k - 1, TEMP]
+        if carbs[k] > 0.0:
+            y_in = carbonaddition(y_in.copy(), carbs[k], csourceconc)
+        inlets[k] = y_in
+    return inlets, ys_in, ys_ret, ys_eff
+
+
+@jit(nopython=True, cache=True)
+def line_rhs(x, klas, y_ext, params):
+    """Right-hand side of the coupled activated sludge line.
+
+    Parameters
+    ----------
+    x : np.ndarray(5 * 21 + 12 * nooflayers)
+        Reactor concentrations followed by the settler states.
+    klas : np.ndarray(5)
+        KLa values of the reactors [d⁻¹].
+    y_ext : np.ndarray(21)
+        External inflow to the first reactor.
+    params : tuple
+        (asm1pars, volumes, carbs, csourceconc, qintr, q_r, q_w, sedpar, dim, layer, tempmodel, activate,
+        smoothing)
+
+    Returns
+    -------
+    dx : np.ndarray(5 * 21 + 12 * nooflayers)
+        Time derivative of `x` [d⁻¹].
+    """
+
+    asm1pars, volumes, carbs, csourceconc, qintr, q_r, q_w, sedpar, dim, layer, tempmodel, activate, smoothing = params
+    inlets, ys_in, _, _ = line_streams(
+        x, y_ext, asm1pars, carbs, csourceconc, qintr, q_r, q_w, sedpar, dim, layer, tempmodel
+    )
+    n_r = N_REACTORS * N_ASM1
+    dx = np.zeros(len(x))
+    for k in range(N_REACTORS):
+        y = x[k * N_ASM1 : (k + 1) * N_ASM1].copy()
+        dx[k * N_ASM1 : (k + 1) * N_ASM1] = asm1equations(
+            0.0, y, inlets[k], asm1pars[k], klas[k], volumes[k], tempmodel, activate
+        )
+    dx[n_r:] = settlerequations(0.0, x[n_r:].copy(), ys_in, sedpar, dim, layer, q_r, q_w, tempmodel, 0, smoothing)
+    return dx
+
+
+@jit(nopython=True, cache=True)
+def _fd_jacobian(x, klas, y_ext, params, f0, colouring):
+    """Forward difference Jacobian, all columns of one colour are perturbed together."""
+    colours, ptr, rows, cols = colouring
+    n = len(x)
+    delta = 1e-7 * np.maximum(np.abs(x), 1.0)
+    jac = np.zeros((n, n))
+    for c in range(len(ptr) - 1):
+        x_pert = x.copy()
+        for j in range(n):
+            if colours[j] == c:
+                x_pert[j] += delta[j]
+        df = line_rhs(x_pert, klas, y_ext, params) - f0
+        for k in range(ptr[c], ptr[c + 1]):
+            jac[rows[k], cols[k]] = df[rows[k]] / delta[cols[k]]
+    return jac
+
+
+@jit(nopython=True, cache=True)
+def _fd_kla_jacobian(x, klas, y_ext, params, f0):
+    jac = np.empty((len(x), len(klas)))
+    for j in range(len(klas)):
+        delta = 1e-6 * max(abs(klas[j]), 1.0)
+        klas_pert = klas.copy()
+        klas_pert[j] += delta
+        jac[:, j] = (line_rhs(x, klas_pert, y_ext, params) - f0) / delta
+    return jac
+
+
+@jit(nopython=True, cache=True)
+def _residual_norm(residual, z):
+    return np.max(np.abs(residual) / (1.0 + np.abs(z)))
+
+
+@jit(nopython=True, cache=True)
+def implicit_euler_step(x, klas, y_ext, params, h, colouring):
+    """Solves z = x + h * f(z) with a damped Newton method.
+
+    The settling velocities are only piecewise smooth, so full Newton steps can cycle between
+    the branches. Steps are therefore halved until the residual decreases.
+
+    Returns
+    -------
+    z : np.ndarray
+        State after the substep.
+    converged : bool
+        `True` if the Newton iteration converged.
+    """
+
+    n = len(x)
+    z = x.copy()
+    f_z = line_rhs(z, klas, y_ext, params)
+    residual = z - x - h * f_z
+    norm = _residual_norm(residual, z)
+    for _ in range(50):
+        if norm < 1e-10:
+            return z, True
+        jac = _fd_jacobian(z, klas, y_ext, params, f_z, colouring)
+        delta = np.linalg.solve(np.eye(n) - h * jac, residual)
+        alpha = 1.0
+        for _ in range(30):
+            z_new = z - alpha * delta
+            f_new = line_rhs(z_new, klas, y_ext, params)
+            residual_new = z_new - x - h * f_new
+            norm_new = _residual_norm(residual_new, z_new)
+            if norm_new < norm:
+                break
+            alpha *= 0.5
+        z, f_z, residual, norm = z_new, f_new, residual_new, norm_new
+    return z, norm < 1e-8
+
+
+@jit(nopython=True, cache=True)
+def effluent_quality(y_eff, pp_par, asm1par):
+    """Returns the effluent quality index of an effluent stream [kg(PU) ⋅ d⁻¹] as in `PlantPerformance.eqi`."""
+    tkn = (
+        y_eff[SNH]
+        + y_eff[SND]
+        + y_eff[XND]
+        + asm1par[17] * (y_eff[XBH] + y_eff[XBA])
+        + asm1par[18] * (y_eff[XP] + y_eff[XI])
+    )
+    cod = y_eff[SS] + y_eff[SI] + y_eff[XS] + y_eff[XI] + y_eff[XBH] + y_eff[XBA] + y_eff[XP]
+    bod5e = 0.25 * (y_eff[SS] + y_eff[XS] + (1 - asm1par[16]) * (y_eff[XBH] + y_eff[XBA]))
+    return (
+        (
+            pp_par[BSS] * y_eff[TSS]
+            + pp_par[BCOD] * cod
+            + pp_par[BNKJ] * tkn
+            + pp_par[BNO] * y_eff[SNO]
+            + pp_par[BBOD5] * bod5e
+        )
+        * y_eff[Q]
+        / 1000
+    )
+
+
+@jit(nopython=True, cache=True)
+def _state_cost(x, y_ext, params, pp_par, snh_limit, width, w_eqi, w_penalty):
+    asm1pars, _, carbs, csourceconc, qintr, q_r, q_w, sedpar, dim, layer, tempmodel, _, _ = params
+    _, _, _, ys_eff = line_streams(
+        x, y_ext, asm1pars, carbs, csourceconc, qintr, q_r, q_w, sedpar, dim, layer, tempmodel
+    )
+    eqi = effluent_quality(ys_eff, pp_par, asm1pars[0])
+    arg = (ys_eff[SNH] - snh_limit) / width
+    # numerically stable softplus
+    penalty = width * (max(arg, 0.0) + np.log1p(np.exp(-abs(arg))))
+    return w_eqi * eqi + w_penalty * penalty, eqi, penalty
+
+
+@jit(nopython=True, cache=True)
+def _state_cost_gradient(x, y_ext, params, pp_par, snh_limit, width, w_eqi, w_penalty):
+    c0, _, _ = _state_cost(x, y_ext, params, pp_par, snh_limit, width, w_eqi, w_penalty)
+    grad = np.empty(len(x))
+    for j in range(len(x)):
+        delta = 1e-7 * max(abs(x[j]), 1.0)
+        x_pert = x.copy()
+        x_pert[j] += delta
+        grad[j] = (_state_cost(x_pert, y_ext, params, pp_par, snh_limit, width, w_eqi, w_penalty)[0] - c0) / delta
+    return grad
+
+
+def line_parameters(model):
+    """Returns the state and the parameters of the coupled activated sludge line of a plant model.
+
+    Parameters
+    ----------
+    model : BSM1Base | BSM2Base
+        Plant model with `reactor1` ... `reactor5`, `settler` and `qintr`.
+
+    Returns
+    -------
+    x0 : np.ndarray(5 * 21 + 12 * nooflayers)
+        Current reactor concentrations followed by the settler states.
+    params : tuple
+        (asm1pars, volumes, carbs, csourceconc, qintr, q_r, q_w, sedpar, dim, layer, tempmodel, activate,
+        smoothing)
+        as used by `line_rhs`.
+    """
+
+    reactors = [getattr(model, f'reactor{k}') for k in range(1, N_REACTORS + 1)]
+    settler = model.settler
+    x0 = np.concatenate([np.asarray(r.y0, dtype=float) for r in reactors] + [np.asarray(settler.ys0, dtype=float)])
+    params = (
+        np.array([np.asarray(r.asm1par, dtype=float) for r in reactors]),
+        np.array([float(r.volume) for r in reactors]),
+        np.array([float(r.carb) for r in reactors]),
+        float(reactors[0].csourceconc),
+        float(model.qintr),
+        float(settler.q_r),
+        float(settler.q_w),
+        np.asarray(settler.sedpar, dtype=float),
+        np.asarray(settler.dim, dtype=float),
+        np.asarray(settler.layer, dtype=np.int64),
+        bool(reactors[0].tempmodel),
+        bool(reactors[0].activate),
+        float(settler.smoothing),
+    )
+    return x0, params
+
+
+def line_sparsity(params):
+    """Returns the structural Jacobian pattern of the settler within the coupled line.
+
+    The pattern is combined with the detected one, as the flux limitation of the settler hides dependencies
+    from perturbation (see `bsm2_python.bsm2.jacobian`).
+    """
+
+    layer, tempmodel = params[9], params[10]
+    n_r = N_REACTORS * N_ASM1
+    n = n_r + 12 * layer[1]
+    pattern = np.zeros((n, n), dtype=bool)
+    pattern[n_r:, n_r:] = settler_sparsity(layer[1], tempmodel)
+    return pattern
+
+
+def line_colouring(x, klas, y_ext, params):
+    """Returns the column colouring of the Jacobian of `line_rhs` for `_fd_jacobian`.
+
+    Returns
+    -------
+    colouring : tuple
+        (colours, ptr, rows, cols), see `bsm2_python.bsm2.jacobian.compress`.
+    """
+
+    jacobian = ColouredJacobian(
+        lambda z: line_rhs(z, klas, y_ext, params), x, structure=line_sparsity(params), rel_step=1e-7
+    )
+    ptr, rows, cols = compress(jacobian.pattern, jacobian.colours)
+    return jacobian.colours.astype(np.int64), ptr, rows, cols
+
+
+@dataclass
+class AdjointResult:
+    """Cost and gradient of a KLa trajectory.
+
+    cost : float
+        Value of the objective.
+    gradient : np.ndarray(n_steps, 5)
+        Derivative of the objective with respect to the KLa values [d].
+    terms : dict{str: float}
+        Mean aeration energy 'ae' [kWh ⋅ d⁻¹], effluent quality index 'eqi' [kg(PU) ⋅ d⁻¹]
+        and ammonia penalty 'penalty' [g(N) ⋅ m⁻³].
+    """
+
+    cost: float
+    gradient: np.ndarray
+    terms: dict
+
+
+class KlaAdjoint:
+    """Creates a KlaAdjoint object.
+
+    Parameters
+    ----------
+    x0 : np.ndarray(5 * 21 + 12 * nooflayers)
+        Initial reactor concentrations followed by the settler states.
+    inflow : np.ndarray(n_steps, 21)
+        External inflow to the first reactor at every time step (zero-order hold).
+    timestep : float
+        Length of a KLa interval [d].
+    params : tuple
+        (asm1pars, volumes, carbs, csourceconc, qintr, q_r, q_w, sedpar, dim, layer, tempmodel, activate,
+        smoothing), see `from_model`.
+    pp_par : np.ndarray(17)
+        Plant performance parameters.
+    weights : tuple(float, float, float) (optional)
+        Weights of mean aeration energy, EQI and ammonia penalty. <br>
+        Default is (1, 1, 0).
+    snh_limit : float (optional)
+        Effluent ammonia limit of the penalty [g(N) ⋅ m⁻³]. <br>
+        Default is 4.
+    penalty_width : float (optional)
+        Smoothing width of the penalty [g(N) ⋅ m⁻³]. <br>
+        Default is 0.1.
+    sosat : np.ndarray(5) (optional)
+        Oxygen saturation concentrations used for the aeration energy [g(O₂) ⋅ m⁻³]. <br>
+        Default is 8 in all reactors.
+    n_sub : int (optional)
+        Implicit Euler substeps per KLa interval. <br>
+        Default is 3.
+    max_halvings : int (optional)
+        Maximum number of times a substep is halved if its Newton iteration fails. <br>
+        Default is 4.
+    checkpoint_every : int (optional)
+        Distance between stored states of the forward pass [steps]. <br>
+        Default is the square root of the number of steps.
+    """
+
+    def __init__(
+        self,
+        x0,
+        inflow,
+        timestep: float,
+        params: tuple,
+        pp_par,
+        *,
+        weights: tuple = (1.0, 1.0, 0.0),
+        snh_limit: float = 4.0,
+        penalty_width: float = 0.1,
+        sosat=None,
+        n_sub: int = 3,
+        max_halvings: int = 4,
+        checkpoint_every: int | None = None,
+    ):
+        self.x0 = np.array(x0, dtype=float)
+        self.inflow = np.atleast_2d(np.array(inflow, dtype=float))
+        self.n_steps = self.inflow.shape[0]
+        self.timestep = float(timestep)
+        self.params = params
+        self.pp_par = np.asarray(pp_par, dtype=float)
+        self.weights = tuple(float(w) for w in weights)
+        self.snh_limit = float(snh_limit)
+        self.penalty_width = float(penalty_width)
+        self.sosat = np.full(N_REACTORS, 8.0) if sosat is None else np.asarray(sosat, dtype=float)
+        self.volumes = np.asarray(params[1], dtype=float)
+        self.n_sub = int(n_sub)
+        self.max_halvings = int(max_halvings)
+        if checkpoint_every is None:
+            checkpoint_every = max(int(np.sqrt(self.n_steps)), 1)
+        self.checkpoint_every = int(checkpoint_every)
+        # colouring of the line Jacobian, detected at the first step
+        self.colouring = None
+
+    @classmethod
+    def from_model(cls, model, inflow=None, n_steps: int | None = None, **kwargs):
+        """Creates a KlaAdjoint from the current state of a BSM1 or BSM2 plant model.
+
+        Parameters
+        ----------
+        model : BSM1Base | BSM2Base
+            Plant model. The current reactor and settler states are the initial state.
+        inflow : np.ndarray(n_steps, 21) (optional)
+            External inflow to the first reactor. <br>
+            For BSM1 models the influent data is used if not provided, BSM2 models require it
+            (e.g. the recorded primary clarifier effluent plus sludge line returns).
+        n_steps : int (optional)
+            Number of KLa intervals. Required if `inflow` is not provided.
+        **kwargs
+            Further keyword arguments of `KlaAdjoint`.
+        """
+
+        if inflow is None:
+            if hasattr(model, 'adm1_reactor') or n_steps is None:
+                raise ValueError('The external inflow of the activated sludge line has to be provided.')
+            rows = [np.where(model.data_time <= t)[0][-1] for t in model.simtime[:n_steps]]
+            inflow = model.y_in[rows, :]
+        x0, params = line_parameters(model)
+        return cls(x0, inflow, model.timesteps[0], params, model.performance.pp_par, **kwargs)
+
+    def _check(self, klas):
+        klas = np.asarray(klas, dtype=float)
+        if klas.shape != (self.n_steps, N_REACTORS):
+            err = f'KLa trajectory must have shape ({self.n_steps}, {N_REACTORS}), got {klas.shape}.'
+            raise ValueError(err)
+        return klas
+
+    def _step(self, x, klas, y_ext):
+        """Advances one KLa interval.
+
+        A substep whose Newton iteration fails is split into two halves (at most `max_halvings` times).
+        The split is deterministic, so the backward pass recomputes exactly the same discrete scheme.
+
+        Returns
+        -------
+        states : list[np.ndarray]
+            States after every substep, preceded by the start state.
+        steps : list[float]
+            Lengths of the substeps [d].
+        """
+
+        if self.colouring is None:
+            self.colouring = line_colouring(x, klas, y_ext, self.params)
+        states = [x]
+        steps = []
+        pending = [self.timestep / self.n_sub] * self.n_sub
+        while pending:
+            h = pending.pop(0)
+            z, converged = implicit_euler_step(states[-1], klas, y_ext, self.params, h, self.colouring)
+            if not converged:
+                if h < self.timestep / (self.n_sub * 2**self.max_halvings):
+                    raise RuntimeError('Newton iteration of the implicit Euler step did not converge.')
+                pending = [0.5 * h, 0.5 * h, *pending]
+                continue
+            states.append(z)
+            steps.append(h)
+        return states, steps
+
+    def _costs(self, x_end, klas_k, y_ext):
+        _, w_eqi, w_pen = self.weights
+        _, eqi, penalty = _state_cost(
+            x_end, y_ext, self.params, self.pp_par, self.snh_limit, self.penalty_width, w_eqi, w_pen
+        )
+        ae = np.sum(self.sosat * self.volumes * klas_k) / 1800.0
+        return ae, eqi, penalty
+
+    def evaluate(self, klas):
+        """Simulates the KLa trajectory and returns the objective and its terms.
+
+        Parameters
+        ----------
+        klas : np.ndarray(n_steps, 5)
+            KLa values of the reactors for every interval [d⁻¹].
+
+        Returns
+        -------
+        cost : float
+            Value of the objective.
+        terms : dict{str: float}
+            Mean 'ae', 'eqi' and 'penalty'.
+        """
+
+        cost, terms, _, _ = self._forward(self._check(klas), store=False)
+        return cost, terms
+
+    def _forward(self, klas, *, store):
+        horizon = self.n_steps * self.timestep
+        totals = np.zeros(3)
+        checkpoints = {0: self.x0.copy()}
+        x = self.x0.copy()
+        for k in range(self.n_steps):
+            x = self._step(x, klas[k], self.inflow[k])[0][-1]
+            totals += np.array(self._costs(x, klas[k], self.inflow[k])) * self.timestep / horizon
+            if store and (k + 1) % self.checkpoint_every == 0:
+                checkpoints[k + 1] = x.copy()
+        w_ae, w_eqi, w_pen = self.weights
+        cost = w_ae * totals[0] + w_eqi * totals[1] + w_pen * totals[2]
+        terms = {'ae': float(totals[0]), 'eqi': float(totals[1]), 'penalty': float(totals[2])}
+        return float(cost), terms, checkpoints, x
+
+    def gradient(self, klas):
+        """Returns the objective and its gradient with respect to the complete KLa trajectory.
+
+        Parameters
+        ----------
+        klas : np.ndarray(n_steps, 5)
+            KLa values of the reactors for every interval [d⁻¹].
+
+        Returns
+        -------
+        result : AdjointResult
+            Objective, gradient and terms.
+        """
+
+        klas = self._check(klas)
+        cost, terms, checkpoints, _ = self._forward(klas, store=True)
+        w_ae, w_eqi, w_pen = self.weights
+        horizon = self.n_steps * self.timestep
+        scale = self.timestep / horizon
+        n = len(self.x0)
+        identity = np.eye(n)
+
+        grad = np.zeros((self.n_steps, N_REACTORS))
+        grad += w_ae * scale * self.sosat * self.volumes / 1800.0
+        lam = np.zeros(n)
+        starts = sorted(checkpoints)
+        for seg_start in reversed(starts):
+            seg_end = min(seg_start + self.checkpoint_every, self.n_steps)
+            if seg_start >= self.n_steps:
+                continue
+            # recompute the states of the segment from its checkpoint
+            x = checkpoints[seg_start]
+            segment = []
+            for k in range(seg_start, seg_end):
+                states, steps = self._step(x, klas[k], self.inflow[k])
+                segment.append((states, steps))
+                x = states[-1]
+            for k in range(seg_end - 1, seg_start - 1, -1):
+                states, steps = segment[k - seg_start]
+                y_ext = self.inflow[k]
+                lam = lam + scale * _state_cost_gradient(
+                    states[-1], y_ext, self.params, self.pp_par, self.snh_limit, self.penalty_width, w_eqi, w_pen
+                )
+                for s in range(len(steps), 0, -1):
+                    h = steps[s - 1]
+                    z = states[s]
+                    f_z = line_rhs(z, klas[k], y_ext, self.params)
+                    jac = _fd_jacobian(z, klas[k], y_ext, self.params, f_z, self.colouring)
+                    mu = np.linalg.solve((identity - h * jac).T, lam)
+                    grad[k] += h * _fd_kla_jacobian(z, klas[k], y_ext, self.params, f_z).T @ mu
+                    lam = mu
+        return AdjointResult(cost, grad, terms)
+
+    def optimise(self, klas0, kla_max: float = 360.0, maxiter: int = 20):
+        """Minimises the objective over the KLa trajectory with L-BFGS-B.
+
+        Parameters
+        ----------
+        klas0 : np.ndarray(n_steps, 5)
+            Initial KLa trajectory [d⁻¹].
+        kla_max : float | np.ndarray(5) (optional)
+            Upper bound of the KLa values [d⁻¹]. <br>
+            Default is 360.
+        maxiter : int (optional)
+            Maximum number of iterations. <br>
+            Default is 20.
+
+        Returns
+        -------
+        klas : np.ndarray(n_steps, 5)
+            Optimised KLa trajectory [d⁻¹].
+        result : AdjointResult
+            Objective, gradient and terms of the optimised trajectory.
+        """
+
+        klas0 = self._check(klas0)
+        upper = np.broadcast_to(np.asarray(kla_max, dtype=float), (N_REACTORS,))
+        bounds = [(0.0, upper[j]) for _ in range(self.n_steps) for j in range(N_REACTORS)]
+
+        def fun(flat):
+            result = self.gradient(flat.reshape(self.n_steps, N_REACTORS))
+            return result.cost, result.gradient.ravel()
+
+        opt = minimize(fun, klas0.ravel(), jac=True, method='L-BFGS-B', bounds=bounds, options={'maxiter': maxiter})
+        klas = opt.x.reshape(self.n_steps, N_REACTORS)
+        return klas, self.gradient(klas)
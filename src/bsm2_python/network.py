@@ -0,0 +1,356 @@
+"""Simulation of several plants sharing a catchment, connected by sewer reaches.
+
+The network consists of
+
+- catchments: influent data (time and 21 components) like the `data_in` of a single plant,
+- sewer reaches: cascades of hydraulic delays (`HydraulicDelay`, hyddelayv3) with a travel time,
+- plants: BSM models (e.g. `BSM1OL`, `BSM2OL`) whose influent is the combined inflow of the network.
+
+Streams are ASM1 arrays, several streams entering a node are combined. Catchments and reaches are cheap
+and are evaluated by the coordinator. Every plant runs in its own process and only the boundary streams
+are exchanged: the coordinator sends the influent of `exchange_every` time steps to all plants, the plants
+simulate these steps in parallel and return their outflows. Streams leaving a plant therefore arrive
+`exchange_every` time steps later in the network (bounded latency, in the first window the initial
+outflow of the plant is used). With `processes=False` all plants run in the coordinator, with the same
+exchange pattern and therefore the same results.
+"""
+
+import multiprocessing
+from collections import defaultdict
+from dataclasses import dataclass
+
+import numpy as np
+
+from bsm2_python.bsm2.helpers_bsm2 import Combiner
+from bsm2_python.bsm2.hyddelay_bsm2 import HydraulicDelay
+from bsm2_python.bsm2.init import asm1init_bsm2 as asm1init
+from bsm2_python.engine.scheduler import schedule
+from bsm2_python.log import logger
+
+Q = 14
+
+
+@dataclass
+class _Connection:
+    source: str
+    target: str
+    output: str | None
+    fraction: float
+
+
+@dataclass
+class _Plant:
+    factory: object
+    outputs: tuple
+    record: list | None
+    y_init: np.ndarray | None
+
+
+class SewerReach:
+    """Creates a SewerReach object, a cascade of `n_tanks` hydraulic delays.
+
+    Parameters
+    ----------
+    travel_time : float
+        Mean travel time of the reach [d].
+    n_tanks : int (optional)
+        Number of delays in series, more delays give less dispersion. <br>
+        Default is 1.
+    asm1par : np.ndarray(24) (optional)
+        ASM1 parameters for the conversion to TSS. <br>
+        Default is `asm1init_bsm2.PAR1`.
+    """
+
+    def __init__(self, travel_time: float, n_tanks: int = 1, asm1par=None):
+        asm1par = asm1init.PAR1 if asm1par is None else asm1par
+        self.delays = [HydraulicDelay(asm1par, travel_time / n_tanks) for _ in range(n_tanks)]
+
+    def output(self, timestep, step, y_in):
+        """Returns the ASM1 array at the outlet of the reach."""
+        y = y_in
+        for delay in self.delays:
+            y = delay.output(timestep, step, y)
+        return y
+
+
+class _PlantWorker:
+    """Simulates one plant of the network window by window."""
+
+    def __init__(self, factory, data_in, timestep, outputs, record):
+        self.model = factory(data_in=data_in, timestep=timestep)
+        self.outputs = outputs
+        self.record = record
+
+    def initial(self):
+        return np.array([getattr(self.model, name) for name in self.outputs], dtype=float)
+
+    def run(self, start, y_in):
+        model = self.model
+        out = np.empty((len(y_in), len(self.outputs), 21))
+        for k, y in enumerate(y_in):
+            i = start + k
+            model.y_in[model._influent_row(model.simtime[i])] = y
+            model.step(i)
+            out[k] = [getattr(model, name) for name in self.outputs]
+        model.next_step = start + len(y_in)
+        return out
+
+    def recorded(self, n_steps):
+        if self.record is None:
+            return {}
+        return {name: np.array(values) for name, values in self.model._recorded(0, n_steps, self.record).items()}
+
+
+def _plant_process(conn, factory, data_in, timestep, outputs, record):
+    worker = _PlantWorker(factory, data_in, timestep, outputs, record)
+    conn.send(worker.initial())
+    while True:
+        message = conn.recv()
+        if message[0] == 'run':
+            conn.send(worker.run(*message[1:]))
+        else:
+            conn.send(worker.recorded(message[1]))
+            break
+    conn.close()
+
+
+class _PlantProcess:
+    """Same interface as `_PlantWorker`, the plant is simulated in a separate process."""
+
+    def __init__(self, context, factory, data_in, timestep, outputs, record):
+        self.conn, child = context.Pipe()
+        self.process = context.Process(
+            target=_plant_process, args=(child, factory, data_in, timestep, outputs, record), daemon=True
+        )
+        self.process.start()
+        child.close()
+        self._initial = None
+
+    def initial(self):
+        if self._initial is None:
+            self._initial = self.conn.recv()
+        return self._initial
+
+    def start(self, start, y_in):
+        self.conn.send(('run', start, y_in))
+
+    def result(self):
+        return self.conn.recv()
+
+    def recorded(self, n_steps):
+        self.conn.send(('stop', n_steps))
+        recorded = self.conn.recv()
+        self.process.join()
+        return recorded
+
+
+class PlantNetwork:
+    """Creates a PlantNetwork object.
+
+    Parameters
+    ----------
+    timestep : float
+        Timestep of the simulation and of the exchange between the plants [d].
+    endtime : float
+        Endtime of the simulation [d].
+    exchange_every : int (optional)
+        Number of time steps that the plants simulate between two exchanges of the boundary streams. This is
+        also the latency of streams leaving a plant. <br>
+        Default is 1.
+    processes : bool (optional)
+        If `True`, every plant runs in its own process. <br>
+        Default is `True`.
+    mp_context : str (optional)
+        Start method of the processes, see `multiprocessing.get_context`. <br>
+        Default is the platform default.
+    """
+
+    def __init__(
+        self,
+        timestep: float,
+        endtime: float,
+        *,
+        exchange_every: int = 1,
+        processes: bool = True,
+        mp_context: str | None = None,
+    ):
+        if exchange_every < 1:
+            err = 'exchange_every must be at least 1.'
+            raise ValueError(err)
+        self.timestep = timestep
+        self.simtime = np.arange(0, endtime, timestep, dtype=float)
+        self.exchange_every = exchange_every
+        self.processes = processes
+        self.mp_context = mp_context
+        self.catchments: dict[str, np.ndarray] = {}
+        self.reaches: dict[str, SewerReach] = {}
+        self.plants: dict[str, _Plant] = {}
+        self.connections: list[_Connection] = []
+
+    def _check_name(self, name):
+        if name in self.catchments or name in self.reaches or name in self.plants:
+            err = f'Node {name} already exists in the network.'
+            raise ValueError(err)
+
+    def add_catchment(self, name: str, data_in: np.ndarray):
+        """Adds a catchment with influent data `data_in` (n, 22): time [d] and the 21 components."""
+        self._check_name(name)
+        self.catchments[name] = np.asarray(data_in, dtype=float)
+
+    def add_reach(self, name: str, travel_time: float, n_tanks: int = 1):
+        """Adds a sewer reach with the mean `travel_time` [d] modelled by `n_tanks` hydraulic delays."""
+        self._check_name(name)
+        self.reaches[name] = SewerReach(travel_time, n_tanks)
+
+    def add_plant(self, name: str, factory, outputs=('ys_eff',), record=None, y_init=None):
+        """Adds a plant.
+
+        Parameters
+        ----------
+        name : str
+            Name of the plant.
+        factory : Callable
+            Returns the plant for the keyword arguments `data_in` and `timestep`, e.g.
+            `functools.partial(BSM1OL, tempmodel=False)`. Must be picklable if `processes=True`.
+        outputs : tuple(str) (optional)
+            Attributes of the plant that can be connected to other nodes, the first one is the default. <br>
+            Default is ('ys_eff',).
+        record : list[str] (optional)
+            Quantities recorded by the plant (`*_all` arrays) that are returned by `run`.
+        y_init : np.ndarray(21) (optional)
+            Influent used for the initialisation of the plant. <br>
+            Default is the first row of the first catchment.
+        """
+        self._check_name(name)
+        self.plants[name] = _Plant(factory, tuple(outputs), record, y_init)
+
+    def connect(self, source: str, target: str, output: str | None = None, fraction: float = 1.0):
+        """Connects `source` to `target`.
+
+        Parameters
+        ----------
+        source : str
+            Catchment, reach or plant.
+        target : str
+            Reach or plant.
+        output : str (optional)
+            Output of a plant source. Default is the first output of the plant.
+        fraction : float (optional)
+            Fraction of the flow rate of `source` that is routed to `target`. <br>
+            Default is 1.
+        """
+        if target in self.catchments or (target not in self.reaches and target not in self.plants):
+            err = f'Target {target} must be a reach or a plant.'
+            raise ValueError(err)
+        if source not in self.catchments and source not in self.reaches and source not in self.plants:
+            err = f'Unknown source {source}.'
+            raise ValueError(err)
+        if source in self.plants:
+            output = self.plants[source].outputs[0] if output is None else output
+            if output not in self.plants[source].outputs:
+                err = f'{output} is not an output of plant {source}.'
+                raise ValueError(err)
+        self.connections.append(_Connection(source, target, output, fraction))
+
+    def _coordinator_order(self):
+        # plant outflows are delayed by the exchange, only the catchments and reaches need an order
+        local = list(self.catchments) + list(self.reaches)
+        edges = [
+            {'id': str(k), 'source_node_id': c.source, 'target_node_id': c.target}
+            for k, c in enumerate(self.connections)
+            if c.source not in self.plants and c.target not in self.plants
+        ]
+        plan = schedule({'nodes': [{'id': name} for name in local], 'edges': edges})
+        if any(stage['type'] == 'loop' for stage in plan['stages']):
+            err = 'Sewer reaches must not form a loop without a plant in between.'
+            raise ValueError(err)
+        return [stage['order'][0] for stage in plan['stages']]
+
+    def _start_plants(self, n_steps):
+        data_time = np.append(self.simtime[:n_steps], self.simtime[n_steps - 1] + np.array([1.0, 2.0]) * self.timestep)
+        first = next(iter(self.catchments.values()))[0, 1:] if self.catchments else np.zeros(21)
+        context = multiprocessing.get_context(self.mp_context) if self.processes else None
+        workers = {}
+        for name, plant in self.plants.items():
+            y_init = first if plant.y_init is None else np.asarray(plant.y_init, dtype=float)
+            data_in = np.column_stack([data_time, np.tile(y_init, (len(data_time), 1))])
+            args = (plant.factory, data_in, self.timestep, plant.outputs, plant.record)
+            workers[name] = _PlantProcess(context, *args) if self.processes else _PlantWorker(*args)
+        return workers
+
+    def run(self, n_steps: int | None = None):
+        """Simulates the network.
+
+        Parameters
+        ----------
+        n_steps : int (optional)
+            Number of time steps. <br>
+            Default is the number of time steps until `endtime`.
+
+        Returns
+        -------
+        results : dict
+            'simtime': np.ndarray(n_steps), the outflow of every catchment and reach as np.ndarray(n_steps, 21),
+            for every plant a dict with the outputs as np.ndarray(n_steps, 21), the influent 'y_in' and the
+            recorded quantities.
+        """
+
+        n_steps = len(self.simtime) if n_steps is None else n_steps
+        order = self._coordinator_order()
+        inflows = defaultdict(list)
+        for c in self.connections:
+            inflows[c.target].append(c)
+
+        combiner = Combiner()
+        streams = {name: np.zeros((n_steps, 21)) for name in order}
+        plant_in = {name: np.zeros((n_steps, 21)) for name in self.plants}
+        plant_out = {name: np.zeros((n_steps, len(p.outputs), 21)) for name, p in self.plants.items()}
+        workers = self._start_plants(n_steps)
+        initial = {name: worker.initial() for name, worker in workers.items()}
+        lag = self.exchange_every
+
+        def stream(c, i):
+            if c.source in self.plants:
+                k = self.plants[c.source].outputs.index(c.output)
+                y = (plant_out[c.source][i - lag] if i >= lag else initial[c.source])[k].copy()
+            else:
+                y = streams[c.source][i].copy()
+            y[Q] *= c.fraction
+            return y
+
+        def inflow(target, i):
+            ys = [stream(c, i) for c in inflows[target]]
+            if not ys:
+                err = f'{target} has no inflow.'
+                raise ValueError(err)
+            return ys[0] if len(ys) == 1 else combiner.output(*ys)
+
+        for start in range(0, n_steps, lag):
+            stop = min(start + lag, n_steps)
+            for i in range(start, stop):
+                for name in order:
+                    if name in self.catchments:
+                        data = self.catchments[name]
+                        row = max(int(np.searchsorted(data[:, 0], self.simtime[i], side='right')) - 1, 0)
+                        streams[name][i] = data[row, 1:]
+                    else:
+                        streams[name][i] = self.reaches[name].output(self.timestep, self.simtime[i], inflow(name, i))
+                for name in self.plants:
+                    plant_in[name][i] = inflow(name, i)
+            if self.processes:
+                for name, worker in workers.items():
+                    worker.start(start, plant_in[name][start:stop])
+                for name, worker in workers.items():
+                    plant_out[name][start:stop] = worker.result()
+            else:
+                for name, worker in workers.items():
+                    plant_out[name][start:stop] = worker.run(start, plant_in[name][start:stop])
+            logger.debug('Network simulated until t = %s d', self.simtime[stop - 1] + self.timestep)
+
+        results = {'simtime': self.simtime[:n_steps].copy()}
+        results.update(streams)
+        for name, plant in self.plants.items():
+            results[name] = {output: plant_out[name][:, k] for k, output in enumerate(plant.outputs)}
+            results[name]['y_in'] = plant_in[name]
+            results[name].update(workers[name].recorded(n_steps))
+        return results
@@ -0,0 +1,274 @@
+"""Streaming operational indicators of a plant over rolling time windows.
+
+Operators follow the plant with a few lumped indicators instead of full state trajectories:
+
+- `srt`: sludge retention time [d], sludge mass in the reactors and the settler over the sludge mass
+  leaving with the waste sludge and the effluent.
+- `hrt`: hydraulic retention time of the activated sludge reactors [d], based on the influent of the
+  activated sludge (without internal and external recycles).
+- `f_m`: food to microorganism ratio [kg COD ⋅ kg COD⁻¹ ⋅ d⁻¹], biodegradable COD load (SS + XS) of the
+  activated sludge influent over the particulate organic COD (XI + XS + XBH + XBA + XP) in the reactors.
+- `hrt_digester`: hydraulic retention time of the digester [d].
+- `vfa_alkalinity`: ratio of the volatile fatty acids as acetic acid over the bicarbonate alkalinity as
+  CaCO3 in the digester [kg HAc ⋅ kg CaCO3⁻¹] (FOS/TAC). Values above about 0.3 indicate an
+  acidifying digester.
+- `methane_yield`: methane production per COD fed to the digester [Nm³ CH4 ⋅ kg COD⁻¹]
+  (at most 0.35 Nm³ ⋅ kg COD⁻¹).
+
+The digester indicators are only available for plants with a digester (BSM2).
+
+`OperationalIndicators` is fed by the step loop (`BSMBase.advance(observer=...)` or `observe` after every
+`step`). Every step adds its time-weighted loads and masses to a `RollingWindow`, the indicators are ratios
+of the window sums, e.g. SRT = ∫ mass dt / ∫ outflow dt over the window. The memory does not grow with the
+simulation time: the window keeps at most `window / min(timesteps) + 1` steps and the history keeps at most
+`max_samples` samples, as do the alarms. Limits on the indicators raise alarms and can stop the simulation
+early.
+"""
+
+from collections import deque
+
+import numpy as np
+
+from bsm2_python.log import logger
+
+indices_components = np.arange(21)
+SI, SS, XI, XS, XBH, XBA, XP, SO, SNO, SNH, SND, XND, SALK, TSS, Q, TEMP, SD1, SD2, SD3, XD4, XD5 = indices_components
+
+# indices in the ADM1 output vector
+S_VA, S_BU, S_PRO, S_AC = 3, 4, 5, 6
+S_HCO3 = 39
+# COD of the acids [kg COD ⋅ kmol⁻¹]
+VFA_COD = np.array([208.0, 160.0, 112.0, 64.0])
+M_HAC = 60.0  # kg ⋅ kmol⁻¹
+M_CACO3_EQ = 50.0  # kg ⋅ kmol⁻¹ per equivalent
+RHO_CH4 = 0.7168  # density of methane at 0 °C and 1.013 bar [kg ⋅ Nm⁻³]
+
+ACTIVATED_SLUDGE_INDICATORS = ('srt', 'hrt', 'f_m')
+DIGESTER_INDICATORS = ('hrt_digester', 'vfa_alkalinity', 'methane_yield')
+
+
+class RollingWindow:
+    """Creates a RollingWindow object, time-weighted sums of per-step values over the last `window` days.
+
+    The newest steps are kept such that they cover at least `window` days, i.e. the covered duration is
+    between `window` and `window` plus one step. The steps are stored in a ring buffer.
+
+    Parameters
+    ----------
+    window : float
+        Length of the window [d].
+    n_values : int
+        Number of values per step.
+    min_timestep : float
+        Smallest time step pushed to the window [d], it determines the size of the ring buffer.
+    """
+
+    def __init__(self, window: float, n_values: int, min_timestep: float):
+        if window <= 0:
+            raise ValueError('The window must be positive.')
+        self.window = window
+        self.capacity = int(np.ceil(window / min_timestep - 1e-9)) + 1
+        self._dt = np.zeros(self.capacity)
+        self._values = np.zeros((self.capacity, n_values))
+        self._head = 0  # oldest step
+        self._size = 0
+        self._pushed = 0
+        self.duration = 0.0
+        self.sums = np.zeros(n_values)
+
+    def __len__(self):
+        return self._size
+
+    @property
+    def full(self):
+        """`True` if the steps cover the whole window."""
+        return self.duration >= self.window - 1e-9
+
+    def _pop(self):
+        self.duration -= self._dt[self._head]
+        self.sums -= self._values[self._head]
+        self._head = (self._head + 1) % self.capacity
+        self._size -= 1
+
+    def push(self, dt: float, values):
+        """Adds a step of length `dt` [d] with the (constant) `values` during the step."""
+        if self._size == self.capacity:
+            self._pop()
+        idx = (self._head + self._size) % self.capacity
+        self._dt[idx] = dt
+        self._values[idx] = dt * np.asarray(values, dtype=float)
+        self._size += 1
+        self.duration += dt
+        self.sums += self._values[idx]
+        while self._size > 1 and self.duration - self._dt[self._head] >= self.window - 1e-9:
+            self._pop()
+        self._pushed += 1
+        if self._pushed % self.capacity == 0:
+            # the running sums accumulate rounding errors, recompute them from the buffer now and then
+            idx = (self._head + np.arange(self._size)) % self.capacity
+            self.duration = float(np.sum(self._dt[idx]))
+            self.sums = np.sum(self._values[idx], axis=0)
+
+    def mean(self):
+        """Returns the time-weighted mean of the values over the window."""
+        return self.sums / self.duration if self.duration > 0 else np.full_like(self.sums, np.nan)
+
+
+class OperationalIndicators:
+    """Creates an OperationalIndicators object, rolling operational indicators of a BSM1 or BSM2 plant.
+
+    Parameters
+    ----------
+    model : BSM1Base | BSM2Base
+        Plant model.
+    window : float (optional)
+        Length of the rolling window [d]. <br>
+        Default is 1.
+    sample_time : float (optional)
+        Sample time of the history [d]. <br>
+        If not provided, no history is kept.
+    max_samples : int (optional)
+        Maximum number of samples in the history and of alarms in `alarms`, older ones are discarded. <br>
+        Default is 10000.
+    limits : dict{str: tuple[float | None, float | None]} (optional)
+        Lower and upper limits of indicators, e.g. {'vfa_alkalinity': (None, 0.3)}. Once the window is full,
+        every step with a value outside its limits adds an alarm to `alarms` and is counted in
+        `alarm_counts`, a warning is logged when the indicator leaves its limits. <br>
+        If not provided, no limits are checked.
+    stop_on_alarm : bool (optional)
+        If `True`, calling the object as observer of `BSMBase.advance` stops the simulation at the first
+        alarm. <br>
+        Default is False.
+
+    Examples
+    --------
+    >>> indicators = OperationalIndicators(bsm2_ol, window=1, limits={'vfa_alkalinity': (None, 0.3)})
+    >>> bsm2_ol.advance(1000, observer=indicators)
+    >>> indicators.values
+    """
+
+    def __init__(
+        self,
+        model,
+        window: float = 1.0,
+        sample_time: float | None = None,
+        max_samples: int = 10000,
+        limits: dict | None = None,
+        *,
+        stop_on_alarm: bool = False,
+    ):
+        self.model = model
+        self.reactors = [getattr(model, f'reactor{k}') for k in range(1, 6)]
+        self.volume_as = sum(reactor.volume for reactor in self.reactors)
+        self.volume_settler = float(model.settler.dim[0] * model.settler.dim[1])
+        self.digester = hasattr(model, 'adm1_reactor')
+        self.names = ACTIVATED_SLUDGE_INDICATORS + (DIGESTER_INDICATORS if self.digester else ())
+        self.limits = dict(limits or {})
+        unknown = set(self.limits) - set(self.names)
+        if unknown:
+            err = f'Unknown indicators: {", ".join(sorted(unknown))}. Available: {", ".join(self.names)}.'
+            raise ValueError(err)
+        self.stop_on_alarm = stop_on_alarm
+        self.window = RollingWindow(window, 10 if self.digester else 5, float(np.min(model.timesteps)))
+        self.sample_time = sample_time
+        self.history = deque(maxlen=max_samples)
+        # one entry per step and indicator out of limits, the newest `max_samples` are kept
+        self.alarms = deque(maxlen=max_samples)
+        self.alarm_counts = dict.fromkeys(self.limits, 0)
+        self.out_of_limits = set()
+        self.values = dict.fromkeys(self.names, np.nan)
+        self._last_sample = None
+
+    def _activated_sludge_influent(self, i):
+        # BSM2: primary effluent and bypasses entering the reactors, BSM1: plant influent
+        return self.model.to_as_all[i] if hasattr(self.model, 'to_as_all') else self.model.y_in_all[i]
+
+    def _step_values(self, i):
+        """Returns the loads and masses of step `i`, the integrands of the window sums."""
+        model = self.model
+        y_as = np.array([model.y_out1, model.y_out2, model.y_out3, model.y_out4, model.y_out5])
+        volumes = np.array([reactor.volume for reactor in self.reactors])
+        mass_tss = (volumes @ y_as[:, TSS] + np.mean(model.ys_tss_internal) * self.volume_settler) / 1000  # kg
+        effluent = model.ys_of if hasattr(model, 'ys_of') else model.ys_eff
+        outflow_tss = (model.ys_was[TSS] * model.ys_was[Q] + effluent[TSS] * effluent[Q]) / 1000  # kg/d
+        y_in = self._activated_sludge_influent(i)
+        food = (y_in[SS] + y_in[XS]) * y_in[Q] / 1000  # kg COD/d
+        mass_organic = volumes @ (y_as[:, XI] + y_as[:, XS] + y_as[:, XBH] + y_as[:, XBA] + y_as[:, XP]) / 1000
+        values = [mass_tss, outflow_tss, y_in[Q], food, mass_organic]
+        if self.digester:
+            yd_in, yd_out = model.yd_in, model.yd_out
+            vfa = M_HAC * np.sum(yd_out[[S_VA, S_BU, S_PRO, S_AC]] / VFA_COD)  # kg HAc/m³
+            alkalinity = M_CACO3_EQ * yd_out[S_HCO3]  # kg CaCO3/m³
+            if 'gas_production' in getattr(model, 'derived', ()):
+                ch4 = model.derived['gas_production'][0]
+            else:
+                ch4 = model.performance.gas_production(yd_out, yd_out[27] + 273.15)[0]
+            cod_in = (yd_in[SI] + yd_in[SS] + yd_in[XI] + yd_in[XS] + yd_in[XBH] + yd_in[XBA] + yd_in[XP]) * yd_in[Q]
+            values += [yd_in[Q], vfa, alkalinity, ch4, cod_in / 1000]
+        return values
+
+    def _indicators(self):
+        """Returns the indicators from the window sums."""
+        s = self.window.sums
+        duration = self.window.duration
+        with np.errstate(divide='ignore', invalid='ignore'):
+            values = {
+                'srt': s[0] / s[1],
+                'hrt': self.volume_as * duration / s[2],
+                'f_m': s[3] / s[4],
+            }
+            if self.digester:
+                values['hrt_digester'] = self.model.adm1_reactor.volume_liq * duration / s[5]
+                values['vfa_alkalinity'] = s[6] / s[7]
+                values['methane_yield'] = s[8] / RHO_CH4 / s[9]
+        return {name: float(value) for name, value in values.items()}
+
+    def observe(self, i: int):
+        """Adds the time step `i` (simulated last) to the window and updates the indicators.
+
+        Returns
+        -------
+        alarms : list[tuple[float, str, float]]
+            Alarms of this step as (time, indicator, value), one per indicator out of limits.
+        """
+
+        t = float(self.model.simtime[i])
+        self.window.push(float(self.model.timesteps[i]), self._step_values(i))
+        self.values = self._indicators()
+        if self.sample_time is not None and (
+            self._last_sample is None or t >= self._last_sample + self.sample_time - 1e-9
+        ):
+            self.history.append((t, *self.values.values()))
+            self._last_sample = t
+
+        new_alarms = []
+        if self.window.full:
+            for name, (lower, upper) in self.limits.items():
+                value = self.values[name]
+                if (lower is not None and value < lower) or (upper is not None and value > upper):
+                    new_alarms.append((t, name, value))
+                    self.alarm_counts[name] = self.alarm_counts.get(name, 0) + 1
+                    if name not in self.out_of_limits:
+                        logger.warning('Operational indicator %s = %.4g out of limits at t = %.4f d', name, value, t)
+                        self.out_of_limits.add(name)
+                elif name in self.out_of_limits:
+                    logger.info('Operational indicator %s = %.4g within limits again at t = %.4f d', name, value, t)
+                    self.out_of_limits.discard(name)
+        self.alarms.extend(new_alarms)
+        return new_alarms
+
+    def __call__(self, model, i: int):
+        """Observer of `BSMBase.advance`, returns `True` to stop the simulation at an alarm."""
+        return bool(self.observe(i)) and self.stop_on_alarm
+
+    def recorded(self):
+        """Returns the history as arrays.
+
+        Returns
+        -------
+        recorded : dict{str: np.ndarray}
+            'simtime' and the sampled indicators.
+        """
+
+        samples = np.array(self.history).reshape(-1, len(self.names) + 1)
+        return {'simtime': samples[:, 0], **{name: samples[:, k + 1] for k, name in enumerate(self.names)}}
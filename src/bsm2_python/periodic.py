@@ -0,0 +1,231 @@
+"""Periodic steady state of a plant under a cyclic influent.
+
+With a repeating influent pattern (e.g. the dry weather week of `dryinfluent.csv`) the plant settles into a
+periodic regime: the state x at the start of a period is a fixed point of the period map
+
+    x = Φ(x),
+
+Φ being the plant simulated over one period starting from x. Instead of simulating period after period
+until the plant has settled (the slowest modes, biomass and digester, need weeks), the fixed point is
+found with Anderson acceleration of the period map: every iteration simulates one period and combines the
+last `memory` iterates such that the linearised residual Φ(x) - x is minimised. For a linear period map
+this is equivalent to GMRES on (I - M) x = b with the monodromy matrix M, i.e. a Newton-Krylov shooting
+method whose Krylov directions come from the iterates themselves instead of extra period simulations for
+Jacobian-vector products.
+
+The state x consists of the integration states of the units and the signals a step passes to the next
+one (recycles, digester pH of the ASM2ADM interface), see `plant_states`. States of controllers
+(integrators, delays of sensors and actuators) can be added as further attribute paths.
+"""
+
+import operator
+from dataclasses import dataclass
+
+import numpy as np
+
+from bsm2_python.continuation import damped_update
+from bsm2_python.log import logger
+
+# integration states of the units
+UNIT_STATES = ('y0', 'ys0', 'yp0', 'yd0', 'yst0')
+# signals computed in a time step and used in the next one
+CARRIED_SIGNALS = ('ys_out', 'ys_r', 'y_out5_r', 'yst_sp_p', 'yst_sp_as', 'yt_sp_p', 'yt_sp_as')
+
+
+def plant_states(model):
+    """Returns the attribute paths of the states of a plant that are carried from one time step to the next.
+
+    Parameters
+    ----------
+    model : BSM1Base | BSM2Base
+        Plant model.
+
+    Returns
+    -------
+    states : list[str]
+        Attribute paths, e.g. ['reactor1.y0', ..., 'settler.ys0', 'ys_out', 'y_out5_r'].
+    """
+
+    states = []
+    for name, unit in vars(model).items():
+        for state in UNIT_STATES:
+            if isinstance(getattr(unit, state, None), np.ndarray):
+                states.append(f'{name}.{state}')
+    if hasattr(model, 'adm1_reactor'):
+        # the ASM2ADM interface uses the digester pH of the previous step
+        states.append('adm1_reactor.y_in1')
+    states.extend(name for name in CARRIED_SIGNALS if isinstance(getattr(model, name, None), np.ndarray))
+    return states
+
+
+@dataclass
+class PeriodicResult:
+    """Result of the periodic steady-state solver.
+
+    state : np.ndarray(n)
+        State at the start of the period of the periodic steady state (see `PeriodicSteadyState.states`).
+    residuals : np.ndarray(k)
+        Scaled residual max|Φ(x) - x| / (|x₀| + 1) of every simulated period after the warm-up, x₀ being the
+        state after the warm-up.
+    converged : bool
+        `True` if the last residual is below the tolerance.
+    n_periods : int
+        Number of simulated periods including the warm-up.
+    """
+
+    state: np.ndarray
+    residuals: np.ndarray
+    converged: bool
+    n_periods: int
+
+
+class PeriodicSteadyState:
+    """Creates a PeriodicSteadyState object.
+
+    Parameters
+    ----------
+    model : BSMBase
+        Plant model. Its current state is the initial guess.
+    period : float
+        Period of the influent [d], e.g. 7 for the dry weather week.
+    start : float (optional)
+        Start of the simulated period [d]. The influent between `start` and `start + period` is
+        used for every period. <br>
+        Default is 0.
+    states : list[str] (optional)
+        Attribute paths of the states of the period map. <br>
+        Default is `plant_states(model)`.
+    memory : int (optional)
+        Number of previous iterates combined by the Anderson acceleration. 0 simulates period after
+        period. <br>
+        Default is 6.
+    tol : float (optional)
+        Tolerance of the scaled residual max|Φ(x) - x| / (|x₀| + 1), x₀ being the state after the warm-up. <br>
+        Default is 1e-6.
+    max_periods : int (optional)
+        Maximum number of simulated periods. <br>
+        Default is 50.
+
+    Examples
+    --------
+    >>> bsm1_ol = BSM1OL(data_in='dryinfluent.csv', timestep=15 / 24 / 60)
+    >>> result = PeriodicSteadyState(bsm1_ol, period=7).solve()
+    >>> bsm1_ol.advance(672)  # one period of the periodic regime
+    """
+
+    def __init__(
+        self,
+        model,
+        period: float,
+        start: float = 0.0,
+        states: list[str] | None = None,
+        *,
+        memory: int = 6,
+        tol: float = 1e-6,
+        max_periods: int = 50,
+    ):
+        self.model = model
+        self.start = int(np.searchsorted(model.simtime, start - 1e-9))
+        self.stop = int(np.searchsorted(model.simtime, start + period - 1e-9))
+        if model.simtime[-1] < start + period - 1e-9:
+            err = f'The simulation time of the plant ends before the end of the period at {start + period} d.'
+            raise ValueError(err)
+        self.states = plant_states(model) if states is None else list(states)
+        self._getters = [operator.attrgetter(path) for path in self.states]
+        self.memory = memory
+        self.tol = tol
+        self.max_periods = max_periods
+        self.n_periods = 0
+
+    def state(self):
+        """Returns the current state of the plant as vector."""
+        return np.concatenate([np.asarray(get(self.model), dtype=float).ravel() for get in self._getters])
+
+    def set_state(self, x):
+        """Sets the state of the plant to the vector `x`."""
+        i = 0
+        for path, get in zip(self.states, self._getters, strict=True):
+            value = np.asarray(get(self.model))
+            owner, _, name = path.rpartition('.')
+            obj = operator.attrgetter(owner)(self.model) if owner else self.model
+            setattr(obj, name, x[i : i + value.size].reshape(value.shape).astype(value.dtype))
+            i += value.size
+
+    def period_map(self, x):
+        """Simulates one period starting from state `x` and returns the state at its end.
+
+        The steps of the period are recorded in the `<name>_all` arrays of the plant.
+        """
+        self.set_state(x)
+        for i in range(self.start, self.stop):
+            self.model.step(i)
+        self.n_periods += 1
+        return self.state()
+
+    def solve(self, warmup: int = 1):
+        """Finds the periodic steady state.
+
+        Parameters
+        ----------
+        warmup : int (optional)
+            Number of periods simulated before the acceleration starts, they remove the initial transient
+            of fast states and of recycle signals that are not initialised. <br>
+            Default is 1.
+
+        Returns
+        -------
+        result : PeriodicResult
+            Periodic steady state. The plant is set to this state and `next_step` to the start of the
+            period, `advance` then simulates the periodic regime.
+        """
+
+        self.n_periods = 0
+        x = self.state()
+        for _ in range(warmup):
+            x = self.period_map(x)
+
+        # the residuals are scaled with the state after the warm-up
+        scale = np.abs(x) + 1.0
+        iterates, residuals, history = [], [], []
+        best = (np.inf, x)
+        previous = None  # residual and image of the previous iterate
+        accelerated = False
+        while self.n_periods < self.max_periods:
+            fx = self.period_map(x)
+            g = (fx - x) / scale
+            residual = float(np.max(np.abs(g)))
+            history.append(residual)
+            logger.debug('Period %s: residual %.3e', self.n_periods, residual)
+            if residual < best[0]:
+                best = (residual, x)
+            if residual < self.tol:
+                break
+            if accelerated and residual > 4.0 * previous[0]:
+                # far from the periodic regime the extrapolation can overshoot, continue with a plain period
+                # from the previous iterate and restart the acceleration
+                logger.debug('Anderson acceleration restarted after period %s', self.n_periods)
+                iterates, residuals = [], []
+                x, accelerated = previous[1], False
+                continue
+            previous = (residual, fx)
+            iterates.append(x / scale)
+            residuals.append(g)
+            iterates, residuals = iterates[-self.memory - 1 :], residuals[-self.memory - 1 :]
+            x_new = x / scale + g
+            if len(iterates) > 1:
+                d_x = np.diff(iterates, axis=0).T
+                d_g = np.diff(residuals, axis=0).T
+                gamma = np.linalg.lstsq(d_g, g, rcond=None)[0]
+                x_new -= (d_x + d_g) @ gamma
+            accelerated = len(iterates) > 1
+            x, _ = damped_update(x, x - x_new * scale)
+
+        converged = history[-1] < self.tol if history else False
+        state = x if converged else best[1]
+        if converged:
+            logger.info('Periodic steady state found after %s periods', self.n_periods)
+        else:
+            logger.warning('Periodic steady state not found after %s periods, residual %.3e', self.n_periods, best[0])
+        self.set_state(state)
+        self.model.next_step = self.start
+        return PeriodicResult(state, np.array(history), converged, self.n_periods)
@@ -0,0 +1,404 @@
+"""Process rates of the ASM1 reactors and the ADM1 digester over recorded trajectories.
+
+The rates are evaluated from the recorded reactor concentrations (`y_out1_all` ... `y_out5_all`,
+`yd_out_all`) with the kinetics of `asm1equations` and `adm1equations`, for all time steps in one
+compiled pass:
+
+- `asm1_process_rates`: the eight ASM1 processes (aerobic and anoxic growth of heterotrophs, aerobic
+  growth of autotrophs, decay, ammonification, hydrolysis of organics and organic nitrogen),
+- `asm1_oxygen_transfer`: oxygen transfer rate of the aeration with the recorded KLa values,
+- `adm1_process_rates`: the 19 biochemical processes and the 3 gas transfer rates of ADM1.
+
+`activated_sludge_rates` and `digester_rates` return the rates of a simulated plant together with the
+oxygen uptake, nitrification and denitrification rates per tank.
+"""
+
+import math
+
+import numpy as np
+from numba import jit
+
+from bsm2_python.bsm2.adm1_bsm2 import (
+    S_AA,
+    S_AC,
+    S_BU,
+    S_CH4,
+    S_FA,
+    S_GAS_CH4,
+    S_GAS_CO2,
+    S_GAS_H2,
+    S_H2,
+    S_HCO3,
+    S_IC,
+    S_IN,
+    S_NH3,
+    S_PRO,
+    S_SU,
+    S_VA,
+    X_AA,
+    X_AC,
+    X_C4,
+    X_CH,
+    X_FA,
+    X_H2,
+    X_LI,
+    X_PR,
+    X_PRO,
+    X_SU,
+    X_XC,
+    hydrogen_ion,
+)
+
+indices_components = np.arange(21)
+SI, SS, XI, XS, XBH, XBA, XP, SO, SNO, SNH, SND, XND, SALK, TSS, Q, TEMP, SD1, SD2, SD3, XD4, XD5 = indices_components
+
+ASM1_PROCESSES = (
+    'aerobic_growth_heterotrophs',
+    'anoxic_growth_heterotrophs',
+    'aerobic_growth_autotrophs',
+    'decay_heterotrophs',
+    'decay_autotrophs',
+    'ammonification',
+    'hydrolysis_organics',
+    'hydrolysis_organic_nitrogen',
+)
+"""Names of the ASM1 process rates [g(COD) ⋅ m⁻³ ⋅ d⁻¹, g(N) ⋅ m⁻³ ⋅ d⁻¹ for the nitrogen processes]."""
+
+ADM1_PROCESSES = (
+    'disintegration',
+    'hydrolysis_carbohydrates',
+    'hydrolysis_proteins',
+    'hydrolysis_lipids',
+    'uptake_sugars',
+    'uptake_amino_acids',
+    'uptake_lcfa',
+    'uptake_valerate',
+    'uptake_butyrate',
+    'uptake_propionate',
+    'uptake_acetate',
+    'uptake_hydrogen',
+    'decay_x_su',
+    'decay_x_aa',
+    'decay_x_fa',
+    'decay_x_c4',
+    'decay_x_pro',
+    'decay_x_ac',
+    'decay_x_h2',
+    'transfer_h2',
+    'transfer_ch4',
+    'transfer_co2',
+)
+"""Names of the ADM1 process rates [kg(COD) ⋅ m⁻³ ⋅ d⁻¹, kmol(C) ⋅ m⁻³ ⋅ d⁻¹ for the CO2 transfer]."""
+
+# positions of the ADM1 states in the digester output `yd_out`
+_YD_OUT_STATES = np.concatenate((np.arange(26), [35, 36, 37, 38, 39, 41, 43, 44, 45]))
+
+
+@jit(nopython=True, cache=True)
+def _arrhenius(value, reference, temp):
+    # temperature compensation of the BSM kinetic parameters
+    return value * np.exp((np.log(value / reference) / 5.0) * (temp - 15.0))
+
+
+@jit(nopython=True, cache=True)
+def asm1_process_rates(y, asm1par):
+    """Returns the ASM1 process rates for every row of a recorded reactor trajectory.
+
+    Parameters
+    ----------
+    y : np.ndarray(n, 21)
+        Reactor concentrations, e.g. `y_out1_all`. The recorded temperature (the influent temperature
+        without temperature model) is used for the temperature compensation as in `asm1equations`. \n
+        [SI, SS, XI, XS, XBH, XBA, XP, SO, SNO, SNH, SND, XND, SALK, TSS, Q, TEMP,
+        SD1, SD2, SD3, XD4, XD5]
+    asm1par : np.ndarray(24)
+        ASM1 parameters of the reactor.
+
+    Returns
+    -------
+    rates : np.ndarray(n, 8)
+        Process rates, see `ASM1_PROCESSES`.
+    """
+
+    mu_h0, k_s, k_oh, k_no, b_h0, mu_a0, k_nh, k_oa, b_a0, ny_g, k_a0, k_h0, k_x, ny_h = asm1par[:14]
+    rates = np.zeros((y.shape[0], 8))
+    for i in range(y.shape[0]):
+        yi = np.maximum(y[i], 0.0)
+        temp = y[i, TEMP]
+        mu_h = _arrhenius(mu_h0, 3.0, temp)
+        b_h = _arrhenius(b_h0, 0.2, temp)
+        mu_a = _arrhenius(mu_a0, 0.3, temp)
+        b_a = _arrhenius(b_a0, 0.03, temp)
+        k_h = _arrhenius(k_h0, 2.5, temp)
+        k_a = _arrhenius(k_a0, 0.04, temp)
+
+        monod_ss = yi[SS] / (k_s + yi[SS])
+        switch_oh = yi[SO] / (k_oh + yi[SO])
+        inhib_oh = k_oh / (k_oh + yi[SO])
+        monod_sno = yi[SNO] / (k_no + yi[SNO])
+        rates[i, 0] = mu_h * monod_ss * switch_oh * yi[XBH]
+        rates[i, 1] = mu_h * monod_ss * inhib_oh * monod_sno * ny_g * yi[XBH]
+        rates[i, 2] = mu_a * (yi[SNH] / (k_nh + yi[SNH])) * (yi[SO] / (k_oa + yi[SO])) * yi[XBA]
+        rates[i, 3] = b_h * yi[XBH]
+        rates[i, 4] = b_a * yi[XBA]
+        rates[i, 5] = k_a * yi[SND] * yi[XBH]
+        if yi[XBH] > 0.0:
+            ratio = yi[XS] / yi[XBH]
+            rates[i, 6] = k_h * (ratio / (k_x + ratio)) * (switch_oh + ny_h * inhib_oh * monod_sno) * yi[XBH]
+        if yi[XS] > 0.0:
+            rates[i, 7] = rates[i, 6] * (yi[XND] / yi[XS])
+    return rates
+
+
+def asm1_stoichiometry(asm1par):
+    """Returns the stoichiometric matrix of ASM1.
+
+    Parameters
+    ----------
+    asm1par : np.ndarray(24)
+        ASM1 parameters.
+
+    Returns
+    -------
+    stoichiometry : np.ndarray(8, 21)
+        Conversion of every component per unit of process rate, `rates @ stoichiometry` are the
+        conversion rates of the 21 components as in `asm1equations`.
+    """
+
+    y_h, y_a, f_p, i_xb, i_xp = asm1par[14:19]
+    s = np.zeros((8, 21))
+    s[0, [SS, XBH, SO, SNH, SALK]] = [-1.0 / y_h, 1.0, -(1.0 - y_h) / y_h, -i_xb, -i_xb / 14.0]
+    s[1, [SS, XBH, SNO, SNH, SALK]] = [
+        -1.0 / y_h,
+        1.0,
+        -(1.0 - y_h) / (2.86 * y_h),
+        -i_xb,
+        (1.0 - y_h) / (14.0 * 2.86 * y_h) - i_xb / 14.0,
+    ]
+    s[2, [XBA, SO, SNO, SNH, SALK]] = [
+        1.0,
+        -(4.57 - y_a) / y_a,
+        1.0 / y_a,
+        -(i_xb + 1.0 / y_a),
+        -(i_xb / 14.0 + 1.0 / (7.0 * y_a)),
+    ]
+    s[3, [XS, XBH, XP, XND]] = [1.0 - f_p, -1.0, f_p, i_xb - f_p * i_xp]
+    s[4, [XS, XBA, XP, XND]] = [1.0 - f_p, -1.0, f_p, i_xb - f_p * i_xp]
+    s[5, [SNH, SND, SALK]] = [1.0, -1.0, 1.0 / 14.0]
+    s[6, [SS, XS]] = [1.0, -1.0]
+    s[7, [SND, XND]] = [1.0, -1.0]
+    return s
+
+
+@jit(nopython=True, cache=True)
+def asm1_oxygen_transfer(y, kla):
+    """Returns the oxygen transfer rate of the aeration for every row of a recorded reactor trajectory.
+
+    Parameters
+    ----------
+    y : np.ndarray(n, 21)
+        Reactor concentrations.
+    kla : np.ndarray(n)
+        Oxygen transfer coefficients [d⁻¹]. Negative values (fixed oxygen concentration) give NaN.
+
+    Returns
+    -------
+    otr : np.ndarray(n)
+        Oxygen transfer rate [g(O₂) ⋅ m⁻³ ⋅ d⁻¹].
+    """
+
+    otr = np.zeros(y.shape[0])
+    for i in range(y.shape[0]):
+        if kla[i] < 0.0:
+            otr[i] = np.nan
+            continue
+        t_k = (y[i, TEMP] + 273.15) / 100.0
+        so_sat = 0.9997743214 * 8.0 / 10.5 * (56.12 * 6791.5 * np.exp(-66.7354 + 87.4755 / t_k + 24.4526 * np.log(t_k)))
+        otr[i] = kla[i] * np.power(1.024, y[i, TEMP] - 15.0) * (so_sat - max(y[i, SO], 0.0))
+    return otr
+
+
+def digester_states(yd_out):
+    """Returns the 42 ADM1 states from recorded digester outputs.
+
+    Parameters
+    ----------
+    yd_out : np.ndarray(n, 51)
+        Digester outputs, e.g. `yd_out_all`.
+
+    Returns
+    -------
+    yd : np.ndarray(n, 42)
+        Digester states as in `ADM1Reactor.yd0`, flow rate, temperature and dummy states are zero.
+    """
+
+    yd_out = np.atleast_2d(yd_out)
+    yd = np.zeros((yd_out.shape[0], 42))
+    yd[:, :35] = yd_out[:, _YD_OUT_STATES]
+    return yd
+
+
+@jit(nopython=True, cache=True)
+def adm1_process_rates(yd, digesterpar, t_op):
+    """Returns the ADM1 process rates for every row of a digester trajectory.
+
+    Parameters
+    ----------
+    yd : np.ndarray(n, 42)
+        Digester states, see `digester_states`.
+    digesterpar : np.ndarray(100)
+        Digester parameters.
+    t_op : np.ndarray(n)
+        Operational temperature of the digester [K].
+
+    Returns
+    -------
+    rates : np.ndarray(n, 22)
+        Process rates, see `ADM1_PROCESSES`.
+    """
+
+    k_dis, k_hyd_ch, k_hyd_pr, k_hyd_li, k_s_in, k_m_su, k_s_su = digesterpar[41:48]
+    ph_ul_aa, ph_ll_aa, k_m_aa, k_s_aa = digesterpar[48:52]
+    k_m_fa, k_s_fa, k_ih2_fa, k_m_c4, k_s_c4, k_ih2_c4, k_m_pro, k_s_pro, k_ih2_pro = digesterpar[52:61]
+    k_m_ac, k_s_ac, k_i_nh3, ph_ul_ac, ph_ll_ac, k_m_h2, k_s_h2, ph_ul_h2, ph_ll_h2 = digesterpar[61:70]
+    k_dec = digesterpar[70:77]
+    r, t_base = digesterpar[77], digesterpar[78]
+    pk_w_base = digesterpar[80]
+    kla = digesterpar[94]
+    k_h_h2o_base, k_h_co2_base, k_h_ch4_base, k_h_h2_base = digesterpar[95:99]
+
+    eps = 1.0e-6
+    # Hill functions on SH+ used within BSM2
+    phlim_aa = 10 ** (-(ph_ul_aa + ph_ll_aa) / 2.0)
+    phlim_ac = 10 ** (-(ph_ul_ac + ph_ll_ac) / 2.0)
+    phlim_h2 = 10 ** (-(ph_ul_h2 + ph_ll_h2) / 2.0)
+    n_aa = 3.0 / (ph_ul_aa - ph_ll_aa)
+    n_ac = 3.0 / (ph_ul_ac - ph_ll_ac)
+    n_h2 = 3.0 / (ph_ul_h2 - ph_ll_h2)
+
+    rates = np.zeros((yd.shape[0], 22))
+    for i in range(yd.shape[0]):
+        x = np.maximum(yd[i], 0.0)
+        factor = (1.0 / t_base - 1.0 / t_op[i]) / (100.0 * r)
+        k_w = 10**-pk_w_base * math.exp(55900.0 * factor)
+        k_h_h2 = k_h_h2_base * math.exp(-4180.0 * factor)
+        k_h_ch4 = k_h_ch4_base * math.exp(-14240.0 * factor)
+        k_h_co2 = k_h_co2_base * math.exp(-19410.0 * factor)
+        s_h_ion = hydrogen_ion(x, k_w)
+
+        i_ph_aa = phlim_aa**n_aa / (s_h_ion**n_aa + phlim_aa**n_aa)
+        i_ph_ac = phlim_ac**n_ac / (s_h_ion**n_ac + phlim_ac**n_ac)
+        i_ph_h2 = phlim_h2**n_h2 / (s_h_ion**n_h2 + phlim_h2**n_h2)
+        # 1 / (1 + K_S_IN / S_IN), written without the division by S_IN
+        i_in_lim = x[S_IN] / (x[S_IN] + k_s_in)
+        inhib_aa = i_ph_aa * i_in_lim
+        inhib_fa = inhib_aa / (1.0 + x[S_H2] / k_ih2_fa)
+        inhib_c4 = inhib_aa / (1.0 + x[S_H2] / k_ih2_c4)
+        inhib_pro = inhib_aa / (1.0 + x[S_H2] / k_ih2_pro)
+        inhib_ac = i_ph_ac * i_in_lim / (1.0 + x[S_NH3] / k_i_nh3)
+        inhib_h2 = i_ph_h2 * i_in_lim
+
+        rates[i, 0] = k_dis * x[X_XC]
+        rates[i, 1] = k_hyd_ch * x[X_CH]
+        rates[i, 2] = k_hyd_pr * x[X_PR]
+        rates[i, 3] = k_hyd_li * x[X_LI]
+        rates[i, 4] = k_m_su * x[S_SU] / (k_s_su + x[S_SU]) * x[X_SU] * inhib_aa
+        rates[i, 5] = k_m_aa * x[S_AA] / (k_s_aa + x[S_AA]) * x[X_AA] * inhib_aa
+        rates[i, 6] = k_m_fa * x[S_FA] / (k_s_fa + x[S_FA]) * x[X_FA] * inhib_fa
+        c4 = x[S_VA] + x[S_BU] + eps
+        rates[i, 7] = k_m_c4 * x[S_VA] / (k_s_c4 + x[S_VA]) * x[X_C4] * x[S_VA] / c4 * inhib_c4
+        rates[i, 8] = k_m_c4 * x[S_BU] / (k_s_c4 + x[S_BU]) * x[X_C4] * x[S_BU] / c4 * inhib_c4
+        rates[i, 9] = k_m_pro * x[S_PRO] / (k_s_pro + x[S_PRO]) * x[X_PRO] * inhib_pro
+        rates[i, 10] = k_m_ac * x[S_AC] / (k_s_ac + x[S_AC]) * x[X_AC] * inhib_ac
+        rates[i, 11] = k_m_h2 * x[S_H2] / (k_s_h2 + x[S_H2]) * x[X_H2] * inhib_h2
+        rates[i, 12] = k_dec[0] * x[X_SU]
+        rates[i, 13] = k_dec[1] * x[X_AA]
+        rates[i, 14] = k_dec[2] * x[X_FA]
+        rates[i, 15] = k_dec[3] * x[X_C4]
+        rates[i, 16] = k_dec[4] * x[X_PRO]
+        rates[i, 17] = k_dec[5] * x[X_AC]
+        rates[i, 18] = k_dec[6] * x[X_H2]
+
+        p_gas_h2 = x[S_GAS_H2] * r * t_op[i] / 16.0
+        p_gas_ch4 = x[S_GAS_CH4] * r * t_op[i] / 64.0
+        p_gas_co2 = x[S_GAS_CO2] * r * t_op[i]
+        rates[i, 19] = kla * (x[S_H2] - 16.0 * k_h_h2 * p_gas_h2)
+        rates[i, 20] = kla * (x[S_CH4] - 64.0 * k_h_ch4 * p_gas_ch4)
+        rates[i, 21] = kla * ((x[S_IC] - x[S_HCO3]) - k_h_co2 * p_gas_co2)
+    return rates
+
+
+def activated_sludge_rates(model, klas=None, start: int = 0, stop: int | None = None):
+    """Returns the process rates of the activated sludge reactors of a simulated plant.
+
+    Parameters
+    ----------
+    model : BSM1Base | BSM2Base
+        Simulated plant with `reactor1` ... `reactor5` and the recorded `y_out1_all` ... `y_out5_all`.
+    klas : np.ndarray(n, 5) (optional)
+        KLa values of the time steps [d⁻¹]. <br>
+        Default is `klas_all` if the plant records it, otherwise the current KLa values of the reactors.
+    start, stop : int (optional)
+        Range of the evaluated time steps. <br>
+        Default is all time steps.
+
+    Returns
+    -------
+    rates : dict{str: dict{str: np.ndarray}}
+        For every reactor ('reactor1' ... 'reactor5'): \n
+        - 'process': process rates (n, 8), see `ASM1_PROCESSES`, \n
+        - 'conversion': conversion rates of the 21 components (n, 21) [g ⋅ m⁻³ ⋅ d⁻¹], \n
+        - 'our': oxygen uptake rate [g(O₂) ⋅ m⁻³ ⋅ d⁻¹], \n
+        - 'otr': oxygen transfer rate [g(O₂) ⋅ m⁻³ ⋅ d⁻¹], \n
+        - 'nitrification': nitrate production by autotrophs [g(N) ⋅ m⁻³ ⋅ d⁻¹], \n
+        - 'denitrification': nitrate reduction by heterotrophs [g(N) ⋅ m⁻³ ⋅ d⁻¹].
+    """
+
+    stop = len(model.simtime) if stop is None else stop
+    if klas is None:
+        if hasattr(model, 'klas_all'):
+            klas = model.klas_all[start:stop]
+        else:
+            klas = np.tile([float(getattr(model, f'reactor{k}').kla) for k in range(1, 6)], (stop - start, 1))
+    klas = np.asarray(klas, dtype=float)
+
+    rates = {}
+    for k in range(1, 6):
+        reactor = getattr(model, f'reactor{k}')
+        asm1par = np.asarray(reactor.asm1par, dtype=float)
+        y = np.ascontiguousarray(getattr(model, f'y_out{k}_all')[start:stop], dtype=float)
+        process = asm1_process_rates(y, asm1par)
+        stoichiometry = asm1_stoichiometry(asm1par)
+        y_h, y_a = asm1par[14], asm1par[15]
+        rates[f'reactor{k}'] = {
+            'process': process,
+            'conversion': process @ stoichiometry,
+            'our': -(process @ stoichiometry[:, SO]),
+            'otr': asm1_oxygen_transfer(y, np.ascontiguousarray(klas[:, k - 1])),
+            'nitrification': process[:, 2] / y_a,
+            'denitrification': process[:, 1] * (1.0 - y_h) / (2.86 * y_h),
+        }
+    return rates
+
+
+def digester_rates(model, start: int = 0, stop: int | None = None):
+    """Returns the process rates of the anaerobic digester of a simulated plant.
+
+    Parameters
+    ----------
+    model : BSM2Base
+        Simulated plant with `adm1_reactor` and the recorded `yd_out_all`.
+    start, stop : int (optional)
+        Range of the evaluated time steps. <br>
+        Default is all time steps.
+
+    Returns
+    -------
+    rates : np.ndarray(n, 22)
+        Process rates, see `ADM1_PROCESSES`.
+    """
+
+    yd_out = model.yd_out_all[start:stop]
+    return adm1_process_rates(
+        digester_states(yd_out), np.asarray(model.adm1_reactor.digesterpar, dtype=float), yd_out[:, 27] + 273.15
+    )
@@ -0,0 +1,201 @@
+"""Simulation of scenario sets as a tree of shared simulation segments.
+
+Scenarios of a what-if study often differ only after a branching time (a controller change, a storm in the
+influent). Every scenario is described as a list of `Change`s of a common base plant. Scenarios with the
+same changes up to a time share the simulation until then: `ScenarioTree` arranges the changes in a prefix
+tree, simulates every segment once, snapshots the plant at the branching points and continues every branch
+from the snapshot. The cost is the sum of the distinct segments instead of the sum of the scenario lengths.
+
+Two changes are identical if they take effect at the same time step and have the same `key` (by default
+the `apply` callable itself, so reusing the same function object is enough).
+"""
+
+import copy
+from collections.abc import Callable, Hashable
+from dataclasses import dataclass, field
+
+import numpy as np
+from numba.experimental.jitclass._box import Box
+
+from bsm2_python.log import logger
+
+
+def _jitclass_instances(obj, found, seen):
+    # jitclass units cannot be copied, their fields are saved instead
+    if id(obj) in seen or isinstance(obj, np.ndarray | str | bytes | int | float | type):
+        return
+    seen.add(id(obj))
+    if isinstance(obj, Box):
+        found[id(obj)] = obj
+        for name in obj._numba_type_.class_type.struct:
+            _jitclass_instances(getattr(obj, name), found, seen)
+    elif isinstance(obj, dict):
+        for value in obj.values():
+            _jitclass_instances(value, found, seen)
+    elif isinstance(obj, list | tuple | set):
+        for value in obj:
+            _jitclass_instances(value, found, seen)
+    elif hasattr(obj, '__dict__'):
+        _jitclass_instances(vars(obj), found, seen)
+
+
+def _copy_field(value):
+    if isinstance(value, Box):
+        return value
+    if hasattr(value, 'copy'):
+        return value.copy()
+    return value
+
+
+class ModelSnapshot:
+    """Creates a ModelSnapshot object, a copy of the complete state of a plant.
+
+    Python attributes are copied, jitclass units are kept and their fields are saved, so that a restored
+    plant continues exactly like the plant at the time of the snapshot. The snapshot can be restored
+    several times.
+
+    Parameters
+    ----------
+    model : BSMBase
+        Plant to be copied.
+    """
+
+    def __init__(self, model):
+        self._jitclasses = {}
+        _jitclass_instances(model, self._jitclasses, set())
+        self._fields = {
+            key: {name: _copy_field(getattr(obj, name)) for name in obj._numba_type_.class_type.struct}
+            for key, obj in self._jitclasses.items()
+        }
+        self._state = copy.deepcopy(vars(model), dict(self._jitclasses))
+
+    def restore(self, model):
+        """Resets `model` to the state of the snapshot.
+
+        The attributes of `model` are replaced by copies, references to its units held elsewhere
+        are not updated.
+        """
+        model.__dict__.clear()
+        model.__dict__.update(copy.deepcopy(self._state, dict(self._jitclasses)))
+        for key, obj in self._jitclasses.items():
+            for name, value in self._fields[key].items():
+                setattr(obj, name, _copy_field(value))
+
+
+@dataclass
+class Change:
+    """A change of the plant at time `time` [d].
+
+    apply : Callable[[BSMBase], dict | None]
+        Changes the plant before the first step starting at or after `time`, e.g. scales the influent
+        of the following days or changes controller parameters. A returned dict is passed as keyword
+        arguments to `step` from then on (updated by later changes).
+    key : Hashable (optional)
+        Identity of the change for the detection of shared prefixes. <br>
+        Default is `apply`.
+    """
+
+    time: float
+    apply: Callable
+    key: Hashable = None
+
+
+@dataclass
+class _Node:
+    step: int
+    change: Change | None
+    children: dict = field(default_factory=dict)
+    scenarios: list = field(default_factory=list)
+
+
+class ScenarioTree:
+    """Creates a ScenarioTree object.
+
+    Parameters
+    ----------
+    factory : Callable[[], BSMBase]
+        Returns the base plant of all scenarios.
+    scenarios : dict{str: list[Change]}
+        Changes of every scenario.
+    record : list[str] (optional)
+        Names of the recorded quantities, e.g. ['y_eff'] for `y_eff_all`. <br>
+        If not provided, all arrays recorded per time step are returned.
+    endtime : float (optional)
+        End of the simulation [d]. <br>
+        Default is the end of `simtime` of the plant.
+    """
+
+    def __init__(self, factory, scenarios, record=None, endtime=None):
+        self.factory = factory
+        self.scenarios = scenarios
+        self.record = record
+        self.endtime = endtime
+        self.simulated_steps = 0
+        self.snapshots = 0
+
+    def _build(self, simtime):
+        root = _Node(0, None)
+        for name, changes in self.scenarios.items():
+            node = root
+            for change in sorted(changes, key=lambda c: c.time):
+                step = int(np.searchsorted(simtime, change.time - 1e-9, side='left'))
+                key = (step, change.apply if change.key is None else change.key)
+                if key not in node.children:
+                    node.children[key] = _Node(step, change)
+                node = node.children[key]
+            node.scenarios.append(name)
+        return root
+
+    def run(self):
+        """Simulates all scenarios.
+
+        Returns
+        -------
+        results : dict{str: dict{str: np.ndarray}}
+            'simtime' and the recorded quantities of every scenario.
+        """
+
+        model = self.factory()
+        n_steps = len(model.simtime)
+        if self.endtime is not None:
+            n_steps = int(np.searchsorted(model.simtime, self.endtime, side='left'))
+        root = self._build(model.simtime[:n_steps])
+        self.simulated_steps = 0
+        self.snapshots = 0
+        results = {}
+        self._visit(model, root, {}, n_steps, results)
+        naive = n_steps * len(self.scenarios)
+        logger.info(
+            'Scenario tree: %s scenarios, %s of %s steps simulated, %s snapshots',
+            len(self.scenarios),
+            self.simulated_steps,
+            naive,
+            self.snapshots,
+        )
+        return results
+
+    def _advance(self, model, step, kwargs):
+        n = step - model.next_step
+        if n > 0:
+            model.advance(n, callback=lambda *_: kwargs, sample_time=np.inf)
+            self.simulated_steps += n
+
+    def _visit(self, model, node, kwargs, n_steps, results):
+        if node.change is not None:
+            kwargs = {**kwargs, **(node.change.apply(model) or {})}
+        children = sorted(node.children.values(), key=lambda child: child.step)
+        for k, child in enumerate(children):
+            self._advance(model, child.step, kwargs)
+            last = k == len(children) - 1 and not node.scenarios
+            snapshot = None
+            if not last:
+                snapshot = ModelSnapshot(model)
+                self.snapshots += 1
+            self._visit(model, child, kwargs, n_steps, results)
+            if snapshot is not None:
+                snapshot.restore(model)
+        if node.scenarios:
+            self._advance(model, n_steps, kwargs)
+            recorded = model._recorded(0, n_steps, self.record)
+            for name in node.scenarios:
+                results[name] = {key: np.array(values) for key, values in recorded.items()}
@@ -0,0 +1,296 @@
+"""Surrogate models of plant KPIs for design optimisation with few true simulations.
+
+Every KPI (e.g. EQI, OCI, violation time) is modelled by a Gaussian process over the design parameters
+(e.g. `reginit.QINTR`, `asm1init.VOL5`). `ActiveLearner` alternates between the surrogate and batches of
+true simulations:
+
+- initial design: Latin hypercube sample of the parameter box,
+- selection: batch expected improvement of the objective KPI weighted by the probability that the
+  constraint KPIs stay below their limits; the batch is built greedily by conditioning the surrogate on the
+  predicted mean of the already selected points (kriging believer),
+- screening: candidates whose optimistic bound (mean - kappa ⋅ std) cannot beat the best feasible
+  simulation are rejected without simulation.
+
+The true simulations are run by `batch_run`, optionally in parallel processes.
+"""
+
+from concurrent.futures import ProcessPoolExecutor
+from dataclasses import dataclass, field
+
+import numpy as np
+from scipy.linalg import cho_factor, cho_solve
+from scipy.optimize import minimize
+from scipy.stats import norm, qmc
+
+from bsm2_python.log import logger
+
+
+def _matern52(x1, x2, lengthscales):
+    d = np.sqrt(np.sum(((x1[:, None, :] - x2[None, :, :]) / lengthscales) ** 2, axis=-1)) * np.sqrt(5.0)
+    return (1.0 + d + d**2 / 3.0) * np.exp(-d)
+
+
+class GaussianProcess:
+    """Creates a GaussianProcess object, a Gaussian process regression with a Matérn 5/2 kernel.
+
+    The inputs are scaled to the unit box, the outputs are standardised. Length scales per input,
+    signal variance and noise variance maximise the log marginal likelihood.
+
+    Parameters
+    ----------
+    bounds : np.ndarray(d, 2)
+        Lower and upper bound of every input.
+    noise : float (optional)
+        Lower bound of the relative noise variance. <br>
+        Default is 1e-8.
+    n_restarts : int (optional)
+        Number of random restarts of the hyperparameter optimisation. <br>
+        Default is 3.
+    seed : int (optional)
+        Seed of the restarts. <br>
+        Default is 0.
+    """
+
+    def __init__(self, bounds, noise: float = 1e-8, n_restarts: int = 3, seed: int = 0):
+        self.bounds = np.asarray(bounds, dtype=float)
+        self.noise = noise
+        self.n_restarts = n_restarts
+        self.rng = np.random.default_rng(seed)
+        self.theta = None
+
+    def _scale(self, x):
+        x = np.atleast_2d(np.asarray(x, dtype=float))
+        return (x - self.bounds[:, 0]) / (self.bounds[:, 1] - self.bounds[:, 0])
+
+    def _nll(self, theta, x, y):
+        lengthscales, signal, noise = np.exp(theta[:-2]), np.exp(theta[-2]), np.exp(theta[-1]) + self.noise
+        k = signal * _matern52(x, x, lengthscales) + noise * np.eye(len(x))
+        try:
+            factor = cho_factor(k, lower=True)
+        except np.linalg.LinAlgError:
+            return 1e10
+        alpha = cho_solve(factor, y)
+        return 0.5 * y @ alpha + np.sum(np.log(np.diag(factor[0]))) + 0.5 * len(x) * np.log(2 * np.pi)
+
+    def fit(self, x, y):
+        """Fits the hyperparameters and conditions the process on the observations `x` (n, d), `y` (n)."""
+        self._x = self._scale(x)
+        y = np.asarray(y, dtype=float)
+        self._mean, self._std = float(np.mean(y)), float(np.std(y)) or 1.0
+        self._y = (y - self._mean) / self._std
+        d = self._x.shape[1]
+        bounds = [(np.log(1e-2), np.log(1e1))] * d + [(np.log(1e-2), np.log(1e2)), (np.log(1e-10), np.log(1e-1))]
+        starts = [np.r_[np.log(0.3) * np.ones(d), 0.0, np.log(1e-6)]]
+        starts += [np.array([self.rng.uniform(lo, hi) for lo, hi in bounds]) for _ in range(self.n_restarts)]
+        best = None
+        for start in starts:
+            result = minimize(self._nll, start, args=(self._x, self._y), method='L-BFGS-B', bounds=bounds)
+            if best is None or result.fun < best.fun:
+                best = result
+        self.theta = best.x
+        self._factorise()
+        return self
+
+    def _factorise(self):
+        lengthscales, signal = np.exp(self.theta[:-2]), np.exp(self.theta[-2])
+        noise = np.exp(self.theta[-1]) + self.noise
+        k = signal * _matern52(self._x, self._x, lengthscales) + noise * np.eye(len(self._x))
+        self._factor = cho_factor(k, lower=True)
+        self._alpha = cho_solve(self._factor, self._y)
+
+    def condition(self, x, y):
+        """Adds observations without refitting the hyperparameters."""
+        self._x = np.vstack([self._x, self._scale(x)])
+        self._y = np.r_[self._y, (np.atleast_1d(y) - self._mean) / self._std]
+        self._factorise()
+
+    def predict(self, x):
+        """Returns mean and standard deviation of the process at `x` (m, d)."""
+        xs = self._scale(x)
+        lengthscales, signal = np.exp(self.theta[:-2]), np.exp(self.theta[-2])
+        k_star = signal * _matern52(xs, self._x, lengthscales)
+        mean = k_star @ self._alpha
+        v = cho_solve(self._factor, k_star.T)
+        var = np.maximum(signal - np.sum(k_star * v.T, axis=1), 1e-16)
+        return self._mean + self._std * mean, self._std * np.sqrt(var)
+
+
+def batch_run(evaluate, candidates, n_workers: int = 1):
+    """Runs the true simulations of a batch of candidates.
+
+    Parameters
+    ----------
+    evaluate : Callable[[dict], dict]
+        Simulates the plant for a dict of parameters and returns the KPIs, e.g. with `plant_kpis`.
+        Must be picklable for `n_workers > 1`.
+    candidates : list[dict]
+        Parameters of the candidates.
+    n_workers : int (optional)
+        Number of parallel processes. <br>
+        Default is 1.
+
+    Returns
+    -------
+    kpis : list[dict]
+        KPIs of every candidate.
+    """
+
+    if n_workers <= 1:
+        return [evaluate(candidate) for candidate in candidates]
+    with ProcessPoolExecutor(max_workers=n_workers) as executor:
+        return list(executor.map(evaluate, candidates))
+
+
+def plant_kpis(model, violations=('SNH',), limits=(4,)):
+    """Returns EQI, OCI and the violation times [d] of a simulated BSM2 plant over its evaluation period."""
+    performance = model.get_final_performance()
+    kpis = {'eqi': float(performance[1]), 'oci': float(performance[-1])}
+    for comp, days in model.get_violations(violations, limits).items():
+        kpis[f'violation_{comp}'] = float(days)
+    return kpis
+
+
+@dataclass
+class ActiveLearner:
+    """Surrogate-assisted minimisation of a plant KPI.
+
+    evaluate : Callable[[dict], dict]
+        True simulation, see `batch_run`.
+    parameters : dict{str: tuple(float, float)}
+        Design parameters and their bounds.
+    objective : str
+        KPI to be minimised.
+    constraints : dict{str: float}
+        Upper limits of other KPIs.
+    batch_size : int
+        Number of true simulations per iteration.
+    n_workers : int
+        Number of parallel processes of `batch_run`.
+    seed : int
+        Seed of the sampling.
+    """
+
+    evaluate: object
+    parameters: dict
+    objective: str = 'oci'
+    constraints: dict = field(default_factory=dict)
+    batch_size: int = 4
+    n_workers: int = 1
+    seed: int = 0
+    history: list = field(default_factory=list)
+
+    def __post_init__(self):
+        self.names = list(self.parameters)
+        self.bounds = np.array([self.parameters[name] for name in self.names], dtype=float)
+        self.rng = np.random.default_rng(self.seed)
+        self.models = {}
+
+    @property
+    def n_simulations(self):
+        return len(self.history)
+
+    def _vector(self, params):
+        return np.array([[p[name] for name in self.names] for p in params], dtype=float)
+
+    def _params(self, x):
+        return [dict(zip(self.names, map(float, row), strict=True)) for row in np.atleast_2d(x)]
+
+    def _sample(self, n):
+        unit = qmc.LatinHypercube(d=len(self.names), seed=self.rng).random(n)
+        return qmc.scale(unit, self.bounds[:, 0], self.bounds[:, 1])
+
+    def simulate(self, candidates):
+        """Runs the true simulations of `candidates` (list of parameter dicts) and refits the surrogates."""
+        kpis = batch_run(self.evaluate, candidates, self.n_workers)
+        self.history += list(zip(candidates, kpis, strict=True))
+        x = self._vector([p for p, _ in self.history])
+        for kpi in [self.objective, *self.constraints]:
+            y = [k[kpi] for _, k in self.history]
+            self.models[kpi] = GaussianProcess(self.bounds, seed=self.seed).fit(x, y)
+        return kpis
+
+    def best(self):
+        """Returns parameters and KPIs of the best feasible true simulation (`None` if there is none)."""
+        feasible = [(p, k) for p, k in self.history if all(k[c] <= lim for c, lim in self.constraints.items())]
+        return min(feasible, key=lambda pk: pk[1][self.objective]) if feasible else None
+
+    def predict(self, candidates):
+        """Returns mean and standard deviation of every modelled KPI for `candidates`."""
+        x = self._vector(candidates)
+        return {kpi: model.predict(x) for kpi, model in self.models.items()}
+
+    def _feasibility(self, x, models):
+        probability = np.ones(len(x))
+        for kpi, limit in self.constraints.items():
+            mean, std = models[kpi].predict(x)
+            probability *= norm.cdf((limit - mean) / std)
+        return probability
+
+    def screen(self, candidates, kappa: float = 2.0, min_feasibility: float = 0.05):
+        """Returns the candidates that may improve on the best feasible simulation.
+
+        A candidate is rejected if its optimistic objective (mean - kappa ⋅ std) is not below the best
+        feasible objective or if the probability of meeting the constraints is below `min_feasibility`.
+        """
+        x = self._vector(candidates)
+        mean, std = self.models[self.objective].predict(x)
+        best = self.best()
+        keep = self._feasibility(x, self.models) >= min_feasibility
+        if best is not None:
+            keep &= mean - kappa * std < best[1][self.objective]
+        return [c for c, k in zip(candidates, keep, strict=True) if k]
+
+    def propose(self, batch_size: int | None = None, n_candidates: int = 2000):
+        """Returns the next batch of candidates for true simulation (batch expected improvement)."""
+        batch_size = self.batch_size if batch_size is None else batch_size
+        pool = self._sample(n_candidates)
+        models = {kpi: _copy_gp(model) for kpi, model in self.models.items()}
+        best = self.best()
+        if best is not None:
+            incumbent = best[1][self.objective]
+        else:
+            incumbent = min(k[self.objective] for _, k in self.history)
+        chosen = []
+        for _ in range(batch_size):
+            mean, std = models[self.objective].predict(pool)
+            z = (incumbent - mean) / std
+            acquisition = ((incumbent - mean) * norm.cdf(z) + std * norm.pdf(z)) * self._feasibility(pool, models)
+            k = int(np.argmax(acquisition))
+            chosen.append(pool[k])
+            # kriging believer: the selected point is assumed to take its predicted value
+            for model in models.values():
+                model.condition(pool[k : k + 1], model.predict(pool[k : k + 1])[0])
+            pool = np.delete(pool, k, axis=0)
+        return self._params(np.array(chosen))
+
+    def optimise(self, n_iterations: int, n_initial: int | None = None):
+        """Runs the initial design and `n_iterations` batches of active learning.
+
+        Returns
+        -------
+        best : tuple(dict, dict)
+            Parameters and KPIs of the best feasible true simulation.
+        """
+
+        if not self.history:
+            n_initial = 2 * len(self.names) + 1 if n_initial is None else n_initial
+            self.simulate(self._params(self._sample(n_initial)))
+        for iteration in range(n_iterations):
+            self.simulate(self.propose())
+            best = self.best()
+            logger.info(
+                'Active learning iteration %s: %s simulations, best %s = %s',
+                iteration + 1,
+                self.n_simulations,
+                self.objective,
+                None if best is None else best[1][self.objective],
+            )
+        return self.best()
+
+
+def _copy_gp(model):
+    copy = GaussianProcess(model.bounds, model.noise, model.n_restarts)
+    copy.theta, copy._mean, copy._std = model.theta, model._mean, model._std
+    copy._x, copy._y = model._x.copy(), model._y.copy()
+    copy._factorise()
+    return copy
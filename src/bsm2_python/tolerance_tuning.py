@@ -0,0 +1,241 @@
+"""Automatic tuning of the integrator tolerances against KPI accuracy targets.
+
+All units of a plant model that integrate with `odeint` (or the native integrators) expose `rtol` and `atol`.
+The `ToleranceTuner` first simulates a reference with tight tolerances and then searches per unit
+the setting with the lowest wall time that keeps every selected KPI within the requested relative
+deviation from the reference.
+"""
+
+import time
+from collections.abc import Callable
+from dataclasses import dataclass, field
+
+import numpy as np
+
+from bsm2_python.log import logger
+
+# candidate relative tolerances, loosest first
+DEFAULT_CANDIDATES = (1e-3, 1e-4, 1e-5, 1e-6, 1e-7, 1e-8)
+
+
+def find_units(model):
+    """Returns all units of a plant model with adjustable integrator tolerances.
+
+    Parameters
+    ----------
+    model : BSMBase
+        Plant model, e.g. `BSM1OL` or `BSM2OL`.
+
+    Returns
+    -------
+    units : dict{str: Module}
+        Attribute names and units with `rtol` and `atol` attributes.
+    """
+
+    return {
+        name: unit
+        for name, unit in vars(model).items()
+        if hasattr(unit, 'rtol') and hasattr(unit, 'atol') and hasattr(unit, 'output')
+    }
+
+
+def apply_tolerances(model, settings: dict):
+    """Sets the integrator tolerances of the units of a plant model.
+
+    Parameters
+    ----------
+    model : BSMBase
+        Plant model.
+    settings : dict{str: tuple(float, float)}
+        Attribute name of the unit and (rtol, atol).
+    """
+
+    units = find_units(model)
+    for name, (rtol, atol) in settings.items():
+        if name not in units:
+            err = f'Model has no unit {name} with adjustable tolerances.'
+            raise ValueError(err)
+        units[name].rtol = rtol
+        units[name].atol = atol
+
+
+@dataclass
+class TuningResult:
+    """Result of a tolerance search.
+
+    settings : dict{str: tuple(float, float)}
+        Tuned (rtol, atol) per unit.
+    kpis : dict{str: float}
+        KPIs obtained with the tuned settings.
+    reference_kpis : dict{str: float}
+        KPIs of the tight-tolerance reference.
+    walltime : float
+        Wall time of the tuned simulation [s].
+    reference_walltime : float
+        Wall time of the reference simulation [s].
+    """
+
+    settings: dict
+    kpis: dict
+    reference_kpis: dict
+    walltime: float
+    reference_walltime: float
+    history: list = field(default_factory=list)
+
+
+class ToleranceTuner:
+    """Creates a ToleranceTuner object.
+
+    Parameters
+    ----------
+    model_factory : Callable[[], BSMBase]
+        Returns a fresh plant model for every trial, e.g. `lambda: BSM2OL(endtime=20, timestep=15 / 24 / 60)`.
+    kpis : dict{str: Callable[[BSMBase], float]}
+        KPIs evaluated on the model after the simulation, e.g. `{'eqi': lambda m: m.get_final_performance()[1]}`.
+    kpi_tol : float | dict{str: float}
+        Allowed relative deviation of the KPIs from the reference, for all or per KPI [-].
+    candidates : tuple(float) (optional)
+        Candidate relative tolerances. <br>
+        Default is (1e-3, 1e-4, 1e-5, 1e-6, 1e-7, 1e-8).
+    atol_factor : float (optional)
+        Absolute tolerance of a candidate is `atol_factor * rtol`. <br>
+        Default is 1.
+    reference_tol : float (optional)
+        rtol and atol of the reference simulation. <br>
+        Default is 1e-9.
+    units : list[str] (optional)
+        Units to tune. All other units keep their default tolerances. <br>
+        If not provided, all units with adjustable tolerances are tuned.
+    n_steps : int (optional)
+        Number of simulated steps per trial. <br>
+        If not provided, the complete simulation time of the model is simulated.
+    repeats : int (optional)
+        Number of timed simulations per trial, the wall time of a trial is their minimum. <br>
+        Default is 3.
+    margin : float (optional)
+        Relative wall time reduction a candidate has to achieve to replace the current setting, it keeps
+        timer noise from selecting settings that are not faster. <br>
+        Default is 0.05.
+    """
+
+    def __init__(
+        self,
+        model_factory: Callable,
+        kpis: dict[str, Callable],
+        kpi_tol: float | dict[str, float],
+        *,
+        candidates: tuple = DEFAULT_CANDIDATES,
+        atol_factor: float = 1.0,
+        reference_tol: float = 1e-9,
+        units: list[str] | None = None,
+        n_steps: int | None = None,
+        repeats: int = 3,
+        margin: float = 0.05,
+    ):
+        if not kpis:
+            raise ValueError('At least one KPI is needed to tune the tolerances.')
+        self.model_factory = model_factory
+        self.kpis = kpis
+        if isinstance(kpi_tol, dict):
+            missing = set(kpis) - set(kpi_tol)
+            if missing:
+                err = f'No tolerance given for KPIs {sorted(missing)}.'
+                raise ValueError(err)
+            self.kpi_tol = dict(kpi_tol)
+        else:
+            self.kpi_tol = {name: float(kpi_tol) for name in kpis}
+        self.candidates = tuple(sorted(candidates, reverse=True))
+        self.atol_factor = atol_factor
+        self.reference_tol = reference_tol
+        self.units = units
+        self.n_steps = n_steps
+        self.repeats = max(int(repeats), 1)
+        self.margin = margin
+
+    def evaluate(self, settings: dict):
+        """Simulates a fresh model with the given tolerances.
+
+        Parameters
+        ----------
+        settings : dict{str: tuple(float, float)}
+            Attribute name of the unit and (rtol, atol).
+
+        Returns
+        -------
+        kpis : dict{str: float}
+            Values of the KPIs.
+        walltime : float
+            Smallest wall time of `repeats` simulations [s].
+        """
+
+        walltimes = []
+        for _ in range(self.repeats):
+            model = self.model_factory()
+            apply_tolerances(model, settings)
+            n_steps = len(model.simtime) if self.n_steps is None else min(self.n_steps, len(model.simtime))
+            start = time.perf_counter()
+            for i in range(n_steps):
+                model.step(i)
+            walltimes.append(time.perf_counter() - start)
+        return {name: float(kpi(model)) for name, kpi in self.kpis.items()}, min(walltimes)
+
+    def within_tolerance(self, kpis: dict, reference_kpis: dict):
+        """Returns `True` if all KPIs are within their relative tolerance of the reference."""
+        for name, value in kpis.items():
+            ref = reference_kpis[name]
+            if not np.isfinite(value) or abs(value - ref) > self.kpi_tol[name] * max(abs(ref), 1e-12):
+                return False
+        return True
+
+    def tune(self):
+        """Searches the tolerances unit by unit.
+
+        Starting from the reference tolerances, every candidate is tried for one unit at a time while the
+        other units keep their current setting. The fastest candidate within the KPI tolerances is kept if
+        it is faster than the current setting by more than `margin`. If the combined settings exceed the
+        KPI tolerances, the last accepted combination that kept them is returned.
+
+        Returns
+        -------
+        result : TuningResult
+            Tuned settings and the corresponding KPIs and wall times.
+        """
+
+        unit_names = self.units
+        if unit_names is None:
+            unit_names = list(find_units(self.model_factory()))
+        tight = (self.reference_tol, self.reference_tol)
+        settings = {name: tight for name in unit_names}
+
+        reference_kpis, reference_walltime = self.evaluate(settings)
+        logger.info('Tolerance tuning reference: %s (%.2f s)', reference_kpis, reference_walltime)
+        history = [(dict(settings), reference_kpis, reference_walltime)]
+
+        best_walltime = reference_walltime
+        accepted = [(settings, reference_kpis, reference_walltime)]
+        for name in unit_names:
+            for rtol in self.candidates:
+                trial = dict(settings)
+                trial[name] = (rtol, self.atol_factor * rtol)
+                kpis, walltime = self.evaluate(trial)
+                history.append((trial, kpis, walltime))
+                ok = self.within_tolerance(kpis, reference_kpis)
+                logger.debug('Unit %s, rtol %s: %s (%.2f s) ok=%s', name, rtol, kpis, walltime, ok)
+                if ok and walltime < (1 - self.margin) * best_walltime:
+                    settings = trial
+                    best_walltime = walltime
+                    accepted.append((trial, kpis, walltime))
+            logger.info('Unit %s tuned to rtol=%s, atol=%s', name, *settings[name])
+
+        kpis, walltime = self.evaluate(settings)
+        if not self.within_tolerance(kpis, reference_kpis):
+            logger.warning('Combined tuned settings exceed the KPI tolerance: %s', kpis)
+            # fall back to the last accepted combination that keeps the tolerances
+            for settings, _, _ in reversed(accepted[:-1]):
+                kpis, walltime = self.evaluate(settings)
+                if self.within_tolerance(kpis, reference_kpis):
+                    break
+            else:
+                err = 'No tolerance setting reproduces the KPIs of the reference within the KPI tolerance.'
+                raise RuntimeError(err)
+        return TuningResult(settings, kpis, reference_kpis, walltime, reference_walltime, history)
@@ -7,9 +7,10 @@ import os
 import time
 
 import numpy as np
+import pytest
 from tqdm import tqdm
 
-from bsm2_python.bsm2.adm1_bsm2 import ADM1Reactor
+from bsm2_python.bsm2.adm1_bsm2 import ADM1Reactor, asm2adm
 from bsm2_python.bsm2.init import adm1init_bsm2 as adm1init
 from bsm2_python.log import logger
 
@@ -369,3 +370,54 @@ def test_adm1_dyn():
 
 
 test_adm1_dyn()
+
+
+def test_adm1_implicit_ph():
+    with open(path_name + '/../src/bsm2_python/data/dynsludge_bsm2.csv', encoding='utf-8-sig') as f:
+        data_in = np.array(list(csv.reader(f, delimiter=','))).astype(np.float64)
+    timestep = 15 / 24 / 60
+    n_steps = 192
+
+    def simulate(ph_coupling):
+        adm1_reactor = ADM1Reactor(
+            adm1init.DIGESTERINIT.copy(), adm1init.DIGESTERPAR, adm1init.INTERFACEPAR, adm1init.DIM_D
+        )
+        adm1_reactor.ph_coupling = ph_coupling
+        adm1_reactor.y_in1[21] = adm1init.PHINIT
+        yd_out_all = np.zeros((n_steps, 51))
+        y_out1_all = np.zeros((n_steps, 33))
+        iterations = np.zeros(n_steps, dtype=int)
+        for i in range(n_steps):
+            _, yd_out_all[i], y_out1_all[i] = adm1_reactor.output(timestep, i * timestep, data_in[i, 1:], adm1init.t_op)
+            iterations[i] = adm1_reactor.ph_iterations
+        return adm1_reactor, yd_out_all, y_out1_all, iterations
+
+    start = time.perf_counter()
+    reactor, yd_implicit, y_out1_implicit, iterations = simulate('implicit')
+    stop = time.perf_counter()
+    logger.info('Implicit pH coupling: %.3f s, %.2f integrations per step', stop - start, iterations.mean())
+    _, yd_delayed, _, _ = simulate('delayed')
+
+    # every step converged, the interface charge balance uses the pH at the end of the step
+    assert np.all(iterations < reactor.ph_maxiter)
+    for i in range(n_steps):
+        y_in1 = np.append(data_in[i, 1:22], yd_implicit[i, 33])
+        y_out1 = asm2adm(y_in1, adm1init.t_op, adm1init.INTERFACEPAR)
+        assert np.allclose(y_out1, y_out1_implicit[i], rtol=1e-4, atol=1e-8)
+    # the delay of one step of 15 min has little effect
+    assert np.max(np.abs(yd_implicit[:, 33] - yd_delayed[:, 33])) < 1e-3
+
+    assert reactor.ph_converged
+    # an unreachable tolerance stops at the maximum number of iterations and is flagged
+    reactor.ph_tol = 0.0
+    reactor.ph_maxiter = 2
+    reactor.output(timestep, n_steps * timestep, data_in[n_steps, 1:], adm1init.t_op)
+    assert reactor.ph_iterations == 2
+    assert not reactor.ph_converged
+
+    reactor.ph_coupling = 'filtered'
+    with pytest.raises(ValueError, match='filtered'):
+        reactor.output(timestep, n_steps * timestep, data_in[n_steps, 1:], adm1init.t_op)
+
+
+test_adm1_implicit_ph()
@@ -0,0 +1,117 @@
+"""
+test arrow_ipc.py
+"""
+
+import tempfile
+
+import numpy as np
+import pytest
+
+from bsm2_python.arrow_ipc import ALIGNMENT, ArrowRecorder, ArrowWriter, read_arrow
+from bsm2_python.bsm1_ol import BSM1OL
+from bsm2_python.evaluation import Evaluation
+from bsm2_python.log import logger
+
+
+def test_arrow_writer():
+    with tempfile.TemporaryDirectory() as tmp:
+        fields = [
+            ('time', np.float64, {'unit': 'd'}),
+            ('count', np.int32, None),
+            ('level', np.float32, {'unit': 'm'}),
+        ]
+        with ArrowWriter(tmp + '/table.arrow', fields, {'plant': 'test'}) as writer:
+            writer.write_batch([np.arange(5.0), np.arange(5), np.ma.MaskedArray(np.ones(5), [0, 1, 0, 0, 1])])
+            writer.write_batch({'time': np.arange(5.0, 8.0), 'count': np.arange(3), 'level': np.full(3, 2.0)})
+        arrow_file = read_arrow(tmp + '/table.arrow')
+        assert arrow_file.schema_metadata == {'plant': 'test'}
+        assert arrow_file.metadata == {'time': {'unit': 'd'}, 'count': {}, 'level': {'unit': 'm'}}
+        assert np.array_equal(arrow_file.columns['time'], np.arange(8.0))
+        assert arrow_file.columns['count'].dtype == np.int32
+        assert list(arrow_file.columns['level'].mask) == [False, True, False, False, True, False, False, False]
+        assert np.allclose(arrow_file.columns['level'].compressed(), [1, 1, 1, 2, 2, 2])
+        with open(tmp + '/table.arrow', 'rb') as f:
+            data = f.read()
+        assert data[:6] == data[-6:] == b'ARROW1'
+
+        # a single batch is memory-mapped without copies, buffers are aligned
+        with ArrowWriter(tmp + '/single.arrow', fields[:1]) as writer:
+            writer.write_batch([np.linspace(0, 1, 1000)])
+        column = read_arrow(tmp + '/single.arrow').columns['time']
+        assert isinstance(column.base, np.memmap)
+        assert column.__array_interface__['data'][0] % ALIGNMENT == 0
+        assert np.array_equal(column, np.linspace(0, 1, 1000))
+
+
+def test_arrow_recorder():
+    timestep = 15 / 24 / 60
+    with tempfile.TemporaryDirectory() as tmp:
+        bsm1_ol = BSM1OL(endtime=1, timestep=timestep, tempmodel=False, activate=False)
+        with ArrowRecorder(bsm1_ol, tmp + '/results.arrow', record=['ys_eff', 'sludge_height'], batch_steps=4) as rec:
+            rec.advance(10)
+        arrow_file = read_arrow(tmp + '/results.arrow')
+        logger.info('Arrow columns: %s', list(arrow_file.columns))
+        assert bsm1_ol.next_step == 10
+        assert arrow_file.schema_metadata == {'model': 'BSM1OL'}
+        assert np.array_equal(arrow_file.columns['simtime'], bsm1_ol.simtime[:10])
+        assert np.array_equal(arrow_file.columns['ys_eff.SNH'], bsm1_ol.ys_eff_all[:10, 9])
+        assert np.array_equal(arrow_file.columns['sludge_height'], bsm1_ol.sludge_height_all[:10])
+        assert arrow_file.metadata['ys_eff.Q'] == {'unit': 'm3/d'}
+        assert arrow_file.metadata['ys_eff.TSS'] == {'unit': 'g(SS)/m3'}
+
+
+def test_evaluation_export():
+    with tempfile.TemporaryDirectory() as tmp:
+        evaluator = Evaluation(tmp + '/evaluation.arrow')
+        evaluator.add_new_data('iqi', 'iqi')
+        evaluator.add_new_data('q_flow_eff', 'q_flow_eff', 'm3/d')
+        for k in range(4):
+            evaluator.update_data('iqi', 100.0 + k, k / 96)
+        evaluator.update_data('q_flow_eff', 18000.0, 0.0)
+        evaluator.export_data()
+        arrow_file = read_arrow(tmp + '/evaluation.arrow')
+        assert list(arrow_file.columns) == ['iqi.timestamp', 'iqi.iqi', 'q_flow_eff.timestamp', 'q_flow_eff.q_flow_eff']
+        assert np.allclose(arrow_file.columns['iqi.iqi'], [100, 101, 102, 103])
+        assert arrow_file.metadata['q_flow_eff.q_flow_eff'] == {'unit': 'm3/d'}
+        assert arrow_file.columns['q_flow_eff.q_flow_eff'].count() == 1
+
+
+def test_arrow_pyarrow():
+    # the files are read by the reference implementation
+    pa = pytest.importorskip('pyarrow')
+    timestep = 15 / 24 / 60
+    with tempfile.TemporaryDirectory() as tmp:
+        fields = [('count', np.int64, {'unit': '-'}), ('level', np.float32, {'unit': 'm'})]
+        with ArrowWriter(tmp + '/table.arrow', fields, {'plant': 'test'}) as writer:
+            writer.write_batch([np.arange(5), np.ma.MaskedArray(np.arange(5.0), [0, 1, 0, 0, 1])])
+            writer.write_batch([np.arange(5, 13), np.ma.MaskedArray(np.full(8, 2.0), [1, 0, 0, 0, 0, 0, 0, 1])])
+        with pa.memory_map(tmp + '/table.arrow') as source:
+            table = pa.ipc.open_file(source).read_all()
+        assert table.schema.metadata == {b'plant': b'test'}
+        assert table.schema.field('level').type == pa.float32()
+        assert table.schema.field('level').metadata == {b'unit': b'm'}
+        assert table.column('count').to_pylist() == list(range(13))
+        level = table.column('level').to_pylist()
+        assert level == [0.0, None, 2.0, 3.0, None, None] + [2.0] * 6 + [None]
+        assert table.column('level').null_count == 4
+
+        # recorded batches, read as stream (the file without the leading magic bytes and the footer)
+        bsm1_ol = BSM1OL(endtime=1, timestep=timestep, tempmodel=False, activate=False)
+        with ArrowRecorder(bsm1_ol, tmp + '/results.arrow', record=['ys_eff'], batch_steps=4) as rec:
+            rec.advance(10)
+        with open(tmp + '/results.arrow', 'rb') as f:
+            data = f.read()
+        reader = pa.ipc.open_stream(data[8:])
+        batches = list(reader)
+        assert [batch.num_rows for batch in batches] == [4, 4, 2]
+        table = pa.Table.from_batches(batches)
+        assert reader.schema.metadata == {b'model': b'BSM1OL'}
+        assert reader.schema.field('ys_eff.Q').metadata == {b'unit': b'm3/d'}
+        assert np.array_equal(table.column('simtime').to_numpy(), bsm1_ol.simtime[:10])
+        assert np.array_equal(table.column('ys_eff.SNH').to_numpy(), bsm1_ol.ys_eff_all[:10, 9])
+        assert pa.ipc.open_file(tmp + '/results.arrow').read_all().equals(table)
+
+
+test_arrow_writer()
+test_arrow_recorder()
+test_evaluation_export()
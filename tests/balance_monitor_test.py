@@ -0,0 +1,56 @@
+"""
+test balance_monitor.py
+"""
+
+import numpy as np
+
+from bsm2_python.balance_monitor import BalanceMonitor, PlantBalance
+from bsm2_python.bsm2_ol import BSM2OL
+from bsm2_python.log import logger
+
+XBH = 4
+
+
+def test_balance_monitor():
+    # closed bookkeeping: 10 g in, 7 g out, 1 g converted, 2 g accumulated per step
+    monitor = BalanceMonitor(('COD',), threshold=0.01)
+    monitor.reset([100.0])
+    for i in range(10):
+        monitor.update([10.0], [7.0], [1.0], [100.0 + 2.0 * (i + 1)])
+    assert np.allclose(monitor.imbalance, 0.0)
+    assert monitor.ok
+
+    # a leak of 1 g per step is flagged once the drift exceeds the threshold
+    for i in range(10):
+        monitor.update([10.0], [7.0], [1.0], [120.0 + 1.0 * (i + 1)])
+    assert not monitor.ok
+    assert monitor.flags[0][1] == 'COD'
+    assert np.isclose(monitor.summary()['COD']['imbalance'], 10.0)
+
+
+def test_plant_balance():
+    bsm2_ol = BSM2OL(endtime=1, timestep=15 / 24 / 60)
+    balance = PlantBalance(bsm2_ol, threshold=0.01)
+
+    n_steps = 60
+    for i in range(n_steps):
+        bsm2_ol.step(i)
+        balance.observe(i)
+    logger.info('Balance drift: %s', balance.drift)
+    assert balance.ok
+    assert set(balance.drift) == {'activated_sludge', 'digester'}
+    for drift in balance.drift.values():
+        assert all(value < 1e-2 for value in drift.values())
+
+    # biomass vanishing from the reactors is detected as imbalance
+    for reactor in (bsm2_ol.reactor1, bsm2_ol.reactor2, bsm2_ol.reactor3, bsm2_ol.reactor4, bsm2_ol.reactor5):
+        reactor.y0[XBH] *= 0.5
+    bsm2_ol.step(n_steps)
+    balance.observe(n_steps)
+    assert not balance.ok
+    flagged = {quantity for _, quantity, _ in balance.monitors['activated_sludge'].flags}
+    assert {'COD', 'TSS'} <= flagged
+
+
+test_balance_monitor()
+test_plant_balance()
@@ -0,0 +1,63 @@
+"""
+test bsm_base.py
+"""
+
+import os
+
+import numpy as np
+import pytest
+
+from bsm2_python.bsm1_ol import BSM1OL
+from bsm2_python.influent import read_influent
+from bsm2_python.log import logger
+
+path_name = os.path.dirname(__file__)
+
+
+def test_advance():
+    timestep = 15 / 24 / 60
+    bsm1_loop = BSM1OL(endtime=1, timestep=timestep)
+    for i in range(12):
+        bsm1_loop.step(i)
+
+    bsm1_ol = BSM1OL(endtime=1, timestep=timestep)
+    recorded = bsm1_ol.advance(8, record=['ys_eff'])
+    assert bsm1_ol.next_step == 8
+    assert recorded['ys_eff'].shape == (8, 21)
+    recorded = bsm1_ol.run_until(12 * timestep - 1e-9)
+    assert bsm1_ol.next_step == 12
+    assert np.allclose(recorded['simtime'], bsm1_loop.simtime[8:12])
+    assert np.allclose(recorded['ys_eff'], bsm1_loop.ys_eff_all[8:12])
+    assert np.allclose(bsm1_ol.ys_eff_all[:12], bsm1_loop.ys_eff_all[:12])
+    assert np.shares_memory(recorded['y_out5'], bsm1_ol.y_out5_all)
+
+    # callbacks only at the sample instants, returned keyword arguments are kept for the following steps
+    sample_steps = []
+
+    def reduce_aeration(model, i):
+        sample_steps.append(i)
+        return {'klas': model.klas * 0.5}
+
+    bsm1_ol.advance(12, callback=reduce_aeration, sample_time=1 / 24)
+    logger.info('Callback at steps %s', sample_steps)
+    assert sample_steps == [12, 16, 20]
+    assert np.isclose(bsm1_ol.reactor5.kla, bsm1_loop.klas[4] / 8)
+
+    # no steps beyond the simulation time
+    bsm1_ol.run_until(10.0)
+    assert bsm1_ol.next_step == len(bsm1_ol.simtime)
+    assert bsm1_ol.advance(5)['simtime'].size == 0
+
+
+def test_influent_before_start():
+    # influent data starting after the start of the simulation
+    data_in = read_influent(path_name + '/../src/bsm2_python/data/dryinfluent.csv')[:200]
+    data_in[:, 0] += 0.5
+    bsm1_ol = BSM1OL(data_in=data_in, timestep=15 / 24 / 60, endtime=1)
+    assert bsm1_ol._influent_row(0.5) == 0
+    with pytest.raises(ValueError, match='influent data starts'):
+        bsm1_ol.step(0)
+
+
+test_advance()
+test_influent_before_start()
@@ -0,0 +1,56 @@
+"""
+test continuation.py
+"""
+
+import numpy as np
+
+from bsm2_python.bsm2_ol import BSM2OL
+from bsm2_python.continuation import SteadyStateContinuation, activated_sludge_problem, digester_problem
+from bsm2_python.kla_adjoint import line_parameters, line_sparsity
+from bsm2_python.log import logger
+
+
+def test_activated_sludge_continuation():
+    bsm2_ol = BSM2OL(endtime=1, timestep=15 / 24 / 60)
+    for i in range(2):
+        bsm2_ol.step(i)
+
+    func, x0, p0 = activated_sludge_problem(bsm2_ol, 'qintr')
+    assert p0 == bsm2_ol.qintr
+    structure = line_sparsity(line_parameters(bsm2_ol)[1])
+    continuation = SteadyStateContinuation(func, x0, p0, structure=structure)
+    # coloured finite differences need far fewer evaluations than one per state
+    assert continuation._jac_x.n_colours < len(continuation.active) / 5
+    result = continuation.run(40000)
+    logger.info(
+        'Continuation over QINTR: %s points, %s factorisations, max. eigenvalues %s',
+        len(result.parameters),
+        result.n_factorisations,
+        result.max_real_eigenvalue,
+    )
+    assert np.isclose(result.parameters[-1], 40000)
+    assert np.all(np.diff(result.parameters) < 0)
+    assert not result.folds
+    assert np.all(result.stable)
+    for p, x in zip(result.parameters, result.states):
+        assert np.max(np.abs(func(x, p)) / (1 + np.abs(x))) < 1e-6
+
+
+def test_digester_continuation():
+    bsm2_ol = BSM2OL(endtime=1, timestep=15 / 24 / 60)
+    for i in range(2):
+        bsm2_ol.step(i)
+
+    func, x0, p0 = digester_problem(bsm2_ol)
+    continuation = SteadyStateContinuation(func, x0, p0)
+    result = continuation.run(303.15)
+    logger.info('Continuation over T_OP: %s points, %s', len(result.parameters), result.max_real_eigenvalue)
+    assert np.isclose(result.parameters[-1], 303.15)
+    assert np.all(result.stable)
+    assert not np.allclose(result.states[-1], result.states[0])
+    scale = 1 + np.abs(result.states[-1])
+    assert np.max(np.abs(func(result.states[-1], 303.15)) / scale) < 1e-6
+
+
+test_activated_sludge_continuation()
+test_digester_continuation()
@@ -0,0 +1,50 @@
+"""
+test derived_quantities.py
+"""
+
+import pytest
+
+from bsm2_python.derived_quantities import DerivedQuantities
+
+
+def test_derived_quantities():
+    calls = {'a': 0, 'b': 0}
+    state = {'x': 2.0}
+
+    def quantity_a():
+        calls['a'] += 1
+        return state['x'] * 3
+
+    def quantity_b(a):
+        calls['b'] += 1
+        return a + 1
+
+    derived = DerivedQuantities()
+    derived.declare('a', quantity_a)
+    derived.declare('b', quantity_b, deps=('a',))
+
+    # lazily computed, at most once per step
+    assert not derived.is_cached('b')
+    assert derived['b'] == 7.0
+    assert derived['a'] == 6.0
+    assert derived['b'] == 7.0
+    assert calls == {'a': 1, 'b': 1}
+
+    # new step
+    state['x'] = 1.0
+    derived.invalidate(1)
+    assert derived.step_idx == 1
+    assert derived['b'] == 4.0
+    assert calls == {'a': 2, 'b': 2}
+
+    # redeclaring drops the dependent values
+    derived.declare('a', lambda: 10.0)
+    assert derived['b'] == 11.0
+
+    with pytest.raises(ValueError):
+        derived.declare('c', lambda d: d, deps=('d',))
+    with pytest.raises(KeyError):
+        derived.get('unknown')
+
+
+test_derived_quantities()
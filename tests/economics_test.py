@@ -0,0 +1,37 @@
+"""
+test energy_management/economics.py
+"""
+
+from types import SimpleNamespace
+
+import numpy as np
+
+from bsm2_python.energy_management.economics import Economics
+from bsm2_python.log import logger
+
+
+def test_economics_batch():
+    unit = SimpleNamespace(capex=1e5)
+    economics = Economics([unit, unit], [unit], unit, unit, unit, unit, unit, unit)
+
+    rng = np.random.default_rng(1)
+    simtime = np.arange(0, 3, 15 / 24 / 60)
+    net_electricity = rng.normal(0, 200, len(simtime))
+
+    # reference: step-wise evaluation as done during the simulation
+    for i in range(len(simtime)):
+        economics.get_income(net_electricity[i], simtime, i)
+        economics.get_expenditures(net_electricity[i], simtime, i)
+
+    # second scenario with shifted prices, some of them negative
+    prices = np.vstack([economics.electricity_prices, economics.electricity_prices - 80])
+    income, expenditures, cum_cash_flow = economics.evaluate_batch(net_electricity, simtime, prices)
+    logger.info('cumulative cash flow per scenario: %s', cum_cash_flow[:, -1])
+
+    assert income.shape == (2, len(simtime))
+    assert np.isclose(cum_cash_flow[0, -1], economics.cum_cash_flow, rtol=1e-10)
+    assert np.allclose(cum_cash_flow[:, -1], np.sum(income - expenditures, axis=1))
+    assert not np.isclose(cum_cash_flow[1, -1], cum_cash_flow[0, -1])
+
+
+test_economics_batch()
@@ -0,0 +1,128 @@
+"""
+test fidelity.py
+"""
+
+import numpy as np
+
+from bsm2_python.bsm1_ol import BSM1OL
+from bsm2_python.bsm2.init import adm1init_bsm2 as adm1init
+from bsm2_python.bsm2.init import settler1dinit_bsm2 as settler1dinit
+from bsm2_python.bsm2.settler1d_bsm2 import remap_layers
+from bsm2_python.bsm2_ol import BSM2OL
+from bsm2_python.fidelity import DEFAULT_LEVELS, FidelityController, FidelityLevel
+from bsm2_python.log import logger
+
+timestep = 15 / 24 / 60
+digesterinit = adm1init.DIGESTERINIT.copy()
+
+
+def test_settler_layers():
+    profile = np.reshape(settler1dinit.settlerinit, (12, 10))
+    coarse = remap_layers(profile, 5)
+    # total mass of every component is preserved
+    assert np.allclose(coarse.sum(axis=1) * 2, profile.sum(axis=1))
+    assert np.allclose(remap_layers(coarse, 10).sum(axis=1), profile.sum(axis=1))
+
+    bsm1_ol = BSM1OL(endtime=1, timestep=timestep, tempmodel=False, activate=False)
+    bsm1_ol.advance(4)
+    bsm1_ol.settler.set_layers(5)
+    assert list(bsm1_ol.settler.layer) == [3, 5]
+    bsm1_ol.advance(4)
+    assert bsm1_ol.ys_tss_internal.shape == (10,)
+    bsm1_ol.settler.set_layers(10)
+    assert list(bsm1_ol.settler.layer) == list(settler1dinit.LAYER)
+
+
+def test_digester_stride():
+    bsm2_ol = BSM2OL(endtime=1, timestep=timestep, tempmodel=False, activate=False)
+    bsm2_ol.adm1_reactor.stride = 4
+    bsm2_ol.advance(8)
+    outputs = []
+    for i in range(8, 12):
+        bsm2_ol.step(i)
+        outputs.append(bsm2_ol.yd_out.copy())
+    # one integration over four time steps, the output is held in between
+    assert all(np.array_equal(outputs[0], y) for y in outputs[1:])
+    bsm2_ol.step(12)
+    assert not np.array_equal(outputs[0], bsm2_ol.yd_out)
+
+
+def test_switch_during_hold():
+    def plant():
+        bsm2_ol = BSM2OL(endtime=1, timestep=timestep, tempmodel=False, activate=False)
+        bsm2_ol.adm1_reactor.yd0 = digesterinit.copy()
+        levels = [FidelityLevel('full'), FidelityLevel('coarse digester', digester_stride=4)]
+        return bsm2_ol, FidelityController(bsm2_ol, deadline=1.0, levels=levels)
+
+    # full fidelity right after the first coarse step, within the hold of the digester output
+    switched, controller = plant()
+    controller.apply(1)
+    switched.step(0)
+    controller.apply(0)
+    for i in range(1, 8):
+        switched.step(i)
+    # full fidelity after the hold
+    reference, controller = plant()
+    controller.apply(1)
+    for i in range(4):
+        reference.step(i)
+    controller.apply(0)
+    for i in range(4, 8):
+        reference.step(i)
+    assert np.array_equal(switched.yd_out_all[:8], reference.yd_out_all[:8])
+    assert np.array_equal(switched.adm1_reactor.yd0, reference.adm1_reactor.yd0)
+    assert np.array_equal(switched.yd_out_all[1], switched.yd_out_all[3])
+
+
+def test_fidelity_controller():
+    bsm1_ol = BSM1OL(endtime=1, timestep=timestep, tempmodel=False, activate=False)
+    bsm1_ol.advance(4)
+    controller = FidelityController(bsm1_ol, deadline=1.0, levels=DEFAULT_LEVELS[:2], patience=2)
+    errors = controller.calibrate(8, record=['ys_eff'])
+    logger.info('Estimated errors of the fidelity levels: %s', errors)
+    assert errors[0] == 0
+    assert 0 < errors[1] < 0.2
+    assert bsm1_ol.next_step == 4
+    # the errors belong to this controller, the default levels are not changed
+    assert all(level.error == 0.0 for level in DEFAULT_LEVELS)
+
+    # an unreachable deadline switches to the reduced settler, a relaxed one back to full fidelity
+    controller.deadline = 1e-9
+    controller.advance(6)
+    assert controller.levels[controller.level].name == 'reduced settler'
+    controller.deadline = 100.0
+    controller.advance(6)
+    assert controller.level == 0
+    assert [name for _, name in controller.history] == ['full', 'reduced settler', 'full']
+
+    # levels beyond the accuracy budget are not used
+    controller.accuracy_budget = errors[1] / 2
+    controller.deadline = 1e-9
+    controller.advance(6)
+    assert controller.level == 0
+    assert bsm1_ol.next_step == 22
+
+
+def test_fidelity_skip_levels():
+    bsm1_ol = BSM1OL(endtime=1, timestep=timestep, tempmodel=False, activate=False)
+    levels = [
+        FidelityLevel('full'),
+        FidelityLevel('inaccurate', settler_layers=3, error=0.5),
+        FidelityLevel('reduced settler', settler_layers=5, error=0.01),
+    ]
+    controller = FidelityController(bsm1_ol, deadline=1e-9, levels=levels, accuracy_budget=0.1, patience=2)
+    # a level beyond the accuracy budget is skipped on the way to coarser levels
+    controller.advance(2)
+    assert controller.levels[controller.level].name == 'reduced settler'
+    # and on the way back
+    controller.deadline = 100.0
+    controller.advance(2)
+    assert controller.level == 0
+    assert [name for _, name in controller.history] == ['full', 'reduced settler', 'full']
+
+
+test_settler_layers()
+test_digester_stride()
+test_switch_during_hold()
+test_fidelity_controller()
+test_fidelity_skip_levels()
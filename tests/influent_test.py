@@ -0,0 +1,112 @@
+"""
+test influent.py
+"""
+
+import csv
+import os
+import tempfile
+import time
+
+import numpy as np
+
+from bsm2_python.bsm1_ol import BSM1OL
+from bsm2_python.influent import COLUMNS, load_influent, read_influent
+from bsm2_python.log import logger
+
+path_name = os.path.dirname(__file__)
+influent = path_name + '/../src/bsm2_python/data/dyninfluent_bsm2.csv'
+
+with open(influent, encoding='utf-8-sig') as f:
+    reference = np.array(list(csv.reader(f, delimiter=','))).astype(float)
+
+
+def write_csv(file, rows, header=None):
+    with open(file, 'w') as f:
+        if header is not None:
+            f.write(','.join(header) + '\n')
+        for row in rows:
+            f.write(','.join(row) + '\n')
+
+
+def test_read_influent():
+    start = time.perf_counter()
+    data_in = read_influent(influent)
+    logger.info('Parsed %s rows in %.3f s', len(data_in), time.perf_counter() - start)
+    assert np.array_equal(data_in, reference)
+    # small chunks with several threads give the same result
+    assert np.array_equal(read_influent(influent, n_threads=4, chunk_size=4096), reference)
+
+    # values outside the correctly rounded fast path are parsed by Python
+    sludge = path_name + '/../src/bsm2_python/data/dynsludge_bsm2.csv'
+    with open(sludge, encoding='utf-8-sig') as f:
+        assert np.array_equal(read_influent(sludge), np.array(list(csv.reader(f, delimiter=','))).astype(float))
+
+
+def test_column_mapping():
+    with tempfile.TemporaryDirectory() as tmp:
+        # SCADA export: reordered columns with header, extra column, no dummy states
+        names = ['Q', 'time', 'pump', *COLUMNS[1:15], 'TEMP']
+        order = [COLUMNS.index(name) if name in COLUMNS else 0 for name in names]
+        rows = [[repr(float(value)) for value in row[order]] for row in reference[:100]]
+        write_csv(tmp + '/scada.csv', rows, header=names)
+        defaults = {name: 0.0 for name in ('SD1', 'SD2', 'SD3', 'XD4', 'XD5')}
+        columns = {name: name for name in COLUMNS if name in names}
+        data_in = read_influent(tmp + '/scada.csv', columns=columns, defaults=defaults)
+        assert np.array_equal(data_in, reference[:100])
+
+        # columns by index without header
+        rows = [[repr(float(value)) for value in row[:17]] for row in reference[:100]]
+        write_csv(tmp + '/plain.csv', rows)
+        data_in = read_influent(tmp + '/plain.csv', defaults=defaults)
+        assert np.array_equal(data_in, reference[:100])
+        try:
+            read_influent(tmp + '/plain.csv')
+        except ValueError as err:
+            assert 'SD1' in str(err)
+        else:
+            raise AssertionError('missing columns were not detected')
+
+
+def test_validation():
+    with tempfile.TemporaryDirectory() as tmp:
+        rows = [[repr(float(value)) for value in row] for row in reference[:50]]
+        for change, message in [
+            (lambda r: r[20].__setitem__(3, '1.2.3'), 'data row 21: invalid number'),
+            (lambda r: r[30].pop(), 'data row 31: wrong number of columns'),
+            (lambda r: r[40].__setitem__(0, r[39][0]), 'data row 41: time is not increasing'),
+            (lambda r: r[7].__setitem__(15, '-1'), 'data row 8: negative value'),
+            (lambda r: r[9].__setitem__(2, '1e999'), 'data row 10: value is not finite'),
+        ]:
+            broken = [list(row) for row in rows]
+            change(broken)
+            write_csv(tmp + '/broken.csv', broken)
+            for chunk_size in (1 << 20, 1000):
+                try:
+                    read_influent(tmp + '/broken.csv', chunk_size=chunk_size)
+                except ValueError as err:
+                    assert message in str(err), str(err)
+                else:
+                    raise AssertionError(f'{message} was not detected')
+
+
+def test_influent_store():
+    with tempfile.TemporaryDirectory() as tmp:
+        data_in = read_influent(influent, store=tmp + '/influent.npy')
+        assert isinstance(data_in, np.memmap)
+        stored = load_influent(tmp + '/influent.npy')
+        assert np.array_equal(stored, reference)
+
+        timestep = 15 / 24 / 60
+        bsm1_csv = BSM1OL(data_in=influent, endtime=1, timestep=timestep)
+        bsm1_store = BSM1OL(data_in=tmp + '/influent.npy', endtime=1, timestep=timestep)
+        for i in range(4):
+            bsm1_csv.step(i)
+            bsm1_store.step(i)
+        assert np.array_equal(bsm1_csv.ys_eff_all[:4], bsm1_store.ys_eff_all[:4])
+        del data_in, stored, bsm1_store
+
+
+test_read_influent()
+test_column_mapping()
+test_validation()
+test_influent_store()
@@ -0,0 +1,110 @@
+"""
+test bsm2/integrators.py
+"""
+
+import time
+
+import numpy as np
+import pytest
+
+import bsm2_python.bsm2.init.asm1init_bsm1 as asm1init
+from bsm2_python.bsm2.asm1_bsm2 import ASM1Reactor
+from bsm2_python.log import logger
+
+
+def _reactor(integrator, y0, *, dense_output=False, positive=False):
+    return ASM1Reactor(
+        asm1init.KLA3,
+        asm1init.VOL3,
+        y0.copy(),
+        asm1init.PAR3,
+        asm1init.CARB3,
+        asm1init.CARBONSOURCECONC,
+        tempmodel=False,
+        activate=False,
+        integrator=integrator,
+        dense_output=dense_output,
+        positive=positive,
+    )
+
+
+def test_imex_asm1():
+    # CONSTINFLUENT from BSM2:
+    y_in = np.array(
+        [30, 69.5, 51.2, 202.32, 28.17, 0, 0, 0, 0, 31.56, 6.95, 10.59, 7, 211.2675, 18446, 15, 0, 0, 0, 0, 0]
+    )
+    timestep = 15 / (60 * 24)
+    simtime = np.arange(0, 2, timestep)
+
+    # start far from steady state: reactor filled with influent
+    reactor_ref = _reactor('odeint', y_in)
+    reactor_imex = _reactor('imex', y_in)
+    reactor_imex.output(timestep, 0, y_in.copy())  # compile
+    reactor_imex.y0 = y_in.copy()
+    reactor_imex.h_last = 0.0
+
+    start = time.perf_counter()
+    for step in simtime:
+        y_ref = reactor_ref.output(timestep, step, y_in.copy())
+    mid = time.perf_counter()
+    for step in simtime:
+        y_imex = reactor_imex.output(timestep, step, y_in.copy())
+    stop = time.perf_counter()
+
+    logger.info('odeint: %s s, imex: %s s', mid - start, stop - mid)
+    logger.info('Difference odeint - imex: \n %s', y_ref - y_imex)
+    assert np.allclose(y_imex, y_ref, rtol=1e-3, atol=1e-3)
+
+
+def test_dense_output_asm1():
+    y_in = np.array(
+        [30, 69.5, 51.2, 202.32, 28.17, 0, 0, 0, 0, 31.56, 6.95, 10.59, 7, 211.2675, 18446, 15, 0, 0, 0, 0, 0]
+    )
+    timestep = 15 / (60 * 24)
+    samples = np.linspace(0, timestep, 7)[1:]
+
+    # reference: stop the integrator at every sample time
+    reactor_ref = _reactor('odeint', y_in)
+    y_ref = np.array([reactor_ref.output(samples[0], 0, y_in.copy())])
+    for t_start, t_end in zip(samples[:-1], samples[1:], strict=False):
+        y_ref = np.vstack([y_ref, reactor_ref.output(t_end - t_start, t_start, y_in.copy())])
+
+    for integrator in ('imex', 'odeint'):
+        reactor = _reactor(integrator, y_in, dense_output=True)
+        y_out = reactor.output(timestep, 0, y_in.copy())
+        y_sampled = reactor.sample(samples)
+        logger.info('Max. deviation of %s dense output: %s', integrator, np.max(np.abs(y_sampled - y_ref)))
+        assert np.allclose(reactor.sample(timestep), y_out)
+        if integrator == 'imex':
+            # odeint only provides the interval boundaries, imex interpolates between its internal steps
+            assert np.allclose(y_sampled, y_ref, rtol=1e-3, atol=1e-3)
+
+
+def test_positive_imex_asm1():
+    y_in = np.array(
+        [30, 69.5, 51.2, 202.32, 28.17, 0, 0, 0, 0, 31.56, 6.95, 10.59, 7, 211.2675, 18446, 15, 0, 0, 0, 0, 0]
+    )
+    # activated sludge far from the influent composition, a single long interval
+    y0 = np.array([30, 2, 1000, 50, 2500, 150, 500, 2, 8, 0.5, 0.7, 3, 5, 3000, 18446, 15, 0, 0, 0, 0, 0], dtype=float)
+    timestep = 0.5
+
+    # without positivity, the first trial step over the whole interval drives X_S negative
+    # and the clamped right-hand side divides by zero
+    reactor_pos = _reactor('imex', y0, dense_output=True, positive=True)
+    y_pos = reactor_pos.output(timestep, 0, y_in.copy())
+    _, ys, _, _ = reactor_pos.dense
+    assert np.all(ys >= 0.0)
+
+    reactor_ref = _reactor('odeint', y0)
+    y_ref = reactor_ref.output(timestep, 0, y_in.copy())
+    logger.info('Difference odeint - positive imex: \n %s', y_ref - y_pos)
+    assert np.allclose(y_pos, y_ref, rtol=1e-3, atol=1e-3)
+
+    # odeint cannot keep its internal states non-negative
+    with pytest.raises(ValueError, match='imex'):
+        _reactor('odeint', y0, positive=True)
+
+
+test_imex_asm1()
+test_dense_output_asm1()
+test_positive_imex_asm1()
@@ -0,0 +1,75 @@
+"""
+test jacobian.py
+"""
+
+import numpy as np
+
+from bsm2_python.bsm2.init import asm1init_bsm2 as asm1init
+from bsm2_python.bsm2.init import settler1dinit_bsm2 as settler1dinit
+from bsm2_python.bsm2.jacobian import (
+    ColouredJacobian,
+    bandwidth,
+    colour_columns,
+    detect_sparsity,
+    fd_jacobian,
+    settler_sparsity,
+)
+from bsm2_python.bsm2.settler1d_bsm2 import settlerequations
+from bsm2_python.log import logger
+
+
+def test_colour_columns():
+    # arrow matrix: the dense first row couples all columns
+    pattern = np.eye(6, dtype=bool)
+    pattern[0] = True
+    colours = colour_columns(pattern)
+    assert len(set(colours)) == 6
+    # tridiagonal matrix needs three colours
+    pattern = np.eye(9, dtype=bool) | np.eye(9, k=1, dtype=bool) | np.eye(9, k=-1, dtype=bool)
+    colours = colour_columns(pattern)
+    assert colours.max() + 1 == 3
+    for c in range(3):
+        assert np.all(pattern[:, colours == c].sum(axis=1) <= 1)
+    assert bandwidth(pattern) == (1, 1)
+
+
+def test_settler_jacobian():
+    ys_in = np.array(
+        [30, 0.9, 2000, 80, 2500, 150, 900, 0.5, 10, 2, 1, 5, 4.5, 4000, 36000, 15, 0, 0, 0, 0, 0], dtype=float
+    )
+    tempmodel = True
+    args = (
+        ys_in,
+        settler1dinit.SETTLERPAR,
+        settler1dinit.DIM,
+        settler1dinit.LAYER,
+        asm1init.QR,
+        asm1init.QW,
+        tempmodel,
+        settler1dinit.MODELTYPE,
+    )
+    nooflayers = settler1dinit.LAYER[1]
+
+    def func(ys):
+        return settlerequations(0, ys.copy(), *args)
+
+    ys0 = np.asarray(settler1dinit.settlerinit, dtype=float)
+    structure = settler_sparsity(nooflayers, tempmodel)
+    # the detected pattern lies within the structural one
+    detected = detect_sparsity(func, ys0)
+    assert not np.any(detected & ~structure)
+
+    jacobian = ColouredJacobian(func, ys0, structure=structure)
+    logger.info('Settler Jacobian: %s states, %s colours', 12 * nooflayers, jacobian.n_colours)
+    assert jacobian.n_colours == 3
+    assert np.allclose(jacobian(ys0), fd_jacobian(func, ys0), rtol=1e-5, atol=1e-6)
+
+    central = ColouredJacobian(func, ys0, structure=structure, central=True)
+    assert central.evaluations == 6
+    # the soluble transport is linear, the TSS layers of the initial state sit on the kink of the flux limitation
+    solubles = np.r_[0 : 7 * nooflayers, 8 * nooflayers : 12 * nooflayers]
+    assert np.allclose(central(ys0)[solubles], fd_jacobian(func, ys0)[solubles], rtol=1e-5, atol=1e-6)
+
+
+test_colour_columns()
+test_settler_jacobian()
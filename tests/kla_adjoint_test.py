@@ -0,0 +1,38 @@
+"""
+test kla_adjoint.py
+"""
+
+import numpy as np
+
+from bsm2_python.bsm1_ol import BSM1OL
+from bsm2_python.kla_adjoint import KlaAdjoint
+from bsm2_python.log import logger
+
+
+def test_kla_adjoint():
+    bsm1_ol = BSM1OL(endtime=1, timestep=15 / 24 / 60)
+    for i in range(4):
+        bsm1_ol.step(i)
+
+    n_steps = 4
+    adjoint = KlaAdjoint.from_model(bsm1_ol, n_steps=n_steps, weights=(1.0, 1.0, 50.0), checkpoint_every=2)
+    klas = np.tile(np.array(bsm1_ol.klas, dtype=float), (n_steps, 1))
+    result = adjoint.gradient(klas)
+    logger.info('Adjoint cost: %s, terms: %s', result.cost, result.terms)
+    assert result.gradient.shape == (n_steps, 5)
+    assert np.isclose(result.cost, adjoint.evaluate(klas)[0])
+
+    # gradient agrees with forward differences of the discrete model
+    delta = 1e-3
+    for k, j in [(0, 0), (1, 2), (3, 4), (2, 3)]:
+        klas_pert = klas.copy()
+        klas_pert[k, j] += delta
+        fd = (adjoint.evaluate(klas_pert)[0] - result.cost) / delta
+        assert np.isclose(result.gradient[k, j], fd, rtol=1e-4)
+
+    # checkpoint spacing only changes the memory use, not the gradient
+    adjoint.checkpoint_every = 1
+    assert np.allclose(adjoint.gradient(klas).gradient, result.gradient)
+
+
+test_kla_adjoint()
@@ -0,0 +1,83 @@
+"""
+test network.py
+"""
+
+from functools import partial
+
+import numpy as np
+
+from bsm2_python.bsm1_ol import BSM1OL
+from bsm2_python.bsm2.hyddelay_bsm2 import HydraulicDelay
+from bsm2_python.bsm2.init import asm1init_bsm2 as asm1init
+from bsm2_python.log import logger
+from bsm2_python.network import PlantNetwork
+
+y_catchment = np.array(
+    [30, 69.5, 51.2, 202.32, 28.17, 0, 0, 0, 0, 31.56, 6.95, 10.59, 7, 211.2675, 18446, 15, 0, 0, 0, 0, 0],
+    dtype=float,
+)
+# TSS consistent with the particulate components
+y_catchment[13] = 0.75 * np.sum(y_catchment[2:7])
+
+
+def test_hydraulic_delay():
+    delay = HydraulicDelay(asm1init.PAR1, 0.01)
+    timestep = 1 / 24 / 60
+    for k in range(10):
+        y_out = delay.output(timestep, k * timestep, y_catchment)
+    assert np.allclose(y_out, y_catchment)
+
+    # first order response of the flow rate, the concentrations follow the delayed loads
+    y_high = y_catchment.copy()
+    y_high[14] *= 2
+    for k in range(10, 25):
+        y_out = delay.output(timestep, k * timestep, y_high)
+    expected = y_catchment[14] * (2 - np.exp(-15 * timestep / 0.01))
+    assert np.isclose(y_out[14], expected, rtol=1e-4)
+    assert np.allclose(y_out[:13], y_catchment[:13], rtol=1e-6)
+
+
+def _network(processes):
+    network = PlantNetwork(15 / 24 / 60, 0.25, exchange_every=4, processes=processes)
+    network.add_catchment('catchment', np.vstack([np.r_[0.0, y_catchment], np.r_[10.0, y_catchment]]))
+    network.add_reach('upper', 0.02, n_tanks=2)
+    network.add_reach('river', 0.01)
+    factory = partial(BSM1OL, tempmodel=False, activate=False)
+    y_a = y_catchment.copy()
+    y_a[14] *= 0.6
+    network.add_plant('a', factory, record=['iqi'], y_init=y_a)
+    network.add_plant('b', factory)
+    network.connect('catchment', 'upper', fraction=0.6)
+    network.connect('upper', 'a')
+    network.connect('a', 'river')
+    network.connect('catchment', 'b', fraction=0.4)
+    network.connect('river', 'b')
+    return network
+
+
+def test_plant_network():
+    results = _network(processes=True).run()
+    serial = _network(processes=False).run()
+    n_steps = len(results['simtime'])
+    logger.info('Network with 2 plants: %s steps, effluent of b: %s', n_steps, results['b']['ys_eff'][-1])
+    for plant in ('a', 'b'):
+        assert np.allclose(results[plant]['ys_eff'], serial[plant]['ys_eff'])
+    assert results['a']['iqi'].shape == (n_steps,)
+
+    # the upper reach starts in steady state, plant a sees the scaled catchment
+    y_a = y_catchment.copy()
+    y_a[14] *= 0.6
+    assert np.allclose(results['a']['y_in'], y_a)
+    data_in = np.vstack([np.r_[0.0, y_a], np.r_[1.0, y_a]])
+    bsm1_ol = BSM1OL(data_in=data_in, timestep=15 / 24 / 60, tempmodel=False, activate=False)
+    for i in range(n_steps):
+        bsm1_ol.step(i)
+    assert np.allclose(results['a']['ys_eff'][-1], bsm1_ol.ys_eff)
+
+    # plant b receives the rest of the catchment and the effluent of plant a, delayed by the exchange
+    assert np.allclose(results['b']['y_in'][4:, 14], 0.4 * y_catchment[14] + results['river'][4:, 14], rtol=1e-6)
+    assert np.isclose(results['river'][-1, 14], results['a']['ys_eff'][-5, 14], rtol=1e-4)
+
+
+test_hydraulic_delay()
+test_plant_network()
@@ -0,0 +1,131 @@
+"""
+test operational_indicators.py
+"""
+
+import logging
+import time
+
+import numpy as np
+
+from bsm2_python.bsm1_ol import BSM1OL
+from bsm2_python.bsm2.init import adm1init_bsm2 as adm1init
+from bsm2_python.bsm2.init import reginit_bsm2 as reginit
+from bsm2_python.bsm2_ol import BSM2OL
+from bsm2_python.log import logger
+from bsm2_python.operational_indicators import OperationalIndicators, RollingWindow
+
+timestep = 15 / 24 / 60
+TSS, Q = 13, 14
+
+
+def test_rolling_window():
+    window = RollingWindow(1.0, 1, min_timestep=0.1)
+    dts = np.array([0.1, 0.3, 0.2, 0.1, 0.5, 0.1, 0.1, 0.2, 0.4, 0.1] * 10)
+    values = np.arange(len(dts), dtype=float)
+    for k, (dt, value) in enumerate(zip(dts, values, strict=True)):
+        window.push(dt, [value])
+        assert len(window) <= window.capacity
+        # the fewest newest steps covering at least one day
+        n = 1
+        while n <= k and np.sum(dts[k - n + 1 : k + 1]) < 1.0 - 1e-9:
+            n += 1
+        assert np.isclose(window.duration, np.sum(dts[k - n + 1 : k + 1]))
+        assert np.isclose(window.sums[0], dts[k - n + 1 : k + 1] @ values[k - n + 1 : k + 1])
+    assert window.full
+    assert np.isclose(window.mean()[0], window.sums[0] / window.duration)
+
+
+def test_operational_indicators_bsm2():
+    bsm2_ol = BSM2OL(endtime=1, timestep=timestep, tempmodel=False, activate=False)
+    bsm2_ol.adm1_reactor.yd0 = adm1init.DIGESTERINIT.copy()
+    indicators = OperationalIndicators(bsm2_ol, window=0.25, sample_time=1 / 24, max_samples=5)
+    n_steps = 48
+    start = time.perf_counter()
+    bsm2_ol.advance(n_steps, observer=indicators)
+    logger.info('Simulation with indicators: %.3f s', time.perf_counter() - start)
+    logger.info('Operational indicators: %s', indicators.values)
+    assert set(indicators.values) == {'srt', 'hrt', 'f_m', 'hrt_digester', 'vfa_alkalinity', 'methane_yield'}
+    assert indicators.window.capacity == 25
+
+    # the streamed indicators equal the ones computed afterwards from the histories of the last 6 hours
+    last = slice(n_steps - 24, n_steps)
+    volumes = np.array([reactor.volume for reactor in indicators.reactors])
+    y_as = np.stack([getattr(bsm2_ol, f'y_out{k}_all')[last] for k in range(1, 6)], axis=1)
+    mass = y_as[:, :, TSS] @ volumes + np.mean(bsm2_ol.ys_tss_internal_all[last], axis=1) * indicators.volume_settler
+    outflow = bsm2_ol.ys_was_all[last, TSS] * bsm2_ol.ys_was_all[last, Q]
+    outflow += bsm2_ol.ys_of_all[last, TSS] * bsm2_ol.ys_of_all[last, Q]
+    assert np.isclose(indicators.values['srt'], np.sum(mass) / np.sum(outflow))
+    hrt = indicators.volume_as / np.mean(bsm2_ol.to_as_all[last, Q])
+    assert np.isclose(indicators.values['hrt'], hrt)
+
+    yd_out = bsm2_ol.yd_out_all[last]
+    assert np.isclose(indicators.values['hrt_digester'], bsm2_ol.adm1_reactor.volume_liq / np.mean(yd_out[:, 26]))
+    vfa = 60 * (yd_out[:, 3] / 208 + yd_out[:, 4] / 160 + yd_out[:, 5] / 112 + yd_out[:, 6] / 64)
+    assert np.isclose(indicators.values['vfa_alkalinity'], np.sum(vfa) / np.sum(50 * yd_out[:, 39]))
+    ch4 = bsm2_ol.performance.gas_production(yd_out, reginit.T_OP)[0]
+    cod_in = sum(np.sum(y[:, :7], axis=1) * y[:, Q] for y in (bsm2_ol.yt_uf_all[last], bsm2_ol.yp_uf_all[last]))
+    assert np.isclose(indicators.values['methane_yield'], np.sum(ch4) / 0.7168 / (np.sum(cod_in) / 1000))
+
+    # plausible ranges of a healthy plant
+    assert 5 < indicators.values['srt'] < 50
+    assert 0 < indicators.values['vfa_alkalinity'] < 0.3
+    assert 0.1 < indicators.values['methane_yield'] < 0.35
+    assert 15 < indicators.values['hrt_digester'] < 25
+
+    # the history keeps the last samples only
+    recorded = indicators.recorded()
+    assert len(recorded['simtime']) == 5
+    assert np.allclose(recorded['simtime'], bsm2_ol.simtime[28:n_steps:4])
+    assert np.all(recorded['srt'] > 0)
+
+
+def test_operational_indicators_stop():
+    bsm1_ol = BSM1OL(timestep=timestep, endtime=1, tempmodel=False)
+    try:
+        OperationalIndicators(bsm1_ol, limits={'vfa_alkalinity': (None, 0.3)})
+    except ValueError as err:
+        assert 'vfa_alkalinity' in str(err)
+    else:
+        raise AssertionError('digester indicator of a plant without digester was not detected')
+
+    # an impossible limit on the hydraulic retention time stops the simulation once the window is full
+    indicators = OperationalIndicators(bsm1_ol, window=0.25, limits={'hrt': (None, 0.01)}, stop_on_alarm=True)
+    recorded = bsm1_ol.advance(96, observer=indicators)
+    assert set(indicators.values) == {'srt', 'hrt', 'f_m'}
+    assert bsm1_ol.next_step == 24
+    assert len(recorded['simtime']) == 24
+    assert indicators.alarms[0][1] == 'hrt'
+    assert 0.1 < indicators.values['f_m'] < 1.0
+
+
+def test_operational_indicators_alarms():
+    bsm1_ol = BSM1OL(timestep=timestep, endtime=1, tempmodel=False)
+    indicators = OperationalIndicators(bsm1_ol, window=0.25, max_samples=10, limits={'hrt': (None, 0.01)})
+    records = []
+    handler = logging.Handler(logging.INFO)
+    handler.emit = records.append
+    logger.addHandler(handler)
+    level = logger.level
+    logger.setLevel(logging.INFO)
+    try:
+        bsm1_ol.advance(36, observer=indicators)
+        # every step out of limits is an alarm, the newest are kept, the warning is logged once
+        assert indicators.alarm_counts == {'hrt': 13}
+        assert len(indicators.alarms) == 10
+        assert indicators.alarms[-1][0] == bsm1_ol.simtime[35]
+        assert indicators.out_of_limits == {'hrt'}
+        assert len([record for record in records if record.levelno == logging.WARNING]) == 1
+        indicators.limits['hrt'] = (None, 10.0)
+        bsm1_ol.advance(4, observer=indicators)
+    finally:
+        logger.removeHandler(handler)
+        logger.setLevel(level)
+    assert indicators.alarm_counts == {'hrt': 13}
+    assert not indicators.out_of_limits
+    assert any('within limits again' in record.getMessage() for record in records)
+
+
+test_rolling_window()
+test_operational_indicators_bsm2()
+test_operational_indicators_stop()
+test_operational_indicators_alarms()
@@ -0,0 +1,66 @@
+"""
+test periodic.py
+"""
+
+import os
+import time
+
+import numpy as np
+
+from bsm2_python.bsm1_ol import BSM1OL
+from bsm2_python.influent import read_influent
+from bsm2_python.log import logger
+from bsm2_python.periodic import PeriodicSteadyState, plant_states
+
+path_name = os.path.dirname(__file__)
+timestep = 15 / 24 / 60
+
+
+def cyclic_plant():
+    # the first day of the dry weather influent, repeated every day
+    dryinfluent = read_influent(path_name + '/../src/bsm2_python/data/dryinfluent.csv')
+    day = dryinfluent[:96]
+    data_in = np.concatenate([day, day])
+    data_in[96:, 0] += 1.0
+    return BSM1OL(data_in=data_in, timestep=timestep, endtime=1.5, tempmodel=False)
+
+
+def test_periodic_steady_state():
+    bsm1_ol = cyclic_plant()
+    assert plant_states(bsm1_ol) == [
+        'reactor1.y0',
+        'reactor2.y0',
+        'reactor3.y0',
+        'reactor4.y0',
+        'reactor5.y0',
+        'settler.ys0',
+        'ys_out',
+        'y_out5_r',
+    ]
+    start = time.perf_counter()
+    pss = PeriodicSteadyState(bsm1_ol, period=1)
+    result = pss.solve()
+    logger.info('Periodic steady state: %s periods, %.3f s', result.n_periods, time.perf_counter() - start)
+    logger.info('Residuals: %s', result.residuals)
+    assert result.converged
+    assert result.residuals[-1] < pss.tol
+    assert np.array_equal(pss.state(), result.state)
+    assert bsm1_ol.next_step == 0
+
+    # the plant repeats itself: one more period ends in the start state
+    bsm1_ol.advance(96)
+    assert np.allclose(pss.state(), result.state, rtol=1e-5, atol=1e-5)
+
+    # simulating period after period needs many more periods for the same residual
+    plain = PeriodicSteadyState(cyclic_plant(), period=1, memory=0, max_periods=result.n_periods)
+    assert not plain.solve().converged
+
+    try:
+        PeriodicSteadyState(bsm1_ol, period=2)
+    except ValueError as err:
+        assert 'period' in str(err)
+    else:
+        raise AssertionError('period beyond the simulation time was not detected')
+
+
+test_periodic_steady_state()
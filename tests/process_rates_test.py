@@ -0,0 +1,101 @@
+"""
+test process_rates.py
+"""
+
+import time
+
+import numpy as np
+
+from bsm2_python.bsm1_ol import BSM1OL
+from bsm2_python.bsm2.adm1_bsm2 import X_C4, X_CH, X_LI, X_PR, X_XC, adm1equations
+from bsm2_python.bsm2.asm1_bsm2 import asm1equations
+from bsm2_python.bsm2.init import adm1init_bsm2 as adm1init
+from bsm2_python.bsm2_ol import BSM2OL
+from bsm2_python.log import logger
+from bsm2_python.process_rates import (
+    ADM1_PROCESSES,
+    activated_sludge_rates,
+    adm1_process_rates,
+    asm1_process_rates,
+    digester_rates,
+    digester_states,
+)
+
+timestep = 15 / 24 / 60
+
+
+def test_activated_sludge_rates():
+    bsm1_ol = BSM1OL(endtime=1, timestep=timestep, tempmodel=False, activate=False)
+    bsm1_ol.advance(96)
+    rates = activated_sludge_rates(bsm1_ol, stop=96)
+    assert list(rates) == ['reactor1', 'reactor2', 'reactor3', 'reactor4', 'reactor5']
+
+    for k in range(1, 6):
+        reactor = getattr(bsm1_ol, f'reactor{k}')
+        y_out_all = getattr(bsm1_ol, f'y_out{k}_all')
+        for i in range(0, 96, 5):
+            y = y_out_all[i].copy()
+            # without flow and aeration the right-hand side consists of the conversion rates
+            dy = asm1equations(0.0, y.copy(), y.copy(), reactor.asm1par, 0.0, reactor.volume, False, False)
+            assert np.allclose(rates[f'reactor{k}']['conversion'][i, :13], dy[:13], rtol=1e-10, atol=1e-10)
+            args = (reactor.asm1par, reactor.kla, reactor.volume, False, False)
+            dy_aerated = asm1equations(0.0, y.copy(), y.copy(), *args)
+            assert np.isclose(rates[f'reactor{k}']['otr'][i], dy_aerated[7] - dy[7], rtol=1e-10, atol=1e-10)
+        assert np.allclose(rates[f'reactor{k}']['our'], -rates[f'reactor{k}']['conversion'][:, 7])
+
+    # nitrification in the aerated tanks, denitrification in the anoxic tanks
+    assert np.mean(rates['reactor4']['nitrification']) > 10 * np.mean(rates['reactor1']['nitrification'])
+    assert np.mean(rates['reactor1']['denitrification']) > 3 * np.mean(rates['reactor4']['denitrification'])
+    assert np.all(rates['reactor1']['otr'] == 0)
+
+    # unsimulated steps give zero rates
+    assert np.all(activated_sludge_rates(bsm1_ol, start=96)['reactor3']['process'] == 0)
+
+    # a year of 15 min samples in one pass
+    y_year = np.tile(bsm1_ol.y_out3_all[:96], (365, 1))
+    start = time.perf_counter()
+    asm1_process_rates(y_year, bsm1_ol.reactor3.asm1par)
+    logger.info('ASM1 rates of %s samples: %.3f s', len(y_year), time.perf_counter() - start)
+
+
+def test_digester_rates():
+    bsm2_ol = BSM2OL(endtime=1, timestep=timestep, tempmodel=False, activate=False)
+    bsm2_ol.adm1_reactor.yd0 = adm1init.DIGESTERINIT.copy()
+    bsm2_ol.advance(8)
+    rates = digester_rates(bsm2_ol, stop=8)
+    assert rates.shape == (8, len(ADM1_PROCESSES))
+    yd = digester_states(bsm2_ol.yd_out_all[:8])
+    assert np.allclose(yd[-1, :35], bsm2_ol.adm1_reactor.yd0[:35])
+
+    digester = bsm2_ol.adm1_reactor
+    par = digester.digesterpar
+    y_su, y_aa, y_fa, y_c4, y_pro, y_ac, y_h2 = par[27], par[34], par[35], par[36], par[37], par[39], par[40]
+    f_ch_xc, f_pr_xc, f_li_xc = par[2], par[3], par[4]
+    for i in range(8):
+        # without flow the right-hand side consists of the conversion rates
+        dyd = adm1equations(0.0, yd[i].copy(), np.zeros(42), par, bsm2_ol.yd_out_all[i, 27] + 273.15, digester.dim)
+        p = rates[i]
+        expected = {
+            X_XC: -p[0] + np.sum(p[12:19]),
+            X_CH: f_ch_xc * p[0] - p[1],
+            X_PR: f_pr_xc * p[0] - p[2],
+            X_LI: f_li_xc * p[0] - p[3],
+            16: y_su * p[4] - p[12],
+            17: y_aa * p[5] - p[13],
+            18: y_fa * p[6] - p[14],
+            X_C4: y_c4 * (p[7] + p[8]) - p[15],
+            20: y_pro * p[9] - p[16],
+            21: y_ac * p[10] - p[17],
+            22: y_h2 * p[11] - p[18],
+            8: (1.0 - y_ac) * p[10] + (1.0 - y_h2) * p[11] - p[20],
+        }
+        for index, value in expected.items():
+            assert np.isclose(dyd[index], value, rtol=1e-9, atol=1e-12), (i, index)
+
+    # rates of a constant temperature digester at a higher temperature
+    warmer = adm1_process_rates(yd, par, np.full(8, 313.15))
+    assert np.all(np.isfinite(warmer))
+
+
+test_activated_sludge_rates()
+test_digester_rates()
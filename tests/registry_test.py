@@ -0,0 +1,37 @@
+"""
+test engine/registry.py
+"""
+
+import numpy as np
+
+from bsm2_python.engine.registry import REGISTRY
+
+
+def _split(params, flow=100.0):
+    adapter = REGISTRY['splitter']('sp', params)
+    x = np.arange(21, dtype=float)
+    x[14] = flow
+    outputs = adapter.step(0.01, 0, {'in_main': x})
+    for stream in outputs.values():
+        assert np.allclose(np.delete(stream, 14), np.delete(x, 14))
+    return [outputs[h][14] for h in adapter.output_handles]
+
+
+def test_splitter_programs():
+    handles = {'__output_handles__': ['a', 'b', 'c']}
+    # explicit ratios with a blank output taking the remainder
+    assert np.allclose(_split({**handles, 'split_ratio': [0.2, '0.3', '']}), [20, 30, 50])
+    # ratios summing above one are scaled
+    assert np.allclose(_split({**handles, 'split_ratio': [1, 1, 2]}), [25, 25, 50])
+    # without blanks the remainder goes to the last explicit output
+    assert np.allclose(_split({**handles, 'split_ratio': [0.1, 0.2, 0.3]}), [10, 20, 70])
+    # all blank outputs share the flow equally
+    assert np.allclose(_split({**handles, 'split_ratio': None}), [100 / 3] * 3)
+    # thresholds cap the outputs in order, the first blank takes the rest
+    assert np.allclose(_split({**handles, 'mode': 'threshold', 'threshold': [30, '', 50]}), [30, 20, 50])
+    assert np.allclose(_split({**handles, 'mode': 'threshold', 'threshold': [30, '', 50]}, 60), [30, 0, 30])
+    # qintr defaults to threshold mode targeting the last output
+    assert np.allclose(_split({'__output_handles__': ['a', 'b'], 'qintr': 40}), [60, 40])
+
+
+test_splitter_programs()
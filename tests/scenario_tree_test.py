@@ -0,0 +1,70 @@
+"""
+test scenario_tree.py
+"""
+
+import numpy as np
+
+from bsm2_python.bsm1_ol import BSM1OL
+from bsm2_python.log import logger
+from bsm2_python.scenario_tree import Change, ModelSnapshot, ScenarioTree
+
+timestep = 15 / 24 / 60
+endtime = 0.5
+
+
+def _plant():
+    return BSM1OL(endtime=1, timestep=timestep, tempmodel=False, activate=False)
+
+
+def _storm(model):
+    # doubles the influent flow rate from the branching time on
+    model.y_in[model.data_time >= 0.25, 14] *= 2
+
+
+def _low_aeration(model):
+    return {'klas': np.array([0, 0, 120, 120, 40], dtype=float)}
+
+
+def _reference(changes, n_steps):
+    model = _plant()
+    kwargs = {}
+    for i in range(n_steps):
+        for change in changes:
+            if np.isclose(model.simtime[i], change.time):
+                kwargs = {**kwargs, **(change.apply(model) or {})}
+        model.step(i, **kwargs)
+    return model
+
+
+def test_snapshot():
+    model = _plant()
+    model.advance(4)
+    snapshot = ModelSnapshot(model)
+    first = model.advance(4, record=['ys_eff'])['ys_eff'].copy()
+    snapshot.restore(model)
+    assert model.next_step == 4
+    assert np.array_equal(model.advance(4, record=['ys_eff'])['ys_eff'], first)
+
+
+def test_scenario_tree():
+    scenarios = {
+        'base': [],
+        'storm': [Change(0.25, _storm)],
+        'aeration': [Change(0.25, _low_aeration)],
+        'storm_aeration': [Change(0.25, _storm), Change(0.375, _low_aeration)],
+    }
+    tree = ScenarioTree(_plant, scenarios, record=['ys_eff'], endtime=endtime)
+    results = tree.run()
+    n_steps = len(results['base']['simtime'])
+    logger.info('Scenario tree: %s of %s steps simulated', tree.simulated_steps, n_steps * len(scenarios))
+    # shared prefix until 0.25 d, the storm branch is shared until 0.375 d
+    assert tree.simulated_steps == n_steps // 2 + 3 * n_steps // 2 + n_steps // 4
+
+    for name, changes in scenarios.items():
+        reference = _reference(changes, n_steps)
+        assert np.allclose(results[name]['ys_eff'], reference.ys_eff_all[:n_steps], rtol=1e-10, atol=1e-10)
+    assert not np.allclose(results['storm']['ys_eff'], results['base']['ys_eff'])
+
+
+test_snapshot()
+test_scenario_tree()
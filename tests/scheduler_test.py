@@ -0,0 +1,82 @@
+"""
+test engine/scheduler.py
+"""
+
+import sys
+import time
+
+import numpy as np
+
+from bsm2_python.engine.scheduler import NATIVE_MIN_NODES, schedule, schedule_csr
+from bsm2_python.log import logger
+
+
+def _flowsheet(n_nodes, n_edges, seed=0, chain=False):
+    rng = np.random.default_rng(seed)
+    nodes = [{'id': f'n{i}'} for i in range(n_nodes)]
+    if chain:
+        src = np.arange(n_nodes - 1)
+        dst = src + 1
+    else:
+        src = rng.integers(0, n_nodes, n_edges)
+        dst = rng.integers(0, n_nodes, n_edges)
+    edges = [
+        {'id': f'e{k}', 'source_node_id': f'n{u}', 'target_node_id': f'n{v}'} for k, (u, v) in enumerate(zip(src, dst))
+    ]
+    return {'nodes': nodes, 'edges': edges}
+
+
+def _check_plan(data, plan):
+    """Every node is scheduled once, components come after their predecessors and the loops are acyclic
+    without their tear edges."""
+    position = {}
+    for k, stage in enumerate(plan['stages']):
+        order = stage['order'] if stage['type'] == 'acyclic' else stage['internal_order']
+        assert sorted(order) == sorted(stage['nodes'])
+        for i, nid in enumerate(order):
+            position[nid] = (k, i)
+    assert len(position) == len(data['nodes'])
+    tears = {tid for stage in plan['stages'] if stage['type'] == 'loop' for tid in stage['tear_edges']}
+    torn_pairs = {(e['source_node_id'], e['target_node_id']) for e in data['edges'] if e['id'] in tears}
+    for e in data['edges']:
+        u, v = e['source_node_id'], e['target_node_id']
+        if position[u][0] != position[v][0]:
+            assert position[u][0] < position[v][0]
+        elif (u, v) not in torn_pairs:
+            assert position[u][1] < position[v][1]
+
+
+def _partition(plan):
+    return sorted(tuple(sorted(stage['nodes'])) for stage in plan['stages'])
+
+
+def test_schedule_csr():
+    # small layouts: same components as the recursive scheduler
+    for seed, (n_nodes, n_edges) in enumerate([(8, 12), (30, 45), (60, 60), (150, 300)]):
+        data = _flowsheet(n_nodes, n_edges, seed=seed)
+        data['edges'].append({'id': 'self', 'source_node_id': 'n0', 'target_node_id': 'n0'})
+        data['edges'].append({'id': 'twin', 'source_node_id': 'n1', 'target_node_id': 'n2'})
+        data['edges'].append({'id': 'twin2', 'source_node_id': 'n1', 'target_node_id': 'n2'})
+        plan = schedule_csr(data)
+        _check_plan(data, plan)
+        assert _partition(plan) == _partition(schedule(data))
+        assert plan['stages'][plan['comp_order'].index(plan['node_to_comp']['n0'])]['type'] == 'loop'
+
+    # deep chain: beyond the recursion limit of the recursive scheduler
+    data = _flowsheet(3 * sys.getrecursionlimit(), 0, chain=True)
+    plan = schedule(data)
+    assert len(data['nodes']) > NATIVE_MIN_NODES
+    assert [stage['order'][0] for stage in plan['stages']] == [n['id'] for n in data['nodes']]
+
+    # large catchment layout with 100k edges
+    data = _flowsheet(20000, 100000, seed=1)
+    start = time.perf_counter()
+    plan = schedule(data)
+    duration = time.perf_counter() - start
+    loops = [stage for stage in plan['stages'] if stage['type'] == 'loop']
+    logger.info('Scheduled 100k edges in %.3f s, %s stages, %s loops', duration, len(plan['stages']), len(loops))
+    _check_plan(data, plan)
+    assert duration < 1.0
+
+
+test_schedule_csr()
@@ -0,0 +1,116 @@
+"""
+test smoothing.py
+"""
+
+import numpy as np
+
+from bsm2_python.bsm2.helpers_bsm2 import Splitter
+from bsm2_python.bsm2.init import asm1init_bsm2 as asm1init
+from bsm2_python.bsm2.init import settler1dinit_bsm2 as settler1dinit
+from bsm2_python.bsm2.init import storageinit_bsm2 as storageinit
+from bsm2_python.bsm2.jacobian import fd_jacobian
+from bsm2_python.bsm2.settler1d_bsm2 import settlerequations
+from bsm2_python.bsm2.smoothing import smooth_min, smooth_step
+from bsm2_python.bsm2.storage_bsm2 import Storage
+from bsm2_python.log import logger
+
+
+def test_smooth_functions():
+    a = np.linspace(-2, 2, 41)
+    for w in (0.1, 1.0):
+        values = np.array([smooth_min(x, 0.5, w) for x in a])
+        assert np.all(values <= np.minimum(a, 0.5))
+        assert np.all(np.minimum(a, 0.5) - values <= w / 2 + 1e-12)
+        steps = np.array([smooth_step(x, w) for x in a])
+        assert np.all(np.diff(steps) >= 0)
+        far = np.abs(a) > 5 * w
+        assert np.all(np.abs(steps[far] - (a[far] >= 0)) <= np.exp(-10))
+    # width 0 is the original switch
+    assert smooth_min(1.0, 2.0, 0.0) == 1.0
+    assert smooth_step(0.0, 0.0) == 1.0
+    assert smooth_step(-1e-9, 0.0) == 0.0
+
+
+def test_smooth_settler():
+    ys_in = np.array(
+        [30, 0.9, 2000, 80, 2500, 150, 900, 0.5, 10, 2, 1, 5, 4.5, 4000, 36000, 15, 0, 0, 0, 0, 0], dtype=float
+    )
+    args = (
+        ys_in,
+        settler1dinit.SETTLERPAR,
+        settler1dinit.DIM,
+        settler1dinit.LAYER,
+        asm1init.QR,
+        asm1init.QW,
+        True,
+        settler1dinit.MODELTYPE,
+    )
+    nooflayers = settler1dinit.LAYER[1]
+    tss = np.s_[7 * nooflayers : 8 * nooflayers]
+    ys0 = np.asarray(settler1dinit.settlerinit, dtype=float)
+
+    sharp = settlerequations(0, ys0.copy(), *args)
+    assert np.array_equal(settlerequations(0, ys0.copy(), *args, 0.0), sharp)
+    # the deviation vanishes linearly with the smoothing width
+    deviations = []
+    for smoothing in (1e-3, 1e-4, 1e-5):
+        smooth = settlerequations(0, ys0.copy(), *args, smoothing)
+        deviations.append(np.max(np.abs(smooth - sharp)) / np.max(np.abs(sharp)))
+        logger.info('Smoothing %s: relative deviation of the settler equations %s', smoothing, deviations[-1])
+        assert deviations[-1] <= 50 * smoothing
+    assert deviations[2] < deviations[1] < deviations[0]
+
+    # the initial state sits on the kinks of the flux limitation, the smoothed equations are differentiable there
+    def func(ys, smoothing):
+        return settlerequations(0, ys.copy(), *args, smoothing)
+
+    for smoothing, agree in ((0.0, False), (0.01, True)):
+        forward = fd_jacobian(lambda y, s=smoothing: func(y, s), ys0, rel_step=1e-7)
+        backward = fd_jacobian(lambda y, s=smoothing: func(y, s), ys0, rel_step=-1e-7)
+        close = np.allclose(forward[tss], backward[tss], rtol=1e-3, atol=1e-3)
+        logger.info('Smoothing %s: one-sided derivatives agree: %s', smoothing, close)
+        assert close == agree
+
+
+def test_smooth_splitter():
+    y_in = np.zeros(21)
+    y_in[14] = 1000.0
+    for q in (500.0, 950.0, 1000.0, 1050.0, 2000.0):
+        y_in[14] = q
+        sharp = Splitter(sp_type=2).output(y_in, (0.0, 0.0), 1000.0)
+        smooth = Splitter(sp_type=2, smoothing=0.01).output(y_in, (0.0, 0.0), 1000.0)
+        assert np.isclose(smooth[0][14] + smooth[1][14], q)
+        assert smooth[0][14] <= sharp[0][14]
+        assert sharp[0][14] - smooth[0][14] <= 0.5 * 0.01 * 1000.0 + 1e-9
+    assert Splitter(sp_type=2).smoothing == 0
+
+
+def test_smooth_storage():
+    yst_in = np.zeros(21)
+    yst_in[:14] = storageinit.ystinit[:14]
+    yst_in[14] = 200.0
+    yst_in[15] = 15.0
+    timestep = 15 / (60 * 24)
+    outputs = {}
+    for smoothing in (0.0, 1e-3):
+        storage = Storage(storageinit.VOL_S, storageinit.ystinit.copy(), False, False)
+        storage.smoothing = smoothing
+        flows, volumes = [], []
+        for k in range(400):
+            yst_out, vol = storage.output(timestep, k * timestep, yst_in, 100.0)
+            flows.append(yst_out[14])
+            volumes.append(vol)
+        outputs[smoothing] = (np.array(flows), np.array(volumes))
+    # the tank fills up and bypasses the surplus, the outflow equals the inflow in both cases
+    sharp_flows, sharp_volumes = outputs[0.0]
+    smooth_flows, smooth_volumes = outputs[1e-3]
+    assert np.isclose(sharp_flows[-1], 200.0)
+    assert np.isclose(smooth_flows[-1], 200.0, rtol=1e-3)
+    assert np.all(smooth_volumes <= storageinit.VOL_S)
+    assert np.allclose(smooth_volumes, sharp_volumes, rtol=1e-2)
+
+
+test_smooth_functions()
+test_smooth_settler()
+test_smooth_splitter()
+test_smooth_storage()
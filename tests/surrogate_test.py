@@ -0,0 +1,62 @@
+"""
+test surrogate.py
+"""
+
+from operator import itemgetter
+
+import numpy as np
+
+from bsm2_python.log import logger
+from bsm2_python.surrogate import ActiveLearner, GaussianProcess, batch_run
+
+parameters = {'qintr': (0.0, 1.0), 'kla': (0.0, 1.0)}
+
+
+def plant(params):
+    # analytic stand-in for a plant simulation: cost trades off against effluent quality
+    x, y = params['qintr'], params['kla']
+    return {'oci': 10 + 8 * (x - 0.2) ** 2 + 5 * (y - 0.6) ** 2 + 0.5 * np.sin(6 * y), 'eqi': 5 - 4 * x}
+
+
+def test_gaussian_process():
+    x = np.linspace(0, 1, 8)[:, None]
+    y = np.sin(6 * x[:, 0])
+    gp = GaussianProcess([[0, 1]]).fit(x, y)
+    mean, std = gp.predict(x)
+    assert np.allclose(mean, y, atol=1e-3)
+    assert np.all(std < 1e-2)
+    x_test = np.linspace(0, 1, 50)[:, None]
+    mean, std = gp.predict(x_test)
+    assert np.max(np.abs(mean - np.sin(6 * x_test[:, 0]))) < 0.05
+    # uncertainty grows outside of the observations
+    assert gp.predict([[1.5]])[1][0] > 10 * np.max(std)
+
+
+def test_active_learning():
+    learner = ActiveLearner(plant, parameters, objective='oci', constraints={'eqi': 3.0}, batch_size=3)
+    best_params, best_kpis = learner.optimise(n_iterations=5, n_initial=6)
+    grid = np.linspace(0, 1, 401)
+    reference = min(
+        plant({'qintr': x, 'kla': y})['oci'] for x in grid for y in grid if plant({'qintr': x, 'kla': y})['eqi'] <= 3
+    )
+    logger.info('Surrogate optimum %s after %s simulations, reference %s', best_kpis, learner.n_simulations, reference)
+    assert learner.n_simulations == 21
+    assert best_kpis['eqi'] <= 3.0
+    assert best_kpis['oci'] - reference < 0.05
+    assert best_params['qintr'] >= 0.5
+
+    # screening rejects infeasible and clearly worse candidates
+    candidates = [{'qintr': 0.1, 'kla': 0.5}, {'qintr': 1.0, 'kla': 0.0}, dict(best_params)]
+    assert learner.screen(candidates) == [best_params]
+
+
+def test_batch_run():
+    candidates = [{'qintr': x, 'kla': 0.5} for x in (0.0, 0.25, 0.5, 0.75)]
+    assert batch_run(plant, candidates) == [plant(c) for c in candidates]
+    # workers unpickle `evaluate` by reference, this module is still being imported while its tests run
+    assert batch_run(itemgetter('qintr'), candidates, n_workers=2) == [0.0, 0.25, 0.5, 0.75]
+
+
+test_gaussian_process()
+test_active_learning()
+test_batch_run()
@@ -0,0 +1,77 @@
+"""
+test tolerance_tuning.py
+"""
+
+import numpy as np
+
+from bsm2_python.bsm1_ol import BSM1OL
+from bsm2_python.log import logger
+from bsm2_python.tolerance_tuning import ToleranceTuner, apply_tolerances, find_units
+
+SNH = 9
+
+# CONSTINFLUENT from BSM2:
+y_in = np.array(
+    [
+        [0.0, 30, 69.5, 51.2, 202.32, 28.17, 0, 0, 0, 0, 31.56, 6.95, 10.59, 7, 211.2675, 18446, 15, 0, 0, 0, 0, 0],
+        [1.0, 30, 69.5, 51.2, 202.32, 28.17, 0, 0, 0, 0, 31.56, 6.95, 10.59, 7, 211.2675, 18446, 15, 0, 0, 0, 0, 0],
+    ]
+)
+kpis = {'snh_eff': lambda m: m.ys_eff[SNH], 'tss_eff': lambda m: m.ys_eff[13]}
+
+
+def factory():
+    return BSM1OL(data_in=y_in, timestep=15 / (60 * 24), endtime=1)
+
+
+def test_tolerance_tuning():
+    units = find_units(factory())
+    assert {'reactor1', 'reactor5', 'settler'} <= set(units)
+
+    tuner = ToleranceTuner(
+        factory,
+        kpis,
+        1e-3,
+        candidates=(1e-4, 1e-6),
+        units=['reactor1', 'settler'],
+        n_steps=8,
+    )
+    result = tuner.tune()
+    logger.info('Tuned settings: %s', result.settings)
+
+    assert set(result.settings) == {'reactor1', 'settler'}
+    assert tuner.within_tolerance(result.kpis, result.reference_kpis)
+
+    model = factory()
+    apply_tolerances(model, result.settings)
+    assert model.settler.rtol == result.settings['settler'][0]
+
+
+def test_tolerance_tuning_fallback():
+    class CombinedFails(ToleranceTuner):
+        # the evaluation of the combined settings after the unit-wise tuning exceeds the tolerance
+        n_calls = 0
+
+        def evaluate(self, settings):
+            kpis, walltime = super().evaluate(settings)
+            self.n_calls += 1
+            if self.n_calls == 6:
+                kpis = {name: 2 * value for name, value in kpis.items()}
+            return kpis, walltime
+
+    tuner = CombinedFails(
+        factory, kpis, 1e-3, candidates=(1e-4, 1e-6), units=['reactor1', 'settler'], n_steps=8, repeats=1, margin=0.0
+    )
+    result = tuner.tune()
+    assert tuner.n_calls >= 7
+    assert tuner.within_tolerance(result.kpis, result.reference_kpis)
+    assert result.settings in [settings for settings, _, _ in result.history]
+
+    # no candidate is faster by more than the margin, the reference settings are kept
+    tuner = ToleranceTuner(factory, kpis, 1e-3, candidates=(1e-4,), units=['reactor1'], n_steps=8, margin=1.0)
+    result = tuner.tune()
+    assert result.settings == {'reactor1': (tuner.reference_tol, tuner.reference_tol)}
+
+
+test_tolerance_tuning()
+test_tolerance_tuning_fallback()